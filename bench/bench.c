@@ -0,0 +1,329 @@
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/printf.h"
+#include "../include/sink.h"
+#include "../include/vfprintf.h"
+
+// Calls per measurement when --iterations is not given, and untimed calls made first so caches,
+// thread buffers and the compiled format cache are warm.
+#define BENCH_DEFAULT_ITERATIONS 200000
+#define BENCH_WARMUP_ITERATIONS 1000
+// Output size the in-memory targets format into; every case fits.
+#define BENCH_OUTPUT_SIZE 1024
+
+// Allocations are counted by replacing malloc and friends in this executable, which also catches
+// the C library's own allocations. glibc exports its allocator under __libc_* names for this;
+// sanitizer builds bring their own allocator, so counting is left off there.
+#if defined(__SANITIZE_ADDRESS__)
+#define BENCH_COUNT_ALLOCATIONS 0
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define BENCH_COUNT_ALLOCATIONS 0
+#endif
+#endif
+#ifndef BENCH_COUNT_ALLOCATIONS
+#ifdef __GLIBC__
+#define BENCH_COUNT_ALLOCATIONS 1
+#else
+#define BENCH_COUNT_ALLOCATIONS 0
+#endif
+#endif
+
+static atomic_size_t allocation_count;
+
+#if BENCH_COUNT_ALLOCATIONS
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+#endif
+
+// Where a target's output goes: an in-memory array, a stream or descriptor on /dev/null, or a sink.
+typedef struct {
+    char memory[BENCH_OUTPUT_SIZE];
+    FILE *stream;
+    int fd;
+    output_sink_t *sink;
+} bench_output_t;
+
+// One entry point under test, called through a printf-shaped wrapper.
+typedef struct {
+    const char *name;
+    bool is_libc;
+    int (*print)(bench_output_t *output, const char *format, ...);
+} bench_target_t;
+
+static int run_my_snprintf(bench_output_t *output, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = my_vsnprintf(output->memory, sizeof(output->memory), format, args);
+    va_end(args);
+    return result;
+}
+
+static int run_my_fprintf(bench_output_t *output, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = my_vfprintf(output->stream, format, args);
+    va_end(args);
+    return result;
+}
+
+static int run_my_dprintf(bench_output_t *output, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = my_vdprintf(output->fd, format, args);
+    va_end(args);
+    return result;
+}
+
+static int run_sink_printf(bench_output_t *output, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = sink_vprintf(output->sink, format, args);
+    va_end(args);
+    return result;
+}
+
+static int run_libc_snprintf(bench_output_t *output, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = vsnprintf(output->memory, sizeof(output->memory), format, args);
+    va_end(args);
+    return result;
+}
+
+static int run_libc_fprintf(bench_output_t *output, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = vfprintf(output->stream, format, args);
+    va_end(args);
+    return result;
+}
+
+static int run_libc_dprintf(bench_output_t *output, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = vdprintf(output->fd, format, args);
+    va_end(args);
+    return result;
+}
+
+static const bench_target_t targets[] = {
+    {"my_snprintf", false, run_my_snprintf},
+    {"my_printf", false, run_my_fprintf},
+    {"my_dprintf", false, run_my_dprintf},
+    {"sink_printf", false, run_sink_printf},
+    {"snprintf", true, run_libc_snprintf},
+    {"printf", true, run_libc_fprintf},
+    {"dprintf", true, run_libc_dprintf},
+};
+
+// One workload. `i` varies the arguments so no call formats exactly what the previous one did.
+typedef struct {
+    const char *name;
+    bool libc_supported;  // False for this library's extensions, which the C library cannot run.
+    int (*run)(const bench_target_t *target, bench_output_t *output, unsigned i);
+} bench_case_t;
+
+static const char *const words[] = {"alpha", "bravo", "charlie", "delta"};
+
+static int case_decimal(const bench_target_t *target, bench_output_t *output, unsigned i) {
+    return target->print(output, "%d", (int)(i * 2654435761u));
+}
+
+static int case_hex(const bench_target_t *target, bench_output_t *output, unsigned i) {
+    return target->print(output, "%x", i * 2654435761u);
+}
+
+static int case_string(const bench_target_t *target, bench_output_t *output, unsigned i) {
+    return target->print(output, "%s", words[i & 3]);
+}
+
+static int case_pointer(const bench_target_t *target, bench_output_t *output, unsigned i) {
+    return target->print(output, "%p", (void *)(uintptr_t)(0x7ffd00000000u + i * 16u));
+}
+
+static int case_binary(const bench_target_t *target, bench_output_t *output, unsigned i) {
+    return target->print(output, "%b", i * 2654435761u);
+}
+
+static int case_rot13(const bench_target_t *target, bench_output_t *output, unsigned i) {
+    return target->print(output, "%R", words[i & 3]);
+}
+
+static int case_json(const bench_target_t *target, bench_output_t *output, unsigned i) {
+    return target->print(output, "{\"user\":\"%J\",\"agent\":\"%J\"}", words[i & 3],
+                         "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)");
+}
+
+static int case_hexdump(const bench_target_t *target, bench_output_t *output, unsigned i) {
+    static const unsigned char digest[32] = {
+        0x9f, 0x86, 0xd0, 0x81, 0x88, 0x4c, 0x7d, 0x65, 0x9a, 0x2f, 0xea, 0xa0, 0xc5, 0x5a, 0xd0, 0x15,
+        0xa3, 0xbf, 0x4f, 0x1b, 0x2b, 0x0b, 0x82, 0x2c, 0xd1, 0x5d, 0x6c, 0x15, 0xb0, 0xf0, 0x0a, 0x08,
+    };
+    return target->print(output, "sha256=%.*H", (int)(sizeof(digest) - (i & 1)), digest);
+}
+
+static int case_mixed(const bench_target_t *target, bench_output_t *output, unsigned i) {
+    return target->print(output, "[%s] id=%08x count=%-6u ratio=%.3f ptr=%p\n", words[i & 3], i * 2654435761u, i,
+                         (double)i / 7.0, (void *)(uintptr_t)(0x1000u + i));
+}
+
+static int case_long_literal(const bench_target_t *target, bench_output_t *output, unsigned i) {
+    return target->print(output,
+                         "The quick brown fox jumps over the lazy dog while the benchmark keeps on measuring how "
+                         "long it takes to copy a run of literal text that is much longer than any of the "
+                         "conversions around it, which is the common case for log messages and error reports "
+                         "written by real programs, value %d, and then some more literal text to finish it off.\n",
+                         (int)i);
+}
+
+static const bench_case_t cases[] = {
+    {"%d", true, case_decimal},
+    {"%x", true, case_hex},
+    {"%s", true, case_string},
+    {"%p", true, case_pointer},
+    {"%b", false, case_binary},
+    {"%R", false, case_rot13},
+    {"%J", false, case_json},
+    {"%H", false, case_hexdump},
+    {"mixed", true, case_mixed},
+    {"long_literal", true, case_long_literal},
+};
+
+typedef struct {
+    double ns_per_call;
+    double bytes_per_second;
+    double allocations_per_call;
+} bench_result_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static bench_result_t measure(const bench_case_t *bench_case, const bench_target_t *target, bench_output_t *output,
+                              unsigned iterations) {
+    for (unsigned i = 0; i < BENCH_WARMUP_ITERATIONS; i++) {
+        bench_case->run(target, output, i);
+    }
+
+    uint64_t bytes = 0;
+    const size_t allocations_before = atomic_load_explicit(&allocation_count, memory_order_relaxed);
+    const uint64_t start = now_ns();
+    for (unsigned i = 0; i < iterations; i++) {
+        const int written = bench_case->run(target, output, i);
+        bytes += written > 0 ? (uint64_t)written : 0;
+    }
+    const uint64_t elapsed = now_ns() - start;
+    const size_t allocations = atomic_load_explicit(&allocation_count, memory_order_relaxed) - allocations_before;
+
+    bench_result_t result;
+    result.ns_per_call = (double)elapsed / iterations;
+    result.bytes_per_second = elapsed ? (double)bytes * 1e9 / (double)elapsed : 0.0;
+    result.allocations_per_call = (double)allocations / iterations;
+    return result;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [--json] [--iterations N]\n", program);
+}
+
+// Runs every case against every target, writing to /dev/null or memory so I/O cost stays out of
+// the numbers. Prints a table, or with --json one object per measurement for regression tracking.
+int main(int argc, char **argv) {
+    bool json = false;
+    unsigned iterations = BENCH_DEFAULT_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    bench_output_t output;
+    output.fd = open("/dev/null", O_WRONLY);
+    output.stream = output.fd >= 0 ? fdopen(dup(output.fd), "w") : NULL;
+    if (output.fd < 0 || !output.stream) {
+        perror("/dev/null");
+        return 1;
+    }
+
+    initialize_printf();
+    output.sink = create_fd_sink(output.fd, NULL);
+
+    const size_t case_count = sizeof(cases) / sizeof(cases[0]);
+    const size_t target_count = sizeof(targets) / sizeof(targets[0]);
+    if (json) {
+        printf("{\n  \"iterations\": %u,\n  \"allocations_counted\": %s,\n  \"results\": [", iterations,
+               BENCH_COUNT_ALLOCATIONS ? "true" : "false");
+    } else {
+        printf("%-14s %-12s %12s %14s %12s\n", "case", "target", "ns/call", "MB/s", "allocs/call");
+    }
+
+    bool first = true;
+    for (size_t c = 0; c < case_count; c++) {
+        for (size_t t = 0; t < target_count; t++) {
+            if (targets[t].is_libc && !cases[c].libc_supported) {
+                continue;
+            }
+            const bench_result_t result = measure(&cases[c], &targets[t], &output, iterations);
+            if (json) {
+                printf("%s\n    {\"case\": \"%s\", \"target\": \"%s\", \"ns_per_call\": %.2f, "
+                       "\"bytes_per_second\": %.0f, \"allocations_per_call\": %.4f}",
+                       first ? "" : ",", cases[c].name, targets[t].name, result.ns_per_call,
+                       result.bytes_per_second, result.allocations_per_call);
+            } else {
+                printf("%-14s %-12s %12.2f %14.1f %12.4f\n", cases[c].name, targets[t].name, result.ns_per_call,
+                       result.bytes_per_second / 1e6, result.allocations_per_call);
+            }
+            first = false;
+        }
+    }
+    if (json) {
+        printf("\n  ]\n}\n");
+    }
+
+    destroy_sink(output.sink);
+    cleanup_printf();
+    fclose(output.stream);
+    close(output.fd);
+    return 0;
+}
@@ -0,0 +1,63 @@
+#ifndef ASYNC_LOGGER_H
+#define ASYNC_LOGGER_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sink.h"
+
+// Records held by the ring when the configuration does not give a capacity (rounded to a power of two).
+#define ASYNC_LOGGER_DEFAULT_CAPACITY 4096
+// Captured argument bytes a record holds inline; larger records move their payload to the heap.
+#define ASYNC_RECORD_PAYLOAD_SIZE 192
+
+// What a producer does when the ring is full.
+typedef enum {
+    ASYNC_FULL_DROP,   // Discard the message and count it; the caller never waits.
+    ASYNC_FULL_BLOCK   // Wait for the consumer to free a slot.
+} async_full_policy_t;
+
+typedef struct {
+    size_t capacity;                  // Ring slots (0 = ASYNC_LOGGER_DEFAULT_CAPACITY).
+    async_full_policy_t full_policy;  // Behaviour when the ring is full.
+} async_logger_config_t;
+
+// Counters since the logger was created. Each is updated atomically and read individually,
+// so a snapshot taken while producers are running may be slightly inconsistent.
+typedef struct {
+    uint64_t enqueued;      // Messages accepted into the ring.
+    uint64_t dropped;       // Messages discarded because the ring was full (ASYNC_FULL_DROP).
+    uint64_t blocked;       // Producer calls that had to wait for a slot (ASYNC_FULL_BLOCK).
+    uint64_t oversized;     // Records whose payload did not fit inline and went to the heap.
+    uint64_t preformatted;  // Messages formatted on the caller's thread (see async_vprintf).
+    uint64_t written;       // Messages the consumer has formatted and handed to the sink.
+    uint64_t parked;        // Times the consumer went to sleep on an empty ring until a producer woke it.
+} async_logger_stats_t;
+
+// Formats on a background thread: producers copy the format pointer and raw argument values
+// into a lock-free multi-producer ring, and one consumer replays them through the handlers.
+typedef struct async_logger async_logger_t;
+
+// Starts a logger whose consumer writes into `sink` (which must outlive the logger).
+// A NULL config uses the defaults. Returns NULL on failure.
+async_logger_t *create_async_logger(output_sink_t *sink, const async_logger_config_t *config);
+
+// Queues a message. String arguments are copied, so they may change once the call returns;
+// pointers printed with %p are recorded by value. Conversions whose handler was registered without
+// an argument class, positional formats ("%2$s"), and formats the compiled format cache cannot
+// hold are formatted on the caller's thread and queued as text.
+// Returns 0 when queued, or -1 when the message was dropped.
+int async_printf(async_logger_t *logger, const char *format, ...);
+int async_vprintf(async_logger_t *logger, const char *format, va_list args);
+
+// Waits until every message queued before the call has been written to the sink, then flushes the sink.
+void async_logger_flush(async_logger_t *logger);
+
+// Copies the logger's counters into `stats`.
+void async_logger_get_stats(async_logger_t *logger, async_logger_stats_t *stats);
+
+// Drains the ring, stops the consumer and frees the logger (the sink is flushed, not destroyed).
+// Must run before cleanup_printf, since queued records refer to cached compiled formats.
+void destroy_async_logger(async_logger_t *logger);
+
+#endif // ASYNC_LOGGER_H
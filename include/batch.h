@@ -0,0 +1,36 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include "sink.h"
+
+// Rows formatted per block. A block is the unit handed to a worker thread and written to the
+// sink in one piece, so it bounds both the scheduling overhead and the memory held per block.
+#define BATCH_BLOCK_ROWS 1024
+// Most worker threads a parallel batch starts; the calling thread writes their blocks in order.
+#define BATCH_MAX_THREADS 64
+
+// Formats `rows` records with one format string into `sink`. The format is compiled once and
+// each row is rendered from arrays of column values, with no va_list walk or parse per row.
+//
+// After `rows`, pass one array per argument the format consumes, in the order a single call
+// would take them: `const int *` for each '*' width or precision, then the conversion's column,
+// typed by its argument class (`const int *` for %d and %c, `const unsigned *` for %u and %x,
+// `const long *` for %ld, `const double *` for %f, `const char *const *` for %s,
+// `void *const *` for %p, and so on). Row i uses element i of every array.
+//
+// Returns the number of bytes written, or -1 if the sink failed (errno set) or a conversion has
+// no argument class (such as %H, or a handler registered without one) and cannot be batched.
+// Positional formats ("%2$s") are refused the same way.
+long long my_printf_batch(output_sink_t *sink, const char *format, size_t rows, ...);
+
+// Like my_printf_batch, splitting the rows across up to `threads` threads by block. Blocks are
+// written to the sink strictly in row order, and only a few blocks per thread are held in
+// memory at once however many rows there are.
+long long my_printf_batch_parallel(output_sink_t *sink, unsigned threads, const char *format, size_t rows, ...);
+
+// The va_list form of my_printf_batch_parallel; `threads` of 0 or 1 formats on the caller's thread.
+long long my_vprintf_batch(output_sink_t *sink, unsigned threads, const char *format, size_t rows, va_list columns);
+
+#endif // BATCH_H
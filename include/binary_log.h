@@ -0,0 +1,51 @@
+#ifndef BINARY_LOG_H
+#define BINARY_LOG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// Streams that can be in binary mode at once.
+#define BINARY_LOG_MAX_STREAMS 8
+
+// Bytes every binary log starts with; the last one is the encoding version.
+#define BINARY_LOG_MAGIC "\x7f" "PFB\x01"
+#define BINARY_LOG_MAGIC_LENGTH 5
+
+// Record tags. Every integer in a record is an unsigned LEB128 varint.
+//   DEFINE:  id, text length, text, conversion count, one argument class per conversion.
+//            Written the first time a format reaches a stream; ids count up from 1.
+//   MESSAGE: id, then each conversion's '*' values and argument in order. Signed values are
+//            zigzag varints, unsigned values and pointers plain varints, doubles 8 little-endian
+//            bytes, and strings a varint of length + 1 (0 for NULL) followed by the bytes.
+//   TEXT:    length, bytes. Messages that could not be encoded (including positional formats), already formatted.
+typedef enum {
+    BINARY_RECORD_DEFINE = 1,
+    BINARY_RECORD_MESSAGE = 2,
+    BINARY_RECORD_TEXT = 3
+} binary_record_tag_t;
+
+// Per-stream encoder state.
+typedef struct binary_log binary_log_t;
+
+// Switches `stream` to binary mode: my_vfprintf and the functions built on it then write compact
+// records instead of text, and the text is produced later by decode_binary_log. Writes the magic
+// header. Returns 0, or -1 if the stream is already in binary mode or no slot is free.
+int enable_binary_log(FILE *stream);
+
+// Returns `stream` to text mode. Must not run while another thread is printing to the stream.
+void disable_binary_log(FILE *stream);
+
+// Returns the encoder for `stream`, or NULL when it is in text mode. A single atomic load when
+// no stream is in binary mode.
+binary_log_t *find_binary_log(FILE *stream);
+
+// Encodes one message and writes it. Returns the number of record bytes written, or -1 with
+// errno set when the stream rejects a write.
+int write_binary_record(binary_log_t *log, const char *format, va_list args);
+
+// Renders the records read from `in` as text to `out`, through the same specifier handlers
+// my_vfprintf uses; custom specifiers must be registered as they were when the log was written.
+// Returns 0, or -1 if the input is not a binary log, is truncated or is otherwise malformed.
+int decode_binary_log(FILE *in, FILE *out);
+
+#endif // BINARY_LOG_H
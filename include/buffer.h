@@ -4,28 +4,143 @@
 #include <stddef.h>
 #include <stdio.h>
 
+// Size of the storage each thread's reusable buffer starts with (and falls back to after shrinking).
+#define THREAD_BUFFER_INLINE_SIZE 1024
+// Default capacity above which a thread's buffer is shrunk back once a call completes.
+#define THREAD_BUFFER_DEFAULT_HIGH_WATER (64 * 1024)
+// Size of the on-stack buffer used when the thread's buffer is unavailable.
+#define STACK_BUFFER_SIZE 256
+
+// Buffer flags.
+#define BUFFER_FLAG_BORROWED 0x01u  // `data` is caller-provided storage and must not be realloc'd or freed.
+#define BUFFER_FLAG_FIXED    0x02u  // Never grow: bytes past `size` are dropped and counted in `overflow`.
+#define BUFFER_FLAG_SPILLED  0x04u  // The pending reservation was handed out from `spill`, not `data`.
+#define BUFFER_FLAG_COPY_REFERENCES 0x08u  // append_reference_to_buffer copies: the spans die before the write.
+
+// Largest reservation guaranteed to succeed on a fixed buffer (served from `spill` when it does not fit).
+#define BUFFER_SPILL_SIZE 72
+
+// Most spans one message can reference without copying; later spans are copied.
+#define BUFFER_MAX_SEGMENTS 16
+// Shorter spans are cheaper to copy than to hand to the kernel as their own iovec.
+#define BUFFER_SEGMENT_MIN_LENGTH 256
+
+// A span of caller memory the buffer references instead of copying (see append_reference_to_buffer).
+typedef struct {
+    size_t offset;     // Position in the buffer's `data` the span is logically inserted at.
+    const char *data;  // Start of the referenced bytes; must stay valid until the buffer is written.
+    size_t length;     // Number of referenced bytes.
+} buffer_segment_t;
+
+// The uncopied spans of one message, attached by sinks that can write scattered output.
+typedef struct {
+    buffer_segment_t items[BUFFER_MAX_SEGMENTS];
+    size_t count;   // Spans recorded in `items`.
+    size_t length;  // Total bytes across all recorded spans.
+} buffer_segments_t;
+
+// Receives output a streaming buffer hands over before the message is complete.
+// Returns 0, or -1 with errno set.
+typedef int (*buffer_flush_t)(void *context, const char *data, size_t length);
+
+// Streaming mode, attached by entry points whose output can leave in pieces. The buffer grows
+// only up to `limit`; past that, pending bytes are flushed mid-message and spans longer than the
+// limit are passed to `flush` directly, so memory stays bounded however long the output gets.
+typedef struct {
+    buffer_flush_t flush;
+    void *context;    // Passed to `flush`.
+    size_t limit;     // Most bytes the buffer's storage grows to.
+    size_t flushed;   // Bytes handed to `flush` so far.
+    int error;        // errno of the first failed flush, or 0; output after a failure is discarded.
+} buffer_stream_t;
+
 // Structure to represent a dynamic buffer.
 typedef struct {
     char *data;    // Pointer to the buffer's data.
     size_t size;   // Current allocated size of the buffer.
     size_t used;   // Number of bytes currently used in the buffer.
+    unsigned flags;  // BUFFER_FLAG_* bits describing the storage.
+    size_t overflow;  // Bytes dropped by a fixed buffer; `used + overflow` is the would-be length.
+    char spill[BUFFER_SPILL_SIZE];  // Scratch for reservations a fixed buffer cannot hold in place.
+    buffer_segments_t *segments;  // Uncopied spans, or NULL when every append is copied into `data`.
+    buffer_stream_t *stream;  // Streaming mode, or NULL when the whole message is kept until written.
 } buffer_t;
 
 // Initializes a buffer with the given initial size.
 // Returns a pointer to the buffer_t structure or NULL on failure.
 buffer_t *init_buffer(size_t initial_size);
 
+// Initializes a caller-owned buffer structure over caller-provided storage without allocating.
+// The buffer moves to heap storage if it has to grow; release it with release_buffer_storage.
+void init_buffer_with_storage(buffer_t *buffer, char *storage, size_t size);
+
+// Initializes a caller-owned, fixed-capacity buffer over caller memory. It never allocates:
+// appends past `capacity` are truncated and counted in `overflow` instead of growing the buffer.
+void init_fixed_buffer(buffer_t *buffer, char *storage, size_t capacity);
+
 // Appends a string of given length to the buffer, expanding it if necessary.
 void append_to_buffer(buffer_t *buffer, const char *str, size_t len);
 
+// Appends `len` bytes that stay valid until the buffer is written. With segments attached and a
+// span of at least BUFFER_SEGMENT_MIN_LENGTH bytes, only a reference is recorded; otherwise the
+// bytes are copied as by append_to_buffer.
+void append_reference_to_buffer(buffer_t *buffer, const char *str, size_t len);
+
+// Appends `count` copies of `c` with a single bulk fill (used for field padding).
+void fill_buffer(buffer_t *buffer, char c, size_t count);
+
+// Returns a pointer where up to `max_len` bytes can be written directly, growing the buffer if needed.
+// Nothing becomes part of the output until buffer_commit is called with the number of bytes written.
+// Returns NULL only when the space cannot be provided (a fixed buffer asked for more than
+// BUFFER_SPILL_SIZE bytes it cannot hold, or a failed expansion).
+char *buffer_reserve(buffer_t *buffer, size_t max_len);
+
+// Appends `len` bytes (at most the reserved `max_len`) written through the last buffer_reserve.
+void buffer_commit(buffer_t *buffer, size_t len);
+
 // Expands the buffer by a given length.
 // This is called automatically when the buffer runs out of space.
 void expand_buffer(buffer_t *buffer, size_t extra_len);
 
+// Prepares `stream` for attaching to a growable buffer (buffer->stream = stream).
+void init_buffer_stream(buffer_stream_t *stream, buffer_flush_t flush, void *context, size_t limit);
+
+// Flushes the pending bytes of a streaming buffer, referenced segments included, and detaches its stream.
+// Returns 0, or -1 with errno set if any flush of the message failed.
+int finish_buffer_stream(buffer_t *buffer);
+
 // Flushes the buffer's content to the given stream (e.g., stdout or a file).
 void flush_buffer(buffer_t *buffer, FILE *stream);
 
+// Writes the buffer's content, including referenced segments, to a file descriptor with write(2),
+// or writev(2) when segments are present. Retries after EINTR and resumes after partial writes.
+// Returns 0 on success or -1 with errno set. Resets `used` and the segments either way.
+int write_buffer_to_fd(buffer_t *buffer, int fd);
+
+// Writes `length` bytes to a file descriptor, retrying after EINTR and partial writes.
+// Returns 0 on success or -1 with errno set.
+int write_to_fd(int fd, const char *data, size_t length);
+
 // Frees the memory associated with the buffer.
 void free_buffer(buffer_t *buffer);
 
+// Frees any heap storage a caller-owned buffer (see init_buffer_with_storage) grew into.
+void release_buffer_storage(buffer_t *buffer);
+
+// Returns this thread's reusable, empty output buffer, or NULL if it is already in use
+// (e.g. a handler formatting recursively). Must be paired with release_thread_buffer.
+buffer_t *acquire_thread_buffer(void);
+
+// Returns the thread's buffer for reuse, shrinking it back to its inline storage
+// if the last message grew it beyond the high-water mark.
+void release_thread_buffer(buffer_t *buffer);
+
+// Sets the capacity above which thread buffers are shrunk after use (applies to all threads).
+// It is also the streaming limit of the entry points that stream, so no message grows a thread
+// buffer past it.
+void set_thread_buffer_high_water(size_t bytes);
+
+// Returns the current high-water mark.
+size_t get_thread_buffer_high_water(void);
+
 #endif // BUFFER_H
@@ -0,0 +1,66 @@
+#ifndef COMPILED_FORMAT_H
+#define COMPILED_FORMAT_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include "buffer.h"
+#include "format_parser.h"
+
+// Number of slots in the process-wide compiled format cache (must be a power of two).
+#define COMPILED_FORMAT_CACHE_SIZE 256
+// Number of neighbouring slots probed before a format is treated as uncacheable.
+#define COMPILED_FORMAT_CACHE_PROBES 8
+
+// Kinds of operations a compiled format is made of.
+typedef enum {
+    FORMAT_OP_LITERAL,     // Copy a span of literal text.
+    FORMAT_OP_CONVERSION   // Invoke a specifier handler.
+} format_op_kind_t;
+
+// A single step of a compiled format.
+typedef struct {
+    format_op_kind_t kind;  // What this step does.
+    const char *literal;    // Start of the literal span, or of a conversion's specification text.
+    size_t literal_length;  // Length of the literal span or specification.
+    format_info_t info;     // Parsed specifier (FORMAT_OP_CONVERSION only).
+} format_op_t;
+
+// A format string parsed once into a flat list of operations.
+typedef struct compiled_format {
+    const char *format;               // Format pointer this entry was compiled from (cache key).
+    const char *text;                 // Private copy of the format text; literal ops point into it.
+    size_t length;                    // Length of the format text, excluding the terminator.
+    unsigned generation;              // Specifier registry generation the handlers were resolved in.
+    size_t op_count;                  // Number of operations in `ops`.
+    size_t invalid_count;             // Invalid specifiers kept as literal text (for statistics).
+    size_t position_count;            // Argument slots a positional format reads; 0 if it is not positional.
+    unsigned char slot_classes[FORMAT_MAX_POSITIONS];  // format_arg_class_t of each slot (positional only).
+    struct compiled_format *retired;  // Link in the list of replaced entries awaiting cleanup.
+    format_op_t ops[];                // The operations, in output order.
+} compiled_format_t;
+
+// Parses a format string into a compiled format.
+// A format with any "%n$" argument numbers is positional: every conversion is given the slots it
+// reads (a conversion without a number takes the slot after the previous argument), and the class
+// of each slot is recorded. Conversions that cannot be gathered that way (no argument class, a
+// slot past FORMAT_MAX_POSITIONS, or a slot already read at another class) stay literal text.
+// Returns NULL on allocation failure. The result must be released with free_compiled_format.
+compiled_format_t *compile_format(const char *format);
+
+// Frees a compiled format returned by compile_format.
+void free_compiled_format(compiled_format_t *compiled);
+
+// Replays a compiled format, consuming arguments from `args` and appending the output to `buffer`.
+// A positional format first reads all of its arguments in one sweep, in slot order, and its
+// handlers are then run on those values; a slot no conversion reads is taken as an int.
+void render_compiled_format(const compiled_format_t *compiled, va_list *args, buffer_t *buffer);
+
+// Returns the cached compiled form of `format`, compiling and caching it on first use.
+// Returns NULL when the format cannot be cached (cache full, or the pointer now holds different text);
+// callers should then format the string directly.
+const compiled_format_t *get_compiled_format(const char *format);
+
+// Frees every cached compiled format. Must not run concurrently with formatting.
+void clear_compiled_format_cache(void);
+
+#endif // COMPILED_FORMAT_H
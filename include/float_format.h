@@ -0,0 +1,20 @@
+#ifndef FLOAT_FORMAT_H
+#define FLOAT_FORMAT_H
+
+#include "buffer.h"
+#include "format_parser.h"
+
+// Precision used by %f, %e and %g when none is given.
+#define FLOAT_DEFAULT_PRECISION 6
+
+// Largest number of significant decimal digits a double's exact expansion can have
+// (a subnormal's 5^1074 multiple), plus room for a rounding carry.
+#define FLOAT_MAX_DIGITS 800
+
+// Formats `value` for the floating-point conversion in info->specifier
+// ('f', 'F', 'e', 'E', 'g', 'G', 'a' or 'A'), honoring flags, width and precision.
+// Output matches glibc digit for digit: digits come from the exact binary value and are
+// rounded half-to-even, never from an approximate scaled product.
+void format_double(const format_info_t *info, double value, buffer_t *buffer);
+
+#endif // FLOAT_FORMAT_H
@@ -3,43 +3,172 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "buffer.h"
 
 // Constants for format specifier lengths and other important values.
 #define FORMAT_SPECIFIER_START '%'
-#define DEFAULT_HASHMAP_CAPACITY 16  // Initial hashmap capacity.
+#define SPECIFIER_TABLE_SIZE 256  // One dispatch slot per possible specifier byte.
 #define INVALID_SPECIFIER_LENGTH 1  // Default length for invalid specifiers.
-#define MAX_SPECIFIER_LENGTH 2  // Maximum length of a valid format specifier, including '%'.
+#define NAMED_SPECIFIER_START '{'  // Opens a named conversion, "%{name}".
+#define NAMED_SPECIFIER_END '}'
+#define NAMED_SPECIFIER_MAX_LENGTH 63  // Longest name accepted by register_named_specifier.
+#define FORMAT_POSITION_END '$'  // Ends the argument number of a positional conversion, "%2$s".
+#define FORMAT_MAX_POSITIONS 64  // Highest argument number a positional format may use.
 
-// Structure to hold information about a parsed format specifier.
-typedef struct {
-    bool valid;  // Indicates if the format specifier is valid.
-    char specifier;  // The format specifier character (e.g., 'd', 's').
-    int length;  // The length of the parsed format specifier (e.g., '%d' is 2 characters long).
-    void (*handler)(va_list args, buffer_t *buffer);  // Function to handle the format specifier.
-} format_info_t;
+// Length modifiers that may precede a conversion character (C99 7.19.6.1).
+// Each one selects its own row of the dispatch table.
+typedef enum {
+    LENGTH_NONE,  // No modifier: int / unsigned int.
+    LENGTH_HH,    // 'hh': signed char / unsigned char.
+    LENGTH_H,     // 'h': short / unsigned short.
+    LENGTH_L,     // 'l': long / unsigned long.
+    LENGTH_LL,    // 'll': long long / unsigned long long.
+    LENGTH_Z,     // 'z': size_t.
+    LENGTH_J,     // 'j': intmax_t / uintmax_t.
+    LENGTH_T,     // 't': ptrdiff_t.
+    LENGTH_MODIFIER_COUNT
+} length_modifier_t;
+
+// Flags of a conversion specification, stored in format_info_t.flags.
+// A specification with none of them set is "plain" and takes each handler's fast path.
+#define FORMAT_FLAG_LEFT           0x001  // '-': left-justify within the field width.
+#define FORMAT_FLAG_PLUS           0x002  // '+': always print a sign for signed conversions.
+#define FORMAT_FLAG_SPACE          0x004  // ' ': print a space where a '+' would go.
+#define FORMAT_FLAG_ALTERNATE      0x008  // '#': alternate form ("0x" prefix, leading octal zero).
+#define FORMAT_FLAG_ZERO           0x010  // '0': pad numbers with zeros instead of spaces.
+#define FORMAT_FLAG_WIDTH          0x020  // A field width is present in `width`.
+#define FORMAT_FLAG_PRECISION      0x040  // A precision is present in `precision`.
+#define FORMAT_FLAG_WIDTH_ARG      0x080  // The width is taken from an int argument ('*').
+#define FORMAT_FLAG_PRECISION_ARG  0x100  // The precision is taken from an int argument ('.*').
+
+// How a conversion's argument is passed, so code that stores arguments for later formatting
+// (such as the asynchronous logger) knows what to fetch from a va_list and how to pass it back.
+// FORMAT_ARG_UNKNOWN marks handlers registered without this information.
+typedef enum {
+    FORMAT_ARG_UNKNOWN,
+    FORMAT_ARG_INT,
+    FORMAT_ARG_UNSIGNED,
+    FORMAT_ARG_LONG,
+    FORMAT_ARG_UNSIGNED_LONG,
+    FORMAT_ARG_LONG_LONG,
+    FORMAT_ARG_UNSIGNED_LONG_LONG,
+    FORMAT_ARG_INTMAX,
+    FORMAT_ARG_UINTMAX,
+    FORMAT_ARG_SIZE,
+    FORMAT_ARG_PTRDIFF,
+    FORMAT_ARG_DOUBLE,
+    FORMAT_ARG_POINTER,
+    FORMAT_ARG_STRING,  // NUL-terminated char *, read up to the precision if one is given.
+    FORMAT_ARG_CLASS_COUNT
+} format_arg_class_t;
+
+// One argument value of any class, for code that stores arguments and formats them later.
+typedef union {
+    int i;                    // FORMAT_ARG_INT
+    unsigned u;               // FORMAT_ARG_UNSIGNED
+    long l;                   // FORMAT_ARG_LONG
+    unsigned long ul;         // FORMAT_ARG_UNSIGNED_LONG
+    long long ll;             // FORMAT_ARG_LONG_LONG
+    unsigned long long ull;   // FORMAT_ARG_UNSIGNED_LONG_LONG
+    intmax_t j;               // FORMAT_ARG_INTMAX
+    uintmax_t uj;             // FORMAT_ARG_UINTMAX
+    size_t z;                 // FORMAT_ARG_SIZE
+    ptrdiff_t t;              // FORMAT_ARG_PTRDIFF
+    double d;                 // FORMAT_ARG_DOUBLE
+    void *p;                  // FORMAT_ARG_POINTER
+    const char *s;            // FORMAT_ARG_STRING
+} format_value_t;
+
+typedef struct format_info format_info_t;
 
 // Typedef for a function pointer that handles a specific format specifier.
-typedef void (*format_handler_t)(va_list args, buffer_t *buffer);
+// Handlers receive the parsed specification (with '*' widths already resolved) and consume
+// their argument through a pointer, so the caller's va_list stays valid on every ABI.
+typedef void (*format_handler_t)(const format_info_t *info, va_list *args, buffer_t *buffer);
 
-// Wrapper structure to store format handlers in the hashmap.
-typedef struct {
-    format_handler_t handler;  // Directly store the function pointer here.
-} function_wrapper_t;
+// Structure to hold information about a parsed format specifier.
+struct format_info {
+    bool valid;  // Indicates if the format specifier is valid.
+    char specifier;  // The format specifier character (e.g., 'd', 's'); '{' for named conversions.
+    length_modifier_t length_modifier;  // The length modifier preceding the specifier, if any.
+    unsigned flags;  // FORMAT_FLAG_* bits.
+    int width;  // Minimum field width (meaningful with FORMAT_FLAG_WIDTH).
+    int precision;  // Precision (meaningful with FORMAT_FLAG_PRECISION).
+    int length;  // The length of the parsed format specifier (e.g., '%d' is 2 characters long, '%-08lld' 7).
+    format_handler_t handler;  // Function to handle the format specifier.
+    format_arg_class_t arg_class;  // How the handler's argument is passed.
+    const char *name;  // The name of a "%{name}" conversion, NULL otherwise. Valid until cleanup.
+    int position;  // Argument number of "%n$", 0 when the argument is taken in order.
+    int width_position;  // Argument number of a "*n$" width, 0 when taken in order or absent.
+    int precision_position;  // Argument number of a ".*n$" precision, 0 when taken in order or absent.
+};
 
-// Initializes the hashmap of format specifiers. Should be called before using the parser.
+// Bits of the per-byte classification table consulted by the parser.
+#define SPECIFIER_FLAG_CONVERSION 0x01  // A handler is registered for this byte (with any length modifier).
+#define SPECIFIER_FLAG_LENGTH     0x02  // The byte starts a length modifier ('h', 'l', 'z', 'j', 't').
+#define SPECIFIER_FLAG_DIGIT      0x04  // The byte is a decimal digit (width or precision).
+
+// Initializes the table of format specifiers. Should be called before using the parser.
 void initialize_format_specifiers(void);
 
-// Cleans up the hashmap and any other resources used by the parser.
+// Clears the specifier table and any other resources used by the parser.
 void cleanup_format_specifiers(void);
 
 // Parses the format string starting at a '%' character and returns information about the specifier.
+// POSIX argument numbers ("%2$s", "%1$*3$d") are recorded in the position fields; numbers above
+// FORMAT_MAX_POSITIONS make the specification invalid.
 format_info_t parse_format(const char *format);
 
-// Registers a format specifier and its corresponding handler function in the hashmap.
+// Calls the handler for a parsed specification, first fetching any '*' width or precision
+// from `args` (a negative width means left-justify, a negative precision means none).
+void invoke_format_handler(const format_info_t *info, va_list *args, buffer_t *buffer);
+
+// Folds the values of '*' width and precision arguments into `info`: a negative width means
+// left-justify, a negative precision means none. The '*' flags are cleared.
+void resolve_star_arguments(format_info_t *info, int width, int precision);
+
+// Fetches one argument of class `arg_class` from `args`. Returns false for FORMAT_ARG_UNKNOWN,
+// leaving `args` untouched.
+bool fetch_format_value(format_arg_class_t arg_class, va_list *args, format_value_t *value);
+
+// Calls the handler of `info` (whose '*' values must already be resolved) with a stored value,
+// passing it through a real va_list so the output is identical to formatting it directly.
+void invoke_format_handler_with_value(const format_info_t *info, const format_value_t *value, buffer_t *buffer);
+
+// Registers a format specifier and its corresponding handler function in the dispatch table.
+// Passing a NULL handler unregisters the specifier.
 void register_specifier(char specifier, format_handler_t handler);
 
-// Retrieves the handler function for a specific format specifier from the hashmap.
+// Registers the handler for a specifier used with a given length modifier (e.g. LENGTH_LL, 'd' for "%lld").
+// Passing a NULL handler unregisters that combination.
+void register_length_specifier(length_modifier_t modifier, char specifier, format_handler_t handler);
+
+// Registers a handler together with the class of argument it consumes, which lets deferred
+// formatting capture its argument instead of formatting on the caller's thread.
+void register_typed_specifier(length_modifier_t modifier, char specifier, format_handler_t handler,
+                              format_arg_class_t arg_class);
+
+// Registers a handler for the named conversion "%{name}", which takes flags, a width and a
+// precision like any other (e.g. "%-15{ipv4}") but no length modifier. Names are 1 to
+// NAMED_SPECIFIER_MAX_LENGTH bytes and may not contain '}'. Passing a NULL handler unregisters it.
+void register_named_specifier(const char *name, format_handler_t handler, format_arg_class_t arg_class);
+
+// Retrieves the handler registered under `name`, or NULL if there is none.
+format_handler_t get_named_format_handler(const char *name);
+
+// Retrieves the handler function for a specific format specifier from the dispatch table.
 format_handler_t get_format_handler(char specifier);
 
+// Retrieves the handler for a specifier used with a given length modifier, or NULL if none is registered.
+format_handler_t get_length_format_handler(length_modifier_t modifier, char specifier);
+
+// Returns the SPECIFIER_FLAG_* classification bits for a byte following '%'.
+unsigned char get_specifier_flags(char specifier);
+
+// Returns a counter that changes whenever the set of registered handlers changes.
+// Lets callers that cache resolved handlers (such as compiled formats) detect stale entries.
+unsigned get_format_specifiers_generation(void);
+
 #endif // FORMAT_PARSER_H
@@ -5,33 +5,60 @@
 #ifndef HASHMAP_H
 #define HASHMAP_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
-// A bucket represents a single key-value pair in the hashmap.
-// The bucket is part of a linked list to handle collisions.
-typedef struct bucket {
-    char *key;             // Key for the entry
+// Smallest number of slots a hashmap is created with.
+#define HASHMAP_MIN_CAPACITY 8
+// The table doubles once it would be fuller than this. Robin Hood probing keeps probe
+// sequences short up to high loads, so little memory is left idle.
+#define HASHMAP_MAX_LOAD_PERCENT 85
+// Size of the blocks keys are copied into.
+#define HASHMAP_ARENA_BLOCK_SIZE 4096
+
+// A slot of the open-addressing table. `hash` is the key's full hash, kept so probing compares
+// and relocates entries without rehashing or touching the key; 0 marks an empty slot.
+typedef struct {
+    size_t hash;
+    const char *key;       // Copy of the key in the map's arena.
     void *value;           // Associated value
-    struct bucket *next;   // Pointer to the next bucket in case of collisions
-} bucket_t;
+} hashmap_entry_t;
 
+// A block of the arena holding key copies. Blocks are freed together with the map.
+typedef struct hashmap_arena_block {
+    struct hashmap_arena_block *next;
+    size_t used;
+    size_t size;
+    char data[];
+} hashmap_arena_block_t;
 
-// The hashmap structure contains an array of buckets, with
-// a defined capacity and current size (number of key-value pairs).
+// The hashmap structure: a power-of-two array of slots, probed linearly from each key's home slot
+// with Robin Hood displacement, so lookups stay within one or two cache lines.
 typedef struct {
-    size_t capacity;       // Total number of slots in the hashmap
-    size_t size;           // Current number of key-value pairs stored
-    bucket_t **buckets;    // Array of bucket pointers (linked lists)
+    size_t capacity;                 // Total number of slots (a power of two).
+    size_t size;                     // Current number of key-value pairs stored
+    unsigned shift;                  // 64 - log2(capacity): turns a mixed hash into a slot index.
+    hashmap_entry_t *entries;        // The slots.
+    hashmap_arena_block_t *arena;    // Key storage, newest block first.
+    size_t arena_live;               // Arena bytes held by keys still in the map.
+    size_t arena_dead;               // Arena bytes left behind by removed keys.
 } hashmap_t;
 
+// Creates a map able to hold `initial_capacity` entries before it first grows. Returns NULL on failure.
 hashmap_t *create_hashmap(size_t initial_capacity);
-void insert_hashmap(hashmap_t *map, const char *key, void *value);
-void *get_hashmap(hashmap_t *map, const char *key);
+
+// Inserts a key-value pair, or updates the value if the key is present. The key is copied.
+// Returns false if the map could not grow or copy the key (the map is left unchanged).
+bool insert_hashmap(hashmap_t *map, const char *key, void *value);
+
+// Returns the value stored for `key`, or NULL if it is absent.
+void *get_hashmap(const hashmap_t *map, const char *key);
+
+// Removes `key`. Returns false if it was not present.
+bool remove_hashmap(hashmap_t *map, const char *key);
+
 void free_hashmap(hashmap_t *map);
 
 size_t hash_function(const char *key);
 
-bucket_t *create_bucket(const char *key, void *value);
-void free_bucket(bucket_t *bucket);
-
 #endif //HASHMAP_H
@@ -0,0 +1,38 @@
+#ifndef INTEGER_FORMAT_H
+#define INTEGER_FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest output of any conversion below: 64 binary digits plus a sign.
+#define INTEGER_FORMAT_MAX_LENGTH 65
+
+// Digit tables for power-of-two bases, indexed by digit value.
+extern const char lower_digits[16];
+extern const char upper_digits[16];
+
+// Number of decimal digits needed for a value (at least 1).
+size_t decimal_length_u32(uint32_t value);
+size_t decimal_length_u64(uint64_t value);
+
+// Number of digits needed for a value in base 2^shift (at least 1).
+size_t pow2_length_u64(uint64_t value, unsigned shift);
+
+// Writes exactly `length` digits of `value` right-to-left into out[0..length).
+// `length` is normally the matching *_length result; a larger length zero-fills the front.
+void write_decimal_u32(char *out, uint32_t value, size_t length);
+void write_decimal_u64(char *out, uint64_t value, size_t length);
+void write_pow2_u64(char *out, uint64_t value, size_t length, unsigned shift, const char *digits);
+
+// Converts a value into `out` without a terminator and returns the number of characters written.
+// 8- and 16-bit values are promoted by the caller and go through the 32-bit kernels.
+size_t format_u32(uint32_t value, char *out);
+size_t format_u64(uint64_t value, char *out);
+size_t format_i32(int32_t value, char *out);
+size_t format_i64(int64_t value, char *out);
+size_t format_hex_u64(uint64_t value, char *out, bool uppercase);
+size_t format_oct_u64(uint64_t value, char *out);
+size_t format_bin_u64(uint64_t value, char *out);
+
+#endif // INTEGER_FORMAT_H
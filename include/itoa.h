@@ -1,7 +0,0 @@
-#ifndef ITOA_H
-#define ITOA_H
-
-// Converts an integer to a string. 'base' can be 10 (decimal) or 16 (hexadecimal).
-char *itoa(int value, char *str, int base);
-
-#endif // ITOA_H
@@ -8,6 +8,12 @@
 // Public function prototype for my_printf, mimicking the behavior of printf.
 int my_printf(const char *format, ...);
 
+// Public function prototype for my_snprintf, mimicking the behavior of snprintf.
+int my_snprintf(char *str, size_t size, const char *format, ...);
+
+// Public function prototype for my_dprintf, mimicking the behavior of dprintf.
+int my_dprintf(int fd, const char *format, ...);
+
 // Public function prototype for initializing resources (if necessary).
 void initialize_printf(void);
 
@@ -0,0 +1,64 @@
+#ifndef PRINTF_STATS_H
+#define PRINTF_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Runtime statistics are compiled in only when PRINTF_STATS is defined (the PRINTF_STATS CMake
+// option). Without it every recording macro below expands to nothing, and printf_stats_get
+// reports zeros with `enabled` false.
+
+// Entry points counted separately. my_printf and my_fprintf-style calls are counted under
+// PRINTF_ENTRY_VFPRINTF, my_snprintf under PRINTF_ENTRY_VSNPRINTF, and so on.
+typedef enum {
+    PRINTF_ENTRY_VFPRINTF,
+    PRINTF_ENTRY_VSNPRINTF,
+    PRINTF_ENTRY_VDPRINTF,
+    PRINTF_ENTRY_SINK,
+    PRINTF_ENTRY_ASYNC,
+    PRINTF_ENTRY_BATCH,  // One call per batch, however many rows it formats.
+    PRINTF_ENTRY_COUNT
+} printf_entry_point_t;
+
+// Totals over every thread since the last printf_stats_reset.
+typedef struct {
+    bool enabled;                          // Statistics were compiled in.
+    uint64_t calls[PRINTF_ENTRY_COUNT];    // Calls per entry point.
+    uint64_t bytes_emitted;                // Formatted bytes produced (for async loggers, when written).
+    uint64_t buffer_expansions;            // expand_buffer reallocations.
+    uint64_t invalid_specifiers;           // '%' sequences printed as-is because they did not parse.
+    uint64_t specifier_calls[256];         // Handler invocations, indexed by conversion character.
+    uint64_t specifier_cycles[256];        // Cycles spent in those handlers while timing was on.
+} printf_stats_t;
+
+// Fills `stats` with the sum of every thread's counters, including threads that have exited.
+void printf_stats_get(printf_stats_t *stats);
+
+// Starts a new measurement period: later printf_stats_get calls count from here.
+void printf_stats_reset(void);
+
+// Turns per-specifier timing on or off (off by default). Timing reads the cycle counter twice per
+// conversion, so it costs more than counting alone.
+void printf_stats_set_timing(bool enabled);
+
+#ifdef PRINTF_STATS
+void printf_stats_record_call(printf_entry_point_t entry, size_t bytes);
+void printf_stats_record_bytes(size_t bytes);
+void printf_stats_record_expansion(void);
+void printf_stats_record_invalid(size_t count);
+uint64_t printf_stats_timer_start(void);
+void printf_stats_record_specifier(unsigned char specifier, uint64_t start);
+
+#define PRINTF_STATS_CALL(entry, bytes) printf_stats_record_call((entry), (bytes))
+#define PRINTF_STATS_BYTES(bytes) printf_stats_record_bytes(bytes)
+#define PRINTF_STATS_EXPANSION() printf_stats_record_expansion()
+#define PRINTF_STATS_INVALID(count) printf_stats_record_invalid(count)
+#else
+#define PRINTF_STATS_CALL(entry, bytes) ((void)0)
+#define PRINTF_STATS_BYTES(bytes) ((void)0)
+#define PRINTF_STATS_EXPANSION() ((void)0)
+#define PRINTF_STATS_INVALID(count) ((void)0)
+#endif
+
+#endif // PRINTF_STATS_H
@@ -0,0 +1,56 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Pending bytes that trigger a flush when a policy does not set its own threshold.
+#define SINK_DEFAULT_FLUSH_BYTES (32 * 1024)
+// Most sinks tracked at once for the exit and crash flushes; further sinks still work but are
+// only flushed explicitly or when destroyed.
+#define SINK_MAX_REGISTERED 64
+
+// When a sink writes out what it has accumulated. Conditions combine: whichever is met first
+// flushes, and sink_flush always does.
+typedef struct {
+    size_t flush_bytes;         // Flush once this many bytes are pending (0 = SINK_DEFAULT_FLUSH_BYTES).
+    bool flush_on_newline;      // Flush after any message containing '\n' (line buffering).
+    unsigned max_latency_ms;    // Flush output that has waited this long, even if idle (0 = no limit).
+} sink_policy_t;
+
+// A long-lived output target accumulating many formatted messages between writes.
+typedef struct output_sink output_sink_t;
+
+// Creates a sink writing to file descriptor `fd` with write(2)/writev(2).
+// A NULL policy uses the defaults (byte threshold only). Returns NULL on failure.
+output_sink_t *create_fd_sink(int fd, const sink_policy_t *policy);
+
+// Creates a sink writing to `stream`; each flush also flushes the stream. Returns NULL on failure.
+output_sink_t *create_stream_sink(FILE *stream, const sink_policy_t *policy);
+
+// Formats a message into the sink, flushing if the policy says so. A message longer than the
+// thread buffer high-water mark is passed on in pieces while it is formatted, so it needs no
+// more memory than that, but other threads' messages may land between its pieces.
+// Returns the number of bytes formatted, or -1 with errno set if a triggered flush failed.
+int sink_printf(output_sink_t *sink, const char *format, ...);
+int sink_vprintf(output_sink_t *sink, const char *format, va_list args);
+
+// Appends `length` already formatted bytes, flushing if the policy says so. Data at least as
+// long as the flush threshold is written straight to the target after the pending bytes.
+// Returns 0, or -1 with errno set if a triggered flush failed.
+int sink_write(output_sink_t *sink, const char *data, size_t length);
+
+// Writes out everything pending. Returns 0 on success or -1 with errno set.
+int sink_flush(output_sink_t *sink);
+
+// Flushes and frees the sink.
+void destroy_sink(output_sink_t *sink);
+
+// Installs handlers for fatal signals (SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT) that write out
+// every registered sink's pending bytes before the default action runs. Opt-in, since it replaces
+// any handlers the program already has for those signals.
+void install_sink_crash_handler(void);
+
+#endif // SINK_H
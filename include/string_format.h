@@ -0,0 +1,59 @@
+#ifndef STRING_FORMAT_H
+#define STRING_FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "buffer.h"
+
+// Longest escape sequence either escaping style writes for one input byte ("\u001f").
+#define STRING_ESCAPE_MAX_LENGTH 6
+
+// Number of bytes append_json_escaped writes for `text`.
+size_t json_escaped_length(const char *text, size_t length);
+
+// Appends `text` escaped for the inside of a JSON string: '"', '\\' and control bytes become
+// escapes and everything else, including UTF-8 sequences, is copied. The bytes are scanned
+// 16 (or, with AVX2, 32) at a time and each clean run is appended with a single copy.
+void append_json_escaped(buffer_t *buffer, const char *text, size_t length);
+
+// Number of bytes append_c_quoted writes for `text`, quotes included.
+size_t c_quoted_length(const char *text, size_t length);
+
+// Appends `text` as a double-quoted C string literal that is plain printable ASCII: '"' and
+// '\\' are escaped, control characters use their C escapes, and any other byte outside
+// 0x20-0x7e is written as a three-digit octal escape. Scanned like append_json_escaped.
+void append_c_quoted(buffer_t *buffer, const char *text, size_t length);
+
+// Letter transforms applied by append_transformed; bytes other than ASCII letters never change.
+typedef enum {
+    STRING_TRANSFORM_ROT13,  // Rotate letters by 13 places, keeping their case (%R).
+    STRING_TRANSFORM_UPPER,  // %{upper}
+    STRING_TRANSFORM_LOWER,  // %{lower}
+} string_transform_t;
+
+// Appends `text` with `transform` applied. The output span is reserved once where the buffer
+// allows it, and 16 (or, with AVX2, 32) bytes are transformed at a time with compare masks and a
+// masked add, so letters cost no branches.
+void append_transformed(buffer_t *buffer, const char *text, size_t length, string_transform_t transform);
+
+// Input bytes per line of the canonical hexdump layout, and the length of a full line:
+// an 8-digit offset, two groups of eight hex bytes, and the bytes as text between '|'s.
+#define HEXDUMP_LINE_BYTES 16
+#define HEXDUMP_LINE_LENGTH 79
+
+// Number of bytes append_hex writes for `length` input bytes, with or without separators.
+size_t hex_length(size_t length, bool separated);
+
+// Appends two hex digits per byte of `bytes`, with a space between bytes when `separated`.
+// Blocks of 16 bytes are converted at once: the nibbles are split with a shift and mask, mapped
+// to digits with a pshufb table lookup (SSSE3) or compare-and-add (SSE2), and interleaved.
+void append_hex(buffer_t *buffer, const void *bytes, size_t length, bool uppercase, bool separated);
+
+// Number of bytes append_hexdump writes for `length` input bytes.
+size_t hexdump_length(size_t length);
+
+// Appends `bytes` in the layout of `hexdump -C -v`: lines of offset, hex and printable text,
+// followed by a line holding the total length. Nothing is written for an empty range.
+void append_hexdump(buffer_t *buffer, const void *bytes, size_t length, bool uppercase);
+
+#endif // STRING_FORMAT_H
@@ -5,7 +5,21 @@
 #include <stdio.h>
 #include "buffer.h"
 
+// Formats into `buffer` with the pipeline every entry point shares (compiled format cache,
+// falling back to direct parsing). `args` is copied, so the caller's list is left untouched.
+void format_to_buffer(const char *format, va_list args, buffer_t *buffer);
+
 // Public function prototype for my_vfprintf, which handles formatted output to a FILE stream.
+// Output longer than the thread buffer high-water mark is written in pieces as it is formatted.
+// Returns the number of bytes written, or -1 with errno set if writing to the stream failed.
 int my_vfprintf(FILE *stream, const char *format, va_list args);
 
+// Formats into `str`, writing at most `size` bytes including the terminating NUL (C99 vsnprintf semantics).
+// Returns the length the full output would have had, or -1 if it does not fit in an int.
+int my_vsnprintf(char *str, size_t size, const char *format, va_list args);
+
+// Formats straight to file descriptor `fd` with write(2)/writev(2), bypassing stdio.
+// Returns the number of bytes written, or -1 with errno set if the write failed.
+int my_vdprintf(int fd, const char *format, va_list args);
+
 #endif // VPRINTF_H
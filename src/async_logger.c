@@ -0,0 +1,425 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include "../include/async_logger.h"
+#include "../include/buffer.h"
+#include "../include/compiled_format.h"
+#include "../include/format_parser.h"
+#include "../include/vfprintf.h"
+#include "../include/printf_stats.h"
+#include "../include/error_handling.h"
+
+// Rendered bytes the consumer gathers before handing them to the sink in one call.
+#define ASYNC_BATCH_BYTES (16 * 1024)
+// Empty polls the consumer answers with a yield before it parks until a producer wakes it.
+#define ASYNC_IDLE_SPINS 64
+
+// Records are a sequence of format_value_t in argument order ('*' values first, as `i`). A string
+// is stored as its length in `z` (SIZE_MAX for NULL) followed by its bytes and a terminator.
+
+// A ring slot. `sequence` is the Vyukov bounded-queue ticket: it equals the slot's position
+// when free, position + 1 once a record is published, and advances by the capacity when consumed.
+typedef struct {
+    atomic_size_t sequence;
+    const compiled_format_t *compiled;  // Format to replay, or NULL when the payload is finished text.
+    size_t length;                      // Payload bytes.
+    char *heap_payload;                 // Payload that did not fit in `payload`, or NULL.
+    char payload[ASYNC_RECORD_PAYLOAD_SIZE];
+} async_slot_t;
+
+// The producer and consumer positions sit on their own cache lines so the consumer's progress
+// does not invalidate the line every producer claims slots from.
+struct async_logger {
+    async_slot_t *slots;
+    size_t mask;
+    output_sink_t *sink;
+    async_full_policy_t full_policy;
+    thrd_t consumer;
+    atomic_bool running;
+    atomic_bool parked;  // The consumer is asleep (or about to be) on `wake`.
+    mtx_t park_lock;     // Held by the consumer from announcing `parked` until it waits.
+    cnd_t wake;
+    _Alignas(64) atomic_size_t enqueue_position;    // Next position a producer will claim.
+    _Alignas(64) atomic_size_t completed_position;  // Records before this have reached the sink.
+    _Alignas(64) _Atomic uint64_t enqueued;
+    _Atomic uint64_t dropped;
+    _Atomic uint64_t blocked;
+    _Atomic uint64_t oversized;
+    _Atomic uint64_t preformatted;
+    _Atomic uint64_t written;
+    _Atomic uint64_t parked_count;
+};
+
+// Wakes a parked consumer. This seq_cst load pairs with park_consumer through the seq_cst claim
+// of `enqueue_position`: either the consumer's re-check sees the claim, or this load sees `parked`.
+// No fence is needed, so on x86 the producer pays one plain load here.
+static void wake_consumer(async_logger_t *logger) {
+    if (atomic_load_explicit(&logger->parked, memory_order_seq_cst)) {
+        mtx_lock(&logger->park_lock);
+        cnd_signal(&logger->wake);
+        mtx_unlock(&logger->park_lock);
+    }
+}
+
+static void append_value(buffer_t *staging, const format_value_t *value) {
+    append_to_buffer(staging, (const char *)value, sizeof(*value));
+}
+
+// Copies each conversion's raw argument into `staging`, using the argument class recorded with
+// its handler. Returns false if a handler's class is unknown or the format is positional, in which
+// case the caller formats the message itself.
+static bool capture_arguments(const compiled_format_t *compiled, va_list *args, buffer_t *staging) {
+    if (compiled->position_count > 0) {
+        return false;
+    }
+    for (size_t i = 0; i < compiled->op_count; i++) {
+        const format_op_t *op = &compiled->ops[i];
+        if (op->kind != FORMAT_OP_CONVERSION) {
+            continue;
+        }
+
+        const format_info_t *info = &op->info;
+        format_value_t value;
+        if (info->arg_class == FORMAT_ARG_UNKNOWN) {
+            return false;
+        }
+        if (info->flags & FORMAT_FLAG_WIDTH_ARG) {
+            value.i = va_arg(*args, int);
+            append_value(staging, &value);
+        }
+        int precision = info->precision;
+        if (info->flags & FORMAT_FLAG_PRECISION_ARG) {
+            value.i = va_arg(*args, int);
+            precision = value.i;
+            append_value(staging, &value);
+        }
+
+        fetch_format_value(info->arg_class, args, &value);
+        if (info->arg_class == FORMAT_ARG_STRING) {
+            // The caller may reuse the string as soon as we return, so its bytes are copied;
+            // a precision bounds the read, since such strings need not be terminated.
+            const char *str = value.s;
+            if (str == NULL) {
+                value.z = SIZE_MAX;
+                append_value(staging, &value);
+                continue;
+            }
+            const bool bounded = (info->flags & FORMAT_FLAG_PRECISION) && precision >= 0;
+            value.z = bounded ? strnlen(str, (size_t)precision) : strlen(str);
+            append_value(staging, &value);
+            append_to_buffer(staging, str, value.z);
+            append_to_buffer(staging, "", 1);
+            continue;
+        }
+        append_value(staging, &value);
+    }
+    return true;
+}
+
+// Claims a slot, copies the record in and publishes it. Producers only contend on the CAS of
+// `enqueue_position`; there are no locks, and the consumer is never waited on unless the ring is
+// full under ASYNC_FULL_BLOCK.
+static int enqueue_record(async_logger_t *logger, const compiled_format_t *compiled, const char *payload,
+                          size_t length) {
+    size_t position = atomic_load_explicit(&logger->enqueue_position, memory_order_relaxed);
+    bool waited = false;
+    async_slot_t *slot;
+    for (;;) {
+        slot = &logger->slots[position & logger->mask];
+        const size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        const intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0) {
+            // seq_cst orders the claim before wake_consumer's load of `parked` (a locked
+            // instruction either way on x86).
+            if (atomic_compare_exchange_weak_explicit(&logger->enqueue_position, &position, position + 1,
+                                                      memory_order_seq_cst, memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // The slot still holds a record from one lap ago: the ring is full.
+            if (logger->full_policy == ASYNC_FULL_DROP) {
+                atomic_fetch_add_explicit(&logger->dropped, 1, memory_order_relaxed);
+                return -1;
+            }
+            if (!waited) {
+                waited = true;
+                atomic_fetch_add_explicit(&logger->blocked, 1, memory_order_relaxed);
+            }
+            thrd_yield();
+            position = atomic_load_explicit(&logger->enqueue_position, memory_order_relaxed);
+        } else {
+            position = atomic_load_explicit(&logger->enqueue_position, memory_order_relaxed);
+        }
+    }
+
+    slot->compiled = compiled;
+    slot->length = length;
+    slot->heap_payload = NULL;
+    if (length <= ASYNC_RECORD_PAYLOAD_SIZE) {
+        memcpy(slot->payload, payload, length);
+    } else {
+        slot->heap_payload = malloc(length);
+        if (slot->heap_payload) {
+            memcpy(slot->heap_payload, payload, length);
+            atomic_fetch_add_explicit(&logger->oversized, 1, memory_order_relaxed);
+        } else {
+            // The slot is claimed and must still be published; it goes out empty.
+            slot->compiled = NULL;
+            slot->length = 0;
+            handle_error(MEMORY_ALLOCATION_ERROR, "Failed to allocate async log record");
+        }
+    }
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+    atomic_fetch_add_explicit(&logger->enqueued, 1, memory_order_relaxed);
+    wake_consumer(logger);
+    return 0;
+}
+
+// Captures the arguments in the calling thread's buffer, then copies the record into the ring.
+// The producer never parses the format or runs a handler unless it has to fall back to text.
+int async_vprintf(async_logger_t *logger, const char *format, va_list args) {
+    char stack_storage[STACK_BUFFER_SIZE];
+    buffer_t stack_buffer;
+    buffer_t *staging = acquire_thread_buffer();
+    if (!staging) {
+        init_buffer_with_storage(&stack_buffer, stack_storage, sizeof(stack_storage));
+        staging = &stack_buffer;
+    }
+
+    va_list ap;
+    va_copy(ap, args);
+    const compiled_format_t *compiled = get_compiled_format(format);
+    const bool captured = compiled && capture_arguments(compiled, &ap, staging);
+    va_end(ap);
+
+    if (!captured) {
+        staging->used = 0;
+        format_to_buffer(format, args, staging);
+        compiled = NULL;
+        atomic_fetch_add_explicit(&logger->preformatted, 1, memory_order_relaxed);
+    }
+    const int result = enqueue_record(logger, compiled, staging->data, staging->used);
+    PRINTF_STATS_CALL(PRINTF_ENTRY_ASYNC, 0);  // Its bytes are counted when the consumer writes them.
+
+    if (staging == &stack_buffer) {
+        release_buffer_storage(staging);
+    } else {
+        release_thread_buffer(staging);
+    }
+    return result;
+}
+
+int async_printf(async_logger_t *logger, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = async_vprintf(logger, format, args);
+    va_end(args);
+    return result;
+}
+
+static format_value_t read_value(const char **cursor) {
+    format_value_t value;
+    memcpy(&value, *cursor, sizeof(value));
+    *cursor += sizeof(value);
+    return value;
+}
+
+// Replays a record: literal text from the compiled format, conversions from the captured values
+// through the same handlers direct formatting uses.
+static void render_record(const async_slot_t *slot, buffer_t *buffer) {
+    const char *payload = slot->heap_payload ? slot->heap_payload : slot->payload;
+    if (!slot->compiled) {
+        append_to_buffer(buffer, payload, slot->length);
+        return;
+    }
+
+    const char *cursor = payload;
+    const compiled_format_t *compiled = slot->compiled;
+    for (size_t i = 0; i < compiled->op_count; i++) {
+        const format_op_t *op = &compiled->ops[i];
+        if (op->kind == FORMAT_OP_LITERAL) {
+            append_to_buffer(buffer, op->literal, op->literal_length);
+            continue;
+        }
+
+        format_info_t info = op->info;
+        if (info.flags & (FORMAT_FLAG_WIDTH_ARG | FORMAT_FLAG_PRECISION_ARG)) {
+            const int width = (info.flags & FORMAT_FLAG_WIDTH_ARG) ? read_value(&cursor).i : 0;
+            const int precision = (info.flags & FORMAT_FLAG_PRECISION_ARG) ? read_value(&cursor).i : 0;
+            resolve_star_arguments(&info, width, precision);
+        }
+
+        format_value_t value = read_value(&cursor);
+        if (info.arg_class == FORMAT_ARG_STRING) {
+            const size_t length = value.z;
+            value.s = length == SIZE_MAX ? NULL : cursor;
+            if (length != SIZE_MAX) {
+                cursor += length + 1;
+            }
+        }
+        invoke_format_handler_with_value(&info, &value, buffer);
+    }
+}
+
+// Sleeps until a producer claims the slot at `position` or the logger is destroyed.
+// `parked` is announced under the lock and the claim checked after it, both seq_cst, so a producer
+// that claimed before the flag was set is caught by the check, and one that sees the flag cannot
+// signal before the wait has started. A claimed slot not yet published is waited for by spinning.
+static void park_consumer(async_logger_t *logger, size_t position) {
+    mtx_lock(&logger->park_lock);
+    atomic_store_explicit(&logger->parked, true, memory_order_seq_cst);
+    if (atomic_load_explicit(&logger->enqueue_position, memory_order_seq_cst) == position &&
+        atomic_load_explicit(&logger->running, memory_order_acquire)) {
+        atomic_fetch_add_explicit(&logger->parked_count, 1, memory_order_relaxed);
+        cnd_wait(&logger->wake, &logger->park_lock);
+    }
+    atomic_store_explicit(&logger->parked, false, memory_order_relaxed);
+    mtx_unlock(&logger->park_lock);
+}
+
+// The single consumer: renders records in ring order into a batch and hands each batch to the
+// sink, so the sink sees a few large writes instead of one per message. When the ring is empty
+// it first publishes its progress, then yields for a while and finally parks until woken.
+static int run_consumer(void *arg) {
+    async_logger_t *logger = arg;
+    buffer_t *batch = init_buffer(ASYNC_BATCH_BYTES);
+    if (!batch) {
+        return 1;
+    }
+
+    size_t position = atomic_load_explicit(&logger->completed_position, memory_order_relaxed);
+    unsigned idle = 0;
+    for (;;) {
+        async_slot_t *slot = &logger->slots[position & logger->mask];
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) == position + 1) {
+            render_record(slot, batch);
+            free(slot->heap_payload);
+            slot->heap_payload = NULL;
+            atomic_store_explicit(&slot->sequence, position + logger->mask + 1, memory_order_release);
+            position++;
+            atomic_fetch_add_explicit(&logger->written, 1, memory_order_relaxed);
+            if (batch->used >= ASYNC_BATCH_BYTES) {
+                PRINTF_STATS_BYTES(batch->used);
+                sink_write(logger->sink, batch->data, batch->used);
+                batch->used = 0;
+                atomic_store_explicit(&logger->completed_position, position, memory_order_release);
+            }
+            idle = 0;
+            continue;
+        }
+
+        if (batch->used > 0) {
+            PRINTF_STATS_BYTES(batch->used);
+            sink_write(logger->sink, batch->data, batch->used);
+            batch->used = 0;
+        }
+        atomic_store_explicit(&logger->completed_position, position, memory_order_release);
+
+        if (!atomic_load_explicit(&logger->running, memory_order_acquire) &&
+            atomic_load_explicit(&logger->enqueue_position, memory_order_acquire) == position) {
+            break;
+        }
+        if (idle < ASYNC_IDLE_SPINS) {
+            idle++;
+            thrd_yield();
+        } else {
+            park_consumer(logger, position);
+            idle = 0;
+        }
+    }
+
+    free_buffer(batch);
+    return 0;
+}
+
+// Rounds the capacity up to a power of two so positions map to slots with a mask.
+async_logger_t *create_async_logger(output_sink_t *sink, const async_logger_config_t *config) {
+    size_t capacity = (config && config->capacity) ? config->capacity : ASYNC_LOGGER_DEFAULT_CAPACITY;
+    size_t slots = 2;
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+
+    async_logger_t *logger = aligned_alloc(_Alignof(async_logger_t), sizeof(async_logger_t));
+    if (!logger) {
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to allocate async logger");
+        return NULL;
+    }
+    memset(logger, 0, sizeof(*logger));
+
+    logger->slots = calloc(slots, sizeof(async_slot_t));
+    if (!logger->slots) {
+        free(logger);
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to allocate async logger ring");
+        return NULL;
+    }
+    for (size_t i = 0; i < slots; i++) {
+        atomic_init(&logger->slots[i].sequence, i);
+    }
+
+    logger->mask = slots - 1;
+    logger->sink = sink;
+    logger->full_policy = config ? config->full_policy : ASYNC_FULL_DROP;
+    atomic_init(&logger->running, true);
+    atomic_init(&logger->parked, false);
+
+    if (mtx_init(&logger->park_lock, mtx_plain) != thrd_success) {
+        free(logger->slots);
+        free(logger);
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to create async logger lock");
+        return NULL;
+    }
+    if (cnd_init(&logger->wake) != thrd_success) {
+        mtx_destroy(&logger->park_lock);
+        free(logger->slots);
+        free(logger);
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to create async logger condition");
+        return NULL;
+    }
+    if (thrd_create(&logger->consumer, run_consumer, logger) != thrd_success) {
+        cnd_destroy(&logger->wake);
+        mtx_destroy(&logger->park_lock);
+        free(logger->slots);
+        free(logger);
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to start async logger thread");
+        return NULL;
+    }
+    return logger;
+}
+
+void async_logger_flush(async_logger_t *logger) {
+    const size_t target = atomic_load_explicit(&logger->enqueue_position, memory_order_acquire);
+    while (atomic_load_explicit(&logger->completed_position, memory_order_acquire) < target) {
+        thrd_yield();
+    }
+    sink_flush(logger->sink);
+}
+
+void async_logger_get_stats(async_logger_t *logger, async_logger_stats_t *stats) {
+    stats->enqueued = atomic_load_explicit(&logger->enqueued, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&logger->dropped, memory_order_relaxed);
+    stats->blocked = atomic_load_explicit(&logger->blocked, memory_order_relaxed);
+    stats->oversized = atomic_load_explicit(&logger->oversized, memory_order_relaxed);
+    stats->preformatted = atomic_load_explicit(&logger->preformatted, memory_order_relaxed);
+    stats->written = atomic_load_explicit(&logger->written, memory_order_relaxed);
+    stats->parked = atomic_load_explicit(&logger->parked_count, memory_order_relaxed);
+}
+
+// The consumer exits only once it has caught up with every claimed slot, so nothing queued is lost.
+void destroy_async_logger(async_logger_t *logger) {
+    if (!logger) {
+        return;
+    }
+    atomic_store_explicit(&logger->running, false, memory_order_release);
+    mtx_lock(&logger->park_lock);
+    cnd_signal(&logger->wake);
+    mtx_unlock(&logger->park_lock);
+    thrd_join(logger->consumer, NULL);
+    sink_flush(logger->sink);
+    cnd_destroy(&logger->wake);
+    mtx_destroy(&logger->park_lock);
+    free(logger->slots);
+    free(logger);
+}
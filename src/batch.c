@@ -0,0 +1,308 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <threads.h>
+#include "../include/batch.h"
+#include "../include/buffer.h"
+#include "../include/compiled_format.h"
+#include "../include/printf_stats.h"
+#include "../include/error_handling.h"
+
+// Initial size of each block's buffer; it grows to fit the largest block and is then reused.
+#define BATCH_BUFFER_INITIAL_SIZE (64 * 1024)
+
+// The argument arrays of one conversion.
+typedef struct {
+    const int *widths;      // '*' width column, or NULL.
+    const int *precisions;  // '.*' precision column, or NULL.
+    const void *values;     // Column of the conversion's argument class.
+} batch_column_t;
+
+// Everything needed to render any row: the compiled format and one column set per conversion op.
+typedef struct {
+    const compiled_format_t *compiled;
+    const batch_column_t *columns;
+    size_t rows;
+} batch_t;
+
+// One block's output, passed from the worker that rendered it to the writer.
+typedef struct {
+    buffer_t *buffer;
+    size_t block;  // Block held in `buffer`, meaningful while `ready`.
+    bool ready;
+} batch_slot_t;
+
+// Shared state of a parallel batch. Workers claim blocks in order; block b is rendered into slot
+// b % slot_count once the writer is done with the block that used it before, so at most
+// slot_count blocks of output exist at any time.
+typedef struct {
+    const batch_t *batch;
+    size_t block_count;
+    batch_slot_t *slots;
+    size_t slot_count;
+    size_t next_block;  // Next block a worker claims.
+    size_t next_write;  // Next block the writer sends to the sink.
+    bool failed;        // The sink failed; workers stop claiming blocks.
+    mtx_t lock;
+    cnd_t changed;
+} batch_pool_t;
+
+// Reads element `row` of a column, at the type of its argument class.
+static void fetch_column_value(format_arg_class_t arg_class, const void *column, size_t row, format_value_t *value) {
+    switch (arg_class) {
+        case FORMAT_ARG_INT: value->i = ((const int *)column)[row]; break;
+        case FORMAT_ARG_UNSIGNED: value->u = ((const unsigned *)column)[row]; break;
+        case FORMAT_ARG_LONG: value->l = ((const long *)column)[row]; break;
+        case FORMAT_ARG_UNSIGNED_LONG: value->ul = ((const unsigned long *)column)[row]; break;
+        case FORMAT_ARG_LONG_LONG: value->ll = ((const long long *)column)[row]; break;
+        case FORMAT_ARG_UNSIGNED_LONG_LONG: value->ull = ((const unsigned long long *)column)[row]; break;
+        case FORMAT_ARG_INTMAX: value->j = ((const intmax_t *)column)[row]; break;
+        case FORMAT_ARG_UINTMAX: value->uj = ((const uintmax_t *)column)[row]; break;
+        case FORMAT_ARG_SIZE: value->z = ((const size_t *)column)[row]; break;
+        case FORMAT_ARG_PTRDIFF: value->t = ((const ptrdiff_t *)column)[row]; break;
+        case FORMAT_ARG_DOUBLE: value->d = ((const double *)column)[row]; break;
+        case FORMAT_ARG_POINTER: value->p = ((void *const *)column)[row]; break;
+        case FORMAT_ARG_STRING: value->s = ((const char *const *)column)[row]; break;
+        default: break;
+    }
+}
+
+// Renders rows [first, last) by replaying the compiled ops with values taken from the columns.
+static void render_rows(const batch_t *batch, size_t first, size_t last, buffer_t *buffer) {
+    const compiled_format_t *compiled = batch->compiled;
+    for (size_t row = first; row < last; row++) {
+        const batch_column_t *column = batch->columns;
+        for (size_t i = 0; i < compiled->op_count; i++) {
+            const format_op_t *op = &compiled->ops[i];
+            if (op->kind == FORMAT_OP_LITERAL) {
+                append_to_buffer(buffer, op->literal, op->literal_length);
+                continue;
+            }
+
+            const format_info_t *info = &op->info;
+            format_info_t resolved;
+            if (column->widths || column->precisions) {
+                resolved = op->info;
+                resolve_star_arguments(&resolved, column->widths ? column->widths[row] : 0,
+                                       column->precisions ? column->precisions[row] : 0);
+                info = &resolved;
+            }
+            format_value_t value;
+            fetch_column_value(info->arg_class, column->values, row, &value);
+            invoke_format_handler_with_value(info, &value, buffer);
+            column++;
+        }
+    }
+}
+
+static void render_block(const batch_t *batch, size_t block, buffer_t *buffer) {
+    const size_t first = block * BATCH_BLOCK_ROWS;
+    const size_t last = batch->rows - first < BATCH_BLOCK_ROWS ? batch->rows : first + BATCH_BLOCK_ROWS;
+    buffer->used = 0;
+    render_rows(batch, first, last, buffer);
+}
+
+// Takes one column set per conversion from `args`. Returns false if a conversion has no
+// argument class, since its column type would be unknown, or if the format is positional.
+static bool collect_columns(const compiled_format_t *compiled, va_list *args, batch_column_t *columns) {
+    if (compiled->position_count > 0) {
+        return false;
+    }
+    for (size_t i = 0; i < compiled->op_count; i++) {
+        const format_op_t *op = &compiled->ops[i];
+        if (op->kind != FORMAT_OP_CONVERSION) {
+            continue;
+        }
+        if (op->info.arg_class == FORMAT_ARG_UNKNOWN) {
+            return false;
+        }
+        columns->widths = (op->info.flags & FORMAT_FLAG_WIDTH_ARG) ? va_arg(*args, const int *) : NULL;
+        columns->precisions = (op->info.flags & FORMAT_FLAG_PRECISION_ARG) ? va_arg(*args, const int *) : NULL;
+        columns->values = va_arg(*args, const void *);
+        columns++;
+    }
+    return true;
+}
+
+// Formats every block on the caller's thread, reusing one buffer.
+static long long run_batch(const batch_t *batch, size_t block_count, output_sink_t *sink) {
+    buffer_t *buffer = init_buffer(BATCH_BUFFER_INITIAL_SIZE);
+    if (!buffer) {
+        return -1;
+    }
+    long long total = 0;
+    for (size_t block = 0; block < block_count; block++) {
+        render_block(batch, block, buffer);
+        if (sink_write(sink, buffer->data, buffer->used) != 0) {
+            total = -1;
+            break;
+        }
+        total += (long long)buffer->used;
+    }
+    free_buffer(buffer);
+    return total;
+}
+
+static int run_batch_worker(void *arg) {
+    batch_pool_t *pool = arg;
+    mtx_lock(&pool->lock);
+    while (!pool->failed && pool->next_block < pool->block_count) {
+        const size_t block = pool->next_block++;
+        batch_slot_t *slot = &pool->slots[block % pool->slot_count];
+        while (!pool->failed && block >= pool->next_write + pool->slot_count) {
+            cnd_wait(&pool->changed, &pool->lock);
+        }
+        if (pool->failed) {
+            break;
+        }
+        mtx_unlock(&pool->lock);
+
+        render_block(pool->batch, block, slot->buffer);
+
+        mtx_lock(&pool->lock);
+        slot->block = block;
+        slot->ready = true;
+        cnd_broadcast(&pool->changed);
+    }
+    mtx_unlock(&pool->lock);
+    return 0;
+}
+
+// Writes blocks to the sink in order as workers finish them. Runs on the caller's thread.
+static long long write_batch_blocks(batch_pool_t *pool, output_sink_t *sink) {
+    long long total = 0;
+    mtx_lock(&pool->lock);
+    while (pool->next_write < pool->block_count) {
+        batch_slot_t *slot = &pool->slots[pool->next_write % pool->slot_count];
+        while (!(slot->ready && slot->block == pool->next_write)) {
+            cnd_wait(&pool->changed, &pool->lock);
+        }
+        mtx_unlock(&pool->lock);
+
+        const bool written = sink_write(sink, slot->buffer->data, slot->buffer->used) == 0;
+        total += (long long)slot->buffer->used;
+
+        mtx_lock(&pool->lock);
+        slot->ready = false;
+        if (!written) {
+            pool->failed = true;
+            total = -1;
+        }
+        pool->next_write++;
+        cnd_broadcast(&pool->changed);
+        if (!written) {
+            break;
+        }
+    }
+    mtx_unlock(&pool->lock);
+    return total;
+}
+
+// Starts up to `threads` workers over a ring of two slots per worker and writes their blocks in
+// order. Falls back to the caller's thread if no worker can be started.
+static long long run_parallel_batch(const batch_t *batch, size_t block_count, unsigned threads, output_sink_t *sink) {
+    batch_pool_t pool = {0};
+    pool.batch = batch;
+    pool.block_count = block_count;
+    pool.slot_count = 2 * (size_t)threads;
+    pool.slots = calloc(pool.slot_count, sizeof(batch_slot_t));
+    thrd_t *workers = malloc(threads * sizeof(thrd_t));
+    bool ready = pool.slots && workers && mtx_init(&pool.lock, mtx_plain) == thrd_success;
+    if (ready && cnd_init(&pool.changed) != thrd_success) {
+        mtx_destroy(&pool.lock);
+        ready = false;
+    }
+    for (size_t i = 0; ready && i < pool.slot_count; i++) {
+        pool.slots[i].buffer = init_buffer(BATCH_BUFFER_INITIAL_SIZE);
+        ready = pool.slots[i].buffer != NULL;
+    }
+
+    unsigned started = 0;
+    while (ready && started < threads && thrd_create(&workers[started], run_batch_worker, &pool) == thrd_success) {
+        started++;
+    }
+
+    long long total;
+    if (started > 0) {
+        total = write_batch_blocks(&pool, sink);
+        for (unsigned i = 0; i < started; i++) {
+            thrd_join(workers[i], NULL);
+        }
+    } else {
+        total = run_batch(batch, block_count, sink);
+    }
+
+    if (pool.slots) {
+        for (size_t i = 0; i < pool.slot_count; i++) {
+            if (pool.slots[i].buffer) {
+                free_buffer(pool.slots[i].buffer);
+            }
+        }
+    }
+    if (ready) {
+        cnd_destroy(&pool.changed);
+        mtx_destroy(&pool.lock);
+    }
+    free(pool.slots);
+    free(workers);
+    return total;
+}
+
+// Compiles the format (through the cache when it can), gathers the columns and picks the
+// single- or multi-threaded path. Small batches stay on the caller's thread.
+long long my_vprintf_batch(output_sink_t *sink, unsigned threads, const char *format, size_t rows, va_list columns) {
+    const compiled_format_t *cached = get_compiled_format(format);
+    compiled_format_t *owned = cached ? NULL : compile_format(format);
+    const compiled_format_t *compiled = cached ? cached : owned;
+    if (!compiled) {
+        return -1;
+    }
+
+    batch_column_t *column_sets = malloc((compiled->op_count + 1) * sizeof(batch_column_t));
+    va_list args;
+    va_copy(args, columns);
+    const bool collected = column_sets && collect_columns(compiled, &args, column_sets);
+    va_end(args);
+
+    long long total = -1;
+    if (!column_sets) {
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to allocate batch columns");
+    } else if (!collected) {
+        errno = EINVAL;
+    } else {
+        const batch_t batch = {compiled, column_sets, rows};
+        const size_t block_count = (rows + BATCH_BLOCK_ROWS - 1) / BATCH_BLOCK_ROWS;
+        if (threads > BATCH_MAX_THREADS) {
+            threads = BATCH_MAX_THREADS;
+        }
+        if (threads > block_count) {
+            threads = (unsigned)block_count;
+        }
+        if (compiled->invalid_count > 0) {
+            PRINTF_STATS_INVALID(compiled->invalid_count * rows);
+        }
+        total = threads > 1 ? run_parallel_batch(&batch, block_count, threads, sink)
+                            : run_batch(&batch, block_count, sink);
+        PRINTF_STATS_CALL(PRINTF_ENTRY_BATCH, total > 0 ? (size_t)total : 0);
+    }
+
+    free(column_sets);
+    free_compiled_format(owned);
+    return total;
+}
+
+long long my_printf_batch(output_sink_t *sink, const char *format, size_t rows, ...) {
+    va_list columns;
+    va_start(columns, rows);
+    const long long result = my_vprintf_batch(sink, 1, format, rows, columns);
+    va_end(columns);
+    return result;
+}
+
+long long my_printf_batch_parallel(output_sink_t *sink, unsigned threads, const char *format, size_t rows, ...) {
+    va_list columns;
+    va_start(columns, rows);
+    const long long result = my_vprintf_batch(sink, threads, format, rows, columns);
+    va_end(columns);
+    return result;
+}
@@ -0,0 +1,543 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include "../include/binary_log.h"
+#include "../include/buffer.h"
+#include "../include/compiled_format.h"
+#include "../include/format_parser.h"
+#include "../include/hashmap.h"
+#include "../include/vfprintf.h"
+#include "../include/error_handling.h"
+
+// Formats a stream's format-to-id map holds before it first grows.
+#define BINARY_LOG_FORMAT_BUCKETS 256
+// A varint never needs more bytes than this for 64 bits.
+#define VARINT_MAX_BYTES 10
+// Decoded text gathered before each write to the output stream.
+#define BINARY_LOG_DECODE_CHUNK (64 * 1024)
+
+struct binary_log {
+    FILE *stream;
+    mtx_t lock;            // Keeps each format's DEFINE ahead of its first MESSAGE, and records whole.
+    hashmap_t *ids;        // Format text -> id, stored as (void *)(uintptr_t)id.
+    uintptr_t next_id;
+};
+
+// Streams in binary mode. `active_binary_logs` lets text-mode calls skip the scan with one load.
+static _Atomic(binary_log_t *) binary_logs[BINARY_LOG_MAX_STREAMS];
+static atomic_size_t active_binary_logs;
+
+static void put_varint(buffer_t *buffer, uint64_t value) {
+    char bytes[VARINT_MAX_BYTES];
+    size_t count = 0;
+    while (value >= 0x80) {
+        bytes[count++] = (char)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    bytes[count++] = (char)value;
+    append_to_buffer(buffer, bytes, count);
+}
+
+// Zigzag maps small magnitudes of either sign to small varints (0, -1, 1, -2 -> 0, 1, 2, 3).
+static void put_signed_varint(buffer_t *buffer, int64_t value) {
+    put_varint(buffer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void put_double(buffer_t *buffer, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    char bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (char)(bits >> (8 * i));
+    }
+    append_to_buffer(buffer, bytes, sizeof(bytes));
+}
+
+// Encodes one value by class. A string's precision bounds the read, since such strings need not
+// be terminated.
+static void put_value(buffer_t *buffer, const format_info_t *info, int precision, const format_value_t *value) {
+    switch (info->arg_class) {
+        case FORMAT_ARG_INT: put_signed_varint(buffer, value->i); break;
+        case FORMAT_ARG_LONG: put_signed_varint(buffer, value->l); break;
+        case FORMAT_ARG_LONG_LONG: put_signed_varint(buffer, value->ll); break;
+        case FORMAT_ARG_INTMAX: put_signed_varint(buffer, value->j); break;
+        case FORMAT_ARG_PTRDIFF: put_signed_varint(buffer, value->t); break;
+        case FORMAT_ARG_UNSIGNED: put_varint(buffer, value->u); break;
+        case FORMAT_ARG_UNSIGNED_LONG: put_varint(buffer, value->ul); break;
+        case FORMAT_ARG_UNSIGNED_LONG_LONG: put_varint(buffer, value->ull); break;
+        case FORMAT_ARG_UINTMAX: put_varint(buffer, value->uj); break;
+        case FORMAT_ARG_SIZE: put_varint(buffer, value->z); break;
+        case FORMAT_ARG_POINTER: put_varint(buffer, (uintptr_t)value->p); break;
+        case FORMAT_ARG_DOUBLE: put_double(buffer, value->d); break;
+        case FORMAT_ARG_STRING: {
+            if (value->s == NULL) {
+                put_varint(buffer, 0);
+                break;
+            }
+            const bool bounded = (info->flags & FORMAT_FLAG_PRECISION) && precision >= 0;
+            const size_t length = bounded ? strnlen(value->s, (size_t)precision) : strlen(value->s);
+            put_varint(buffer, (uint64_t)length + 1);
+            append_to_buffer(buffer, value->s, length);
+            break;
+        }
+        default: break;
+    }
+}
+
+// Encodes the arguments of a MESSAGE. Returns false if a conversion's handler has no argument
+// class or the format is positional, in which case the message must be sent as text.
+static bool encode_arguments(const compiled_format_t *compiled, va_list *args, buffer_t *buffer) {
+    if (compiled->position_count > 0) {
+        return false;
+    }
+    for (size_t i = 0; i < compiled->op_count; i++) {
+        const format_op_t *op = &compiled->ops[i];
+        if (op->kind != FORMAT_OP_CONVERSION) {
+            continue;
+        }
+
+        const format_info_t *info = &op->info;
+        if (info->arg_class == FORMAT_ARG_UNKNOWN) {
+            return false;
+        }
+        if (info->flags & FORMAT_FLAG_WIDTH_ARG) {
+            put_signed_varint(buffer, va_arg(*args, int));
+        }
+        int precision = info->precision;
+        if (info->flags & FORMAT_FLAG_PRECISION_ARG) {
+            precision = va_arg(*args, int);
+            put_signed_varint(buffer, precision);
+        }
+
+        format_value_t value;
+        fetch_format_value(info->arg_class, args, &value);
+        put_value(buffer, info, precision, &value);
+    }
+    return true;
+}
+
+// Returns the format's id, encoding its DEFINE record into `record` if the stream has not seen it.
+// The decoder numbers DEFINEs in stream order, so the caller takes the id (registering it and
+// advancing next_id) only once that record is written. Called with the lock held.
+static uintptr_t define_format(binary_log_t *log, const compiled_format_t *compiled, buffer_t *record) {
+    const uintptr_t known = (uintptr_t)get_hashmap(log->ids, compiled->text);
+    if (known) {
+        return known;
+    }
+
+    const uintptr_t id = log->next_id;
+    put_varint(record, BINARY_RECORD_DEFINE);
+    put_varint(record, id);
+    put_varint(record, compiled->length);
+    append_to_buffer(record, compiled->text, compiled->length);
+
+    size_t conversions = 0;
+    for (size_t i = 0; i < compiled->op_count; i++) {
+        conversions += compiled->ops[i].kind == FORMAT_OP_CONVERSION;
+    }
+    put_varint(record, conversions);
+    for (size_t i = 0; i < compiled->op_count; i++) {
+        if (compiled->ops[i].kind == FORMAT_OP_CONVERSION) {
+            put_varint(record, compiled->ops[i].info.arg_class);
+        }
+    }
+    return id;
+}
+
+int enable_binary_log(FILE *stream) {
+    if (find_binary_log(stream)) {
+        return -1;
+    }
+
+    binary_log_t *log = calloc(1, sizeof(binary_log_t));
+    if (!log) {
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to allocate binary log");
+        return -1;
+    }
+    log->stream = stream;
+    log->next_id = 1;
+    log->ids = create_hashmap(BINARY_LOG_FORMAT_BUCKETS);
+    if (!log->ids || mtx_init(&log->lock, mtx_plain) != thrd_success) {
+        free_hashmap(log->ids);
+        free(log);
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to create binary log");
+        return -1;
+    }
+
+    // Holding the lock while publishing keeps other threads' first records behind the header.
+    mtx_lock(&log->lock);
+    for (size_t i = 0; i < BINARY_LOG_MAX_STREAMS; i++) {
+        binary_log_t *expected = NULL;
+        if (atomic_compare_exchange_strong_explicit(&binary_logs[i], &expected, log, memory_order_acq_rel,
+                                                    memory_order_relaxed)) {
+            atomic_fetch_add_explicit(&active_binary_logs, 1, memory_order_release);
+            fwrite(BINARY_LOG_MAGIC, 1, BINARY_LOG_MAGIC_LENGTH, stream);
+            mtx_unlock(&log->lock);
+            return 0;
+        }
+    }
+    mtx_unlock(&log->lock);
+
+    mtx_destroy(&log->lock);
+    free_hashmap(log->ids);
+    free(log);
+    return -1;
+}
+
+void disable_binary_log(FILE *stream) {
+    for (size_t i = 0; i < BINARY_LOG_MAX_STREAMS; i++) {
+        binary_log_t *log = atomic_load_explicit(&binary_logs[i], memory_order_acquire);
+        if (log && log->stream == stream) {
+            atomic_store_explicit(&binary_logs[i], NULL, memory_order_release);
+            atomic_fetch_sub_explicit(&active_binary_logs, 1, memory_order_release);
+            mtx_destroy(&log->lock);
+            free_hashmap(log->ids);
+            free(log);
+            return;
+        }
+    }
+}
+
+binary_log_t *find_binary_log(FILE *stream) {
+    if (atomic_load_explicit(&active_binary_logs, memory_order_acquire) == 0) {
+        return NULL;
+    }
+    for (size_t i = 0; i < BINARY_LOG_MAX_STREAMS; i++) {
+        binary_log_t *log = atomic_load_explicit(&binary_logs[i], memory_order_acquire);
+        if (log && log->stream == stream) {
+            return log;
+        }
+    }
+    return NULL;
+}
+
+// Copies raw argument values into the record instead of converting them: the caller pays for a
+// few varint stores, and the digits are produced only when the log is decoded. Formats the
+// compiled format cache cannot hold, or whose handlers have no argument class, go out as TEXT.
+int write_binary_record(binary_log_t *log, const char *format, va_list args) {
+    char stack_storage[STACK_BUFFER_SIZE];
+    buffer_t stack_buffer;
+    buffer_t *record = acquire_thread_buffer();
+    if (!record) {
+        init_buffer_with_storage(&stack_buffer, stack_storage, sizeof(stack_storage));
+        record = &stack_buffer;
+    }
+
+    // The header goes in front of the arguments once their length is known.
+    char header[3 * VARINT_MAX_BYTES];
+    buffer_t header_buffer;
+    init_fixed_buffer(&header_buffer, header, sizeof(header));
+
+    va_list ap;
+    va_copy(ap, args);
+    const compiled_format_t *compiled = get_compiled_format(format);
+    const bool encoded = compiled && encode_arguments(compiled, &ap, record);
+    va_end(ap);
+
+    mtx_lock(&log->lock);
+    errno = 0;
+    size_t total = 0;
+    bool written = true;
+    if (encoded) {
+        buffer_t define;
+        char define_storage[STACK_BUFFER_SIZE];
+        init_buffer_with_storage(&define, define_storage, sizeof(define_storage));
+        const uintptr_t id = define_format(log, compiled, &define);
+        put_varint(&header_buffer, BINARY_RECORD_MESSAGE);
+        put_varint(&header_buffer, id);
+        if (define.used > 0) {
+            // A DEFINE that did not reach the stream is sent again with the format's next message.
+            written = fwrite(define.data, 1, define.used, log->stream) == define.used;
+            if (written) {
+                insert_hashmap(log->ids, compiled->text, (void *)id);
+                log->next_id++;
+            }
+        }
+        total = define.used;
+        release_buffer_storage(&define);
+    } else {
+        record->used = 0;
+        format_to_buffer(format, args, record);
+        put_varint(&header_buffer, BINARY_RECORD_TEXT);
+        put_varint(&header_buffer, record->used);
+    }
+    written = written && fwrite(header, 1, header_buffer.used, log->stream) == header_buffer.used;
+    written = written && fwrite(record->data, 1, record->used, log->stream) == record->used;
+    total += header_buffer.used + record->used;
+    record->used = 0;
+    if (!written && errno == 0) {
+        errno = EIO;
+    }
+    mtx_unlock(&log->lock);
+
+    if (record == &stack_buffer) {
+        release_buffer_storage(record);
+    } else {
+        release_thread_buffer(record);
+    }
+    if (!written) {
+        return -1;
+    }
+    return total > INT_MAX ? INT_MAX : (int)total;
+}
+
+// Reads a varint, rejecting end of input and encodings longer than 64 bits.
+static bool read_varint(FILE *in, uint64_t *value) {
+    *value = 0;
+    for (unsigned shift = 0; shift < 7 * VARINT_MAX_BYTES; shift += 7) {
+        const int c = getc(in);
+        if (c == EOF) {
+            return false;
+        }
+        *value |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool read_signed_varint(FILE *in, int64_t *value) {
+    uint64_t encoded;
+    if (!read_varint(in, &encoded)) {
+        return false;
+    }
+    *value = (int64_t)(encoded >> 1) ^ -(int64_t)(encoded & 1);
+    return true;
+}
+
+// Reads `length` bytes into `scratch` and terminates them, as handlers expect C strings.
+static char *read_bytes(FILE *in, buffer_t *scratch, uint64_t length) {
+    if (length > INT_MAX) {
+        return NULL;
+    }
+    scratch->used = 0;
+    char *bytes = buffer_reserve(scratch, (size_t)length + 1);
+    if (!bytes || fread(bytes, 1, (size_t)length, in) != length) {
+        return NULL;
+    }
+    bytes[length] = '\0';
+    return bytes;
+}
+
+// Decodes one value of the class the handler was registered with, narrowing it back to its type.
+static bool read_value(FILE *in, const format_info_t *info, buffer_t *scratch, format_value_t *value) {
+    int64_t s;
+    uint64_t u;
+    switch (info->arg_class) {
+        case FORMAT_ARG_INT:
+        case FORMAT_ARG_LONG:
+        case FORMAT_ARG_LONG_LONG:
+        case FORMAT_ARG_INTMAX:
+        case FORMAT_ARG_PTRDIFF:
+            if (!read_signed_varint(in, &s)) {
+                return false;
+            }
+            switch (info->arg_class) {
+                case FORMAT_ARG_INT: value->i = (int)s; break;
+                case FORMAT_ARG_LONG: value->l = (long)s; break;
+                case FORMAT_ARG_LONG_LONG: value->ll = s; break;
+                case FORMAT_ARG_INTMAX: value->j = s; break;
+                default: value->t = (ptrdiff_t)s; break;
+            }
+            return true;
+        case FORMAT_ARG_UNSIGNED:
+        case FORMAT_ARG_UNSIGNED_LONG:
+        case FORMAT_ARG_UNSIGNED_LONG_LONG:
+        case FORMAT_ARG_UINTMAX:
+        case FORMAT_ARG_SIZE:
+        case FORMAT_ARG_POINTER:
+            if (!read_varint(in, &u)) {
+                return false;
+            }
+            switch (info->arg_class) {
+                case FORMAT_ARG_UNSIGNED: value->u = (unsigned)u; break;
+                case FORMAT_ARG_UNSIGNED_LONG: value->ul = (unsigned long)u; break;
+                case FORMAT_ARG_UNSIGNED_LONG_LONG: value->ull = u; break;
+                case FORMAT_ARG_UINTMAX: value->uj = u; break;
+                case FORMAT_ARG_SIZE: value->z = (size_t)u; break;
+                default: value->p = (void *)(uintptr_t)u; break;
+            }
+            return true;
+        case FORMAT_ARG_DOUBLE: {
+            unsigned char bytes[8];
+            if (fread(bytes, 1, sizeof(bytes), in) != sizeof(bytes)) {
+                return false;
+            }
+            uint64_t bits = 0;
+            for (int i = 0; i < 8; i++) {
+                bits |= (uint64_t)bytes[i] << (8 * i);
+            }
+            memcpy(&value->d, &bits, sizeof(bits));
+            return true;
+        }
+        case FORMAT_ARG_STRING:
+            if (!read_varint(in, &u)) {
+                return false;
+            }
+            if (u == 0) {
+                value->s = NULL;
+                return true;
+            }
+            value->s = read_bytes(in, scratch, u - 1);
+            return value->s != NULL;
+        default:
+            return false;
+    }
+}
+
+// Replays a MESSAGE: literals from the decoder's own compiled format, conversions from the decoded
+// values through the same handlers my_vfprintf uses.
+static bool decode_message(FILE *in, const compiled_format_t *compiled, buffer_t *scratch, buffer_t *out) {
+    for (size_t i = 0; i < compiled->op_count; i++) {
+        const format_op_t *op = &compiled->ops[i];
+        if (op->kind == FORMAT_OP_LITERAL) {
+            append_to_buffer(out, op->literal, op->literal_length);
+            continue;
+        }
+
+        format_info_t info = op->info;
+        int64_t width = 0;
+        int64_t precision = 0;
+        if (((info.flags & FORMAT_FLAG_WIDTH_ARG) && !read_signed_varint(in, &width)) ||
+            ((info.flags & FORMAT_FLAG_PRECISION_ARG) && !read_signed_varint(in, &precision))) {
+            return false;
+        }
+        resolve_star_arguments(&info, (int)width, (int)precision);
+
+        format_value_t value;
+        if (!read_value(in, &info, scratch, &value)) {
+            return false;
+        }
+        invoke_format_handler_with_value(&info, &value, out);
+    }
+    return true;
+}
+
+// Compiles a DEFINE's format with this process's handlers and checks that they take the same
+// argument classes the writer's did; otherwise the values that follow could not be read back.
+static compiled_format_t *decode_define(FILE *in, buffer_t *scratch) {
+    uint64_t length;
+    uint64_t conversions;
+    const char *text;
+    if (!read_varint(in, &length) || !(text = read_bytes(in, scratch, length)) || strlen(text) != length) {
+        return NULL;
+    }
+    compiled_format_t *compiled = compile_format(text);
+    if (!compiled || !read_varint(in, &conversions)) {
+        free_compiled_format(compiled);
+        return NULL;
+    }
+
+    size_t op = 0;
+    for (uint64_t i = 0; i < conversions; i++) {
+        uint64_t arg_class;
+        while (op < compiled->op_count && compiled->ops[op].kind != FORMAT_OP_CONVERSION) {
+            op++;
+        }
+        if (!read_varint(in, &arg_class) || op == compiled->op_count ||
+            compiled->ops[op].info.arg_class != arg_class) {
+            free_compiled_format(compiled);
+            return NULL;
+        }
+        op++;
+    }
+    while (op < compiled->op_count && compiled->ops[op].kind != FORMAT_OP_CONVERSION) {
+        op++;
+    }
+    if (op != compiled->op_count) {
+        free_compiled_format(compiled);
+        return NULL;
+    }
+    return compiled;
+}
+
+// Formats the DEFINE records seen so far, indexed by id - 1.
+typedef struct {
+    compiled_format_t **items;
+    size_t count;
+} format_table_t;
+
+// Decodes records until the input ends. Returns 0 at a clean end, or -1 on the first bad record.
+static int decode_records(FILE *in, FILE *out, format_table_t *formats, buffer_t *text, buffer_t *scratch) {
+    for (;;) {
+        // End of input is only clean between records.
+        const int c = getc(in);
+        if (c == EOF) {
+            return 0;
+        }
+        ungetc(c, in);
+
+        uint64_t tag;
+        uint64_t value;
+        if (!read_varint(in, &tag) || !read_varint(in, &value)) {
+            return -1;
+        }
+        if (tag == BINARY_RECORD_DEFINE) {
+            if (value != formats->count + 1) {
+                return -1;
+            }
+            compiled_format_t **grown = realloc(formats->items, (formats->count + 1) * sizeof(*grown));
+            if (!grown) {
+                handle_error(MEMORY_ALLOCATION_ERROR, "Failed to grow binary log format table");
+                return -1;
+            }
+            formats->items = grown;
+            if (!(formats->items[formats->count] = decode_define(in, scratch))) {
+                return -1;
+            }
+            formats->count++;
+        } else if (tag == BINARY_RECORD_MESSAGE) {
+            // A message cut short leaves none of its text behind.
+            const size_t start = text->used;
+            if (value == 0 || value > formats->count ||
+                !decode_message(in, formats->items[value - 1], scratch, text)) {
+                text->used = start;
+                return -1;
+            }
+        } else if (tag == BINARY_RECORD_TEXT) {
+            const char *bytes = read_bytes(in, scratch, value);
+            if (!bytes) {
+                return -1;
+            }
+            append_to_buffer(text, bytes, (size_t)value);
+        } else {
+            return -1;
+        }
+
+        if (text->used >= BINARY_LOG_DECODE_CHUNK) {
+            flush_buffer(text, out);
+        }
+    }
+}
+
+// Text decoded before a malformed record is still written out, which helps locate the damage.
+int decode_binary_log(FILE *in, FILE *out) {
+    char magic[BINARY_LOG_MAGIC_LENGTH];
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+        memcmp(magic, BINARY_LOG_MAGIC, BINARY_LOG_MAGIC_LENGTH) != 0) {
+        return -1;
+    }
+
+    buffer_t *text = init_buffer(BINARY_LOG_DECODE_CHUNK);
+    buffer_t *scratch = init_buffer(STACK_BUFFER_SIZE);
+    format_table_t formats = {NULL, 0};
+    int result = -1;
+    if (text && scratch) {
+        result = decode_records(in, out, &formats, text, scratch);
+        flush_buffer(text, out);
+    }
+
+    for (size_t i = 0; i < formats.count; i++) {
+        free_compiled_format(formats.items[i]);
+    }
+    free(formats.items);
+    free_buffer(text);
+    free_buffer(scratch);
+    return result;
+}
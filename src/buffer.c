@@ -1,8 +1,29 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
+#include <unistd.h>
+#include <sys/uio.h>
 #include "../include/buffer.h"
+#include "../include/printf_stats.h"
 #include "../include/error_handling.h"
 
+// Capacity above which a thread's buffer is shrunk once the call that grew it completes.
+static atomic_size_t thread_buffer_high_water = THREAD_BUFFER_DEFAULT_HIGH_WATER;
+
+// Each thread formats into its own buffer, which starts on inline thread-local storage
+// so steady-state calls never touch the allocator.
+static _Thread_local buffer_t thread_buffer;
+static _Thread_local char thread_buffer_storage[THREAD_BUFFER_INLINE_SIZE];
+static _Thread_local bool thread_buffer_in_use = false;
+static _Thread_local void *thread_buffer_registered_data = NULL;
+
+// Key whose destructor frees heap storage a thread's buffer still holds when the thread exits.
+static tss_t thread_buffer_key;
+static once_flag thread_buffer_key_once = ONCE_FLAG_INIT;
+
 // Initializes a buffer with a specified initial size, handling memory allocation for buffered output.
 // Buffered output is essential for a custom printf to efficiently manage intermediate data
 // before writing it in bulk, which is faster than writing byte-by-byte to the output stream.
@@ -23,10 +44,83 @@ buffer_t *init_buffer(size_t initial_size) {
 
     buffer->size = initial_size;
     buffer->used = 0;
+    buffer->flags = 0;
+    buffer->overflow = 0;
+    buffer->segments = NULL;
+    buffer->stream = NULL;
 
     return buffer;
 }
 
+// Sets up a buffer over storage the caller already has (typically a stack array),
+// avoiding both allocations init_buffer makes for short-lived buffers.
+void init_buffer_with_storage(buffer_t *buffer, char *storage, size_t size) {
+    buffer->data = storage;
+    buffer->size = size;
+    buffer->used = 0;
+    buffer->flags = BUFFER_FLAG_BORROWED;
+    buffer->overflow = 0;
+    buffer->segments = NULL;
+    buffer->stream = NULL;
+}
+
+// Sets up a non-growing buffer over memory such as a caller's snprintf destination.
+// Output goes straight into that memory, and overflow is only counted, so the would-be
+// length of a truncated result is known without any allocation.
+void init_fixed_buffer(buffer_t *buffer, char *storage, size_t capacity) {
+    buffer->data = storage;
+    buffer->size = capacity;
+    buffer->used = 0;
+    buffer->flags = BUFFER_FLAG_BORROWED | BUFFER_FLAG_FIXED;
+    buffer->overflow = 0;
+    buffer->segments = NULL;
+    buffer->stream = NULL;
+}
+
+// Hands bytes to the stream's callback. After a failure everything is discarded, so the entry
+// point reports the error once when the message ends.
+static void stream_out(buffer_stream_t *stream, const char *data, size_t len) {
+    if (len == 0 || stream->error != 0) {
+        return;
+    }
+    if (stream->flush(stream->context, data, len) != 0) {
+        stream->error = errno != 0 ? errno : EIO;
+        return;
+    }
+    stream->flushed += len;
+}
+
+// Hands everything pending to the stream in output order, copied bytes interleaved with any
+// referenced segments, and empties the buffer.
+static void stream_pending(buffer_t *buffer) {
+    size_t offset = 0;
+    buffer_segments_t *segments = buffer->segments;
+    if (segments) {
+        for (size_t i = 0; i < segments->count; i++) {
+            const buffer_segment_t *segment = &segments->items[i];
+            stream_out(buffer->stream, buffer->data + offset, segment->offset - offset);
+            offset = segment->offset;
+            stream_out(buffer->stream, segment->data, segment->length);
+        }
+        segments->count = 0;
+        segments->length = 0;
+    }
+    stream_out(buffer->stream, buffer->data + offset, buffer->used - offset);
+    buffer->used = 0;
+}
+
+// Decides how a streaming buffer takes `len` more bytes. Returns true if they may go into `data`
+// (growing it up to the limit), flushing pending bytes first when the limit would be passed.
+// Returns false, with the buffer empty, when they could not fit even then.
+static bool stream_make_room(buffer_t *buffer, size_t len) {
+    const size_t limit = buffer->stream->limit > buffer->size ? buffer->stream->limit : buffer->size;
+    if (buffer->used + len <= limit) {
+        return true;
+    }
+    stream_pending(buffer);
+    return len <= limit;
+}
+
 // Appends data to the buffer, resizing as necessary to accommodate new data.
 // Automatic expansion ensures that the buffer can handle any amount of data appended
 // in a single operation, which is useful for format-heavy operations like printf that
@@ -35,7 +129,27 @@ void append_to_buffer(buffer_t *buffer, const char *str, size_t len) {
     // Ensure the buffer has enough space. Expanding in chunks reduces the number of reallocations
     // in scenarios with frequent appends, which is common in formatted output.
     if (buffer->used + len > buffer->size) {
-        expand_buffer(buffer, len);
+        if (buffer->flags & BUFFER_FLAG_FIXED) {
+            // Fixed buffers keep the prefix that fits and only count the rest,
+            // which gives snprintf-style truncation with the full length still known.
+            const size_t room = buffer->size - buffer->used;
+            if (room > 0) {
+                memcpy(buffer->data + buffer->used, str, room);
+                buffer->used += room;
+            }
+            buffer->overflow += len - room;
+            return;
+        }
+        if (buffer->stream && !stream_make_room(buffer, len)) {
+            stream_out(buffer->stream, str, len);  // Too long to hold: pass it on uncopied.
+            return;
+        }
+        if (buffer->used + len > buffer->size) {
+            expand_buffer(buffer, len);
+        }
+        if (buffer->used + len > buffer->size) {
+            return;  // Expansion failed and the error handler returned; drop the data rather than overrun.
+        }
     }
 
     // Copy the provided data to the buffer's current position, updating the usage counter.
@@ -45,13 +159,116 @@ void append_to_buffer(buffer_t *buffer, const char *str, size_t len) {
     buffer->used += len;
 }
 
+// Large spans such as long literal runs or %s arguments are left where they are and handed to
+// writev later, saving a copy; small spans and buffers without segments fall back to copying.
+void append_reference_to_buffer(buffer_t *buffer, const char *str, size_t len) {
+    buffer_segments_t *segments = buffer->segments;
+    if (!segments || len < BUFFER_SEGMENT_MIN_LENGTH || segments->count == BUFFER_MAX_SEGMENTS ||
+        (buffer->flags & BUFFER_FLAG_COPY_REFERENCES)) {
+        append_to_buffer(buffer, str, len);
+        return;
+    }
+
+    buffer_segment_t *segment = &segments->items[segments->count++];
+    segment->offset = buffer->used;
+    segment->data = str;
+    segment->length = len;
+    segments->length += len;
+}
+
+// Appends a run of one repeated byte, such as field-width padding, as one memset
+// rather than one append per byte. Fixed buffers truncate and count it like any append.
+void fill_buffer(buffer_t *buffer, char c, size_t count) {
+    if (buffer->used + count > buffer->size) {
+        if (buffer->flags & BUFFER_FLAG_FIXED) {
+            const size_t room = buffer->size - buffer->used;
+            if (room > 0) {
+                memset(buffer->data + buffer->used, c, room);
+                buffer->used += room;
+            }
+            buffer->overflow += count - room;
+            return;
+        }
+        if (buffer->stream && !stream_make_room(buffer, count)) {
+            // Padding wider than the limit is written one buffer's worth at a time.
+            while (count > 0) {
+                const size_t chunk = count < buffer->size ? count : buffer->size;
+                memset(buffer->data, c, chunk);
+                buffer->used = chunk;
+                count -= chunk;
+                if (count > 0) {
+                    stream_out(buffer->stream, buffer->data, chunk);
+                    buffer->used = 0;
+                }
+            }
+            return;
+        }
+        if (buffer->used + count > buffer->size) {
+            expand_buffer(buffer, count);
+        }
+        if (buffer->used + count > buffer->size) {
+            return;
+        }
+    }
+
+    memset(buffer->data + buffer->used, c, count);
+    buffer->used += count;
+}
+
+// Hands out space at the end of the buffer so producers (like the numeric handlers) can write
+// their output in place, skipping the temporary array, strlen and memcpy of append_to_buffer.
+char *buffer_reserve(buffer_t *buffer, size_t max_len) {
+    buffer->flags &= ~BUFFER_FLAG_SPILLED;
+
+    if (buffer->used + max_len > buffer->size) {
+        if (!(buffer->flags & BUFFER_FLAG_FIXED) && (!buffer->stream || stream_make_room(buffer, max_len)) &&
+            buffer->used + max_len > buffer->size) {
+            expand_buffer(buffer, max_len);
+        }
+        if (buffer->used + max_len > buffer->size) {
+            // No room in place: use the spill area, and let buffer_commit truncate and count it.
+            if (max_len > BUFFER_SPILL_SIZE) {
+                return NULL;
+            }
+            buffer->flags |= BUFFER_FLAG_SPILLED;
+            return buffer->spill;
+        }
+    }
+
+    return buffer->data + buffer->used;
+}
+
+// Publishes bytes written into the last reservation.
+void buffer_commit(buffer_t *buffer, size_t len) {
+    if (buffer->flags & BUFFER_FLAG_SPILLED) {
+        buffer->flags &= ~BUFFER_FLAG_SPILLED;
+        append_to_buffer(buffer, buffer->spill, len);
+        return;
+    }
+    buffer->used += len;
+}
+
 // Expands the buffer size to accommodate at least `extra_len` more bytes.
 // Typically, doubling the buffer size provides amortized efficiency by minimizing
 // the frequency of reallocations as data grows. This is a common pattern in dynamic data structures.
 void expand_buffer(buffer_t *buffer, size_t extra_len) {
     // Calculate the new buffer size, generally doubling to allow for exponential growth.
-    const size_t new_size = buffer->size * 2 + extra_len;
-    char *new_data = (char *)realloc(buffer->data, new_size);
+    // A streaming buffer stops at its limit, which stream_make_room has already checked is enough.
+    size_t new_size = buffer->size * 2 + extra_len;
+    if (buffer->stream && new_size > buffer->stream->limit && buffer->used + extra_len <= buffer->stream->limit) {
+        new_size = buffer->stream->limit;
+    }
+    char *new_data;
+    if (buffer->flags & BUFFER_FLAG_BORROWED) {
+        // Borrowed storage cannot be realloc'd; move the contents onto the heap instead.
+        new_data = (char *)malloc(new_size);
+        if (new_data) {
+            memcpy(new_data, buffer->data, buffer->used);
+            buffer->flags &= ~BUFFER_FLAG_BORROWED;
+        }
+    } else {
+        new_data = (char *)realloc(buffer->data, new_size);
+    }
     if (!new_data) {
         handle_error(MEMORY_ALLOCATION_ERROR, "Failed to expand buffer");
         return;  // Future operations may fail if buffer can't expand, but graceful handling helps avoid crashes.
@@ -59,6 +276,27 @@ void expand_buffer(buffer_t *buffer, size_t extra_len) {
 
     buffer->data = new_data;
     buffer->size = new_size;
+    PRINTF_STATS_EXPANSION();
+}
+
+void init_buffer_stream(buffer_stream_t *stream, buffer_flush_t flush, void *context, size_t limit) {
+    stream->flush = flush;
+    stream->context = context;
+    stream->limit = limit;
+    stream->flushed = 0;
+    stream->error = 0;
+}
+
+// The end of a streamed message: whatever is still pending goes out like the earlier pieces.
+int finish_buffer_stream(buffer_t *buffer) {
+    buffer_stream_t *stream = buffer->stream;
+    stream_pending(buffer);
+    buffer->stream = NULL;
+    if (stream->error != 0) {
+        errno = stream->error;
+        return -1;
+    }
+    return 0;
 }
 
 // Flushes the buffer content to the specified output stream (e.g., stdout).
@@ -72,12 +310,144 @@ void flush_buffer(buffer_t *buffer, FILE *stream) {
     buffer->used = 0;  // Clear the buffer for future data appends.
 }
 
+// Keeps calling writev until every byte is out: EINTR is retried, and after a partial write the
+// vector is advanced past what the kernel took so the remainder goes in the next call.
+static int write_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        const ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        size_t remaining = (size_t)written;
+        while (count > 0 && remaining >= iov->iov_len) {
+            remaining -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + remaining;
+            iov->iov_len -= remaining;
+        }
+    }
+    return 0;
+}
+
+int write_to_fd(int fd, const char *data, size_t length) {
+    struct iovec iov = {(void *)data, length};
+    return write_all(fd, &iov, 1);
+}
+
+// Hands the finished message straight to the kernel, bypassing stdio's stream lock and its
+// second copy. Copied bytes and referenced segments are interleaved into one vector, so even a
+// scattered message costs a single system call.
+int write_buffer_to_fd(buffer_t *buffer, int fd) {
+    struct iovec iov[2 * BUFFER_MAX_SEGMENTS + 1];
+    int count = 0;
+    size_t offset = 0;
+
+    const buffer_segments_t *segments = buffer->segments;
+    const size_t segment_count = segments ? segments->count : 0;
+    for (size_t i = 0; i < segment_count; i++) {
+        const buffer_segment_t *segment = &segments->items[i];
+        if (segment->offset > offset) {
+            iov[count].iov_base = buffer->data + offset;
+            iov[count++].iov_len = segment->offset - offset;
+            offset = segment->offset;
+        }
+        iov[count].iov_base = (void *)segment->data;
+        iov[count++].iov_len = segment->length;
+    }
+    if (buffer->used > offset) {
+        iov[count].iov_base = buffer->data + offset;
+        iov[count++].iov_len = buffer->used - offset;
+    }
+
+    const int result = write_all(fd, iov, count);
+
+    buffer->used = 0;
+    if (buffer->segments) {
+        buffer->segments->count = 0;
+        buffer->segments->length = 0;
+    }
+    return result;
+}
+
 // Frees the memory allocated for the buffer, including the internal data.
 // Proper cleanup is necessary to prevent memory leaks, especially in implementations
 // where dynamic memory allocation is frequent and handling errors consistently is key.
 void free_buffer(buffer_t *buffer) {
     if (buffer) {
-        free(buffer->data);  // Free the data storage allocated within the buffer.
-        free(buffer);        // Free the buffer structure itself.
+        release_buffer_storage(buffer);  // Free the data storage allocated within the buffer.
+        free(buffer);                    // Free the buffer structure itself.
     }
 }
+
+// Frees the buffer's data unless it still lives in caller-provided storage.
+void release_buffer_storage(buffer_t *buffer) {
+    if (!(buffer->flags & BUFFER_FLAG_BORROWED)) {
+        free(buffer->data);
+    }
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->used = 0;
+}
+
+// Creates the thread-exit key; run once per process.
+static void create_thread_buffer_key(void) {
+    if (tss_create(&thread_buffer_key, free) != thrd_success) {
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to create thread buffer key");
+    }
+}
+
+// Hands out the calling thread's buffer. Returning NULL while it is in use lets a
+// re-entrant call fall back to its own stack buffer instead of clobbering the outer message.
+buffer_t *acquire_thread_buffer(void) {
+    if (thread_buffer_in_use) {
+        return NULL;
+    }
+    if (thread_buffer.data == NULL) {
+        init_buffer_with_storage(&thread_buffer, thread_buffer_storage, sizeof(thread_buffer_storage));
+    }
+
+    thread_buffer_in_use = true;
+    thread_buffer.used = 0;
+    thread_buffer.overflow = 0;
+    thread_buffer.segments = NULL;
+    thread_buffer.stream = NULL;
+    return &thread_buffer;
+}
+
+// Keeps grown storage for the next call unless it passed the high-water mark, in which case
+// it is freed so one oversized message does not pin that memory for the thread's lifetime.
+void release_thread_buffer(buffer_t *buffer) {
+    if (!(buffer->flags & BUFFER_FLAG_BORROWED) &&
+        buffer->size > atomic_load_explicit(&thread_buffer_high_water, memory_order_relaxed)) {
+        free(buffer->data);
+        init_buffer_with_storage(buffer, thread_buffer_storage, sizeof(thread_buffer_storage));
+    }
+
+    // Register heap storage with the thread-exit key so it is freed if the thread exits holding it.
+    // The registration only changes when the buffer grows or shrinks, so steady state skips it.
+    void *heap_data = (buffer->flags & BUFFER_FLAG_BORROWED) ? NULL : buffer->data;
+    if (heap_data != thread_buffer_registered_data) {
+        call_once(&thread_buffer_key_once, create_thread_buffer_key);
+        tss_set(thread_buffer_key, heap_data);
+        thread_buffer_registered_data = heap_data;
+    }
+
+    buffer->used = 0;
+    thread_buffer_in_use = false;
+}
+
+// Updates the shrink threshold shared by every thread's buffer.
+void set_thread_buffer_high_water(size_t bytes) {
+    atomic_store_explicit(&thread_buffer_high_water, bytes, memory_order_relaxed);
+}
+
+size_t get_thread_buffer_high_water(void) {
+    return atomic_load_explicit(&thread_buffer_high_water, memory_order_relaxed);
+}
@@ -0,0 +1,321 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/compiled_format.h"
+#include "../include/printf_stats.h"
+#include "../include/error_handling.h"
+
+// Process-wide cache of compiled formats, keyed by the format pointer.
+// Slots are only ever filled or swapped with compare-and-swap, so lookups never take a lock.
+static _Atomic(compiled_format_t *) compiled_format_cache[COMPILED_FORMAT_CACHE_SIZE];
+
+// Entries replaced after a handler registration. Other threads may still be replaying them,
+// so they are kept alive until clear_compiled_format_cache runs.
+static _Atomic(compiled_format_t *) retired_compiled_formats = NULL;
+
+// Appends a literal span, merging it into the previous op when the two are contiguous
+// so escaped and invalid '%' sequences do not split a run of text.
+static void add_literal_op(compiled_format_t *compiled, const char *literal, size_t length) {
+    if (compiled->op_count > 0) {
+        format_op_t *last = &compiled->ops[compiled->op_count - 1];
+        if (last->kind == FORMAT_OP_LITERAL && last->literal + last->literal_length == literal) {
+            last->literal_length += length;
+            return;
+        }
+    }
+
+    format_op_t *op = &compiled->ops[compiled->op_count++];
+    op->kind = FORMAT_OP_LITERAL;
+    op->literal = literal;
+    op->literal_length = length;
+}
+
+// Whether `slot` can be read at `arg_class`: it exists and no other conversion reads it differently.
+static bool slot_accepts(const compiled_format_t *compiled, int slot, format_arg_class_t arg_class) {
+    if (slot < 1 || slot > FORMAT_MAX_POSITIONS) {
+        return false;
+    }
+    const format_arg_class_t current = (format_arg_class_t)compiled->slot_classes[slot - 1];
+    return current == FORMAT_ARG_UNKNOWN || current == arg_class;
+}
+
+static void claim_slot(compiled_format_t *compiled, int slot, format_arg_class_t arg_class) {
+    compiled->slot_classes[slot - 1] = (unsigned char)arg_class;
+    if ((size_t)slot > compiled->position_count) {
+        compiled->position_count = (size_t)slot;
+    }
+}
+
+// The pre-pass of a positional format: numbers every argument each conversion reads and records
+// the class of each slot, so rendering can fetch all of them in one va_arg sweep. A conversion
+// whose arguments cannot be gathered is turned back into its literal text, like an invalid one.
+static void assign_argument_slots(compiled_format_t *compiled) {
+    int next = 1;
+    for (size_t i = 0; i < compiled->op_count; i++) {
+        format_op_t *op = &compiled->ops[i];
+        if (op->kind != FORMAT_OP_CONVERSION) {
+            continue;
+        }
+
+        const format_info_t *info = &op->info;
+        int slot = next;
+        int width_slot = 0;
+        int precision_slot = 0;
+        if (info->flags & FORMAT_FLAG_WIDTH_ARG) {
+            width_slot = info->width_position ? info->width_position : slot;
+            slot = width_slot + 1;
+        }
+        if (info->flags & FORMAT_FLAG_PRECISION_ARG) {
+            precision_slot = info->precision_position ? info->precision_position : slot;
+            slot = precision_slot + 1;
+        }
+        if (info->position) {
+            slot = info->position;
+        }
+
+        const format_arg_class_t arg_class = info->arg_class;
+        const bool accepted = arg_class != FORMAT_ARG_UNKNOWN &&
+                              (!width_slot || slot_accepts(compiled, width_slot, FORMAT_ARG_INT)) &&
+                              (!precision_slot || slot_accepts(compiled, precision_slot, FORMAT_ARG_INT)) &&
+                              slot_accepts(compiled, slot, arg_class) &&
+                              (arg_class == FORMAT_ARG_INT || (slot != width_slot && slot != precision_slot));
+        if (!accepted) {
+            op->kind = FORMAT_OP_LITERAL;
+            compiled->invalid_count++;
+            continue;
+        }
+
+        if (width_slot) {
+            claim_slot(compiled, width_slot, FORMAT_ARG_INT);
+        }
+        if (precision_slot) {
+            claim_slot(compiled, precision_slot, FORMAT_ARG_INT);
+        }
+        claim_slot(compiled, slot, arg_class);
+        op->info.position = slot;
+        op->info.width_position = width_slot;
+        op->info.precision_position = precision_slot;
+        next = slot + 1;
+    }
+
+    // Nothing says what type an unreferenced argument has; int is the most likely.
+    for (size_t slot = 0; slot < compiled->position_count; slot++) {
+        if (compiled->slot_classes[slot] == FORMAT_ARG_UNKNOWN) {
+            compiled->slot_classes[slot] = FORMAT_ARG_INT;
+        }
+    }
+}
+
+// Parses the format once, following the same rules my_vfprintf applies when formatting directly:
+// '%%' becomes a literal '%', invalid specifiers keep their '%' visible, everything else is literal text.
+compiled_format_t *compile_format(const char *format) {
+    const size_t length = strlen(format);
+    const char *end = format + length;
+
+    // Every '%' can start at most one conversion and one literal run after it,
+    // which bounds the op count and lets the whole entry live in a single allocation.
+    size_t max_ops = 1;
+    for (const char *p = memchr(format, FORMAT_SPECIFIER_START, length); p != NULL;
+         p = memchr(p + 1, FORMAT_SPECIFIER_START, (size_t)(end - p - 1))) {
+        max_ops += 2;
+    }
+
+    compiled_format_t *compiled = malloc(sizeof(compiled_format_t) + max_ops * sizeof(format_op_t) + length + 1);
+    if (!compiled) {
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to allocate compiled format");
+        return NULL;
+    }
+
+    // Literal ops point into a private copy so the entry stays valid whatever happens to the caller's memory.
+    char *text = (char *)&compiled->ops[max_ops];
+    memcpy(text, format, length + 1);
+
+    compiled->format = format;
+    compiled->text = text;
+    compiled->length = length;
+    compiled->generation = get_format_specifiers_generation();
+    compiled->op_count = 0;
+    compiled->invalid_count = 0;
+    compiled->position_count = 0;
+    memset(compiled->slot_classes, FORMAT_ARG_UNKNOWN, sizeof(compiled->slot_classes));
+    compiled->retired = NULL;
+
+    bool positional = false;
+
+    const char *ptr = text;
+    const char *text_end = text + length;
+    while (ptr < text_end) {
+        const char *next = memchr(ptr, FORMAT_SPECIFIER_START, (size_t)(text_end - ptr));
+        if (next == NULL) {
+            next = text_end;
+        }
+        if (next != ptr) {
+            add_literal_op(compiled, ptr, (size_t)(next - ptr));
+            ptr = next;
+            continue;
+        }
+
+        if (ptr[1] == FORMAT_SPECIFIER_START) {
+            // '%%' is emitted as the first '%' of the pair.
+            add_literal_op(compiled, ptr, 1);
+            ptr += 2;
+            continue;
+        }
+
+        const format_info_t info = parse_format(ptr);
+        if (!info.valid) {
+            compiled->invalid_count++;
+            add_literal_op(compiled, ptr, 1);
+            ptr++;
+            continue;
+        }
+
+        format_op_t *op = &compiled->ops[compiled->op_count++];
+        op->kind = FORMAT_OP_CONVERSION;
+        op->literal = ptr;
+        op->literal_length = (size_t)info.length;
+        op->info = info;
+        positional |= info.position || info.width_position || info.precision_position;
+        ptr += info.length;
+    }
+
+    if (positional) {
+        assign_argument_slots(compiled);
+    }
+    return compiled;
+}
+
+// Frees a compiled format; the ops and text share the entry's allocation.
+void free_compiled_format(compiled_format_t *compiled) {
+    free(compiled);
+}
+
+// Gathers every argument in slot order with one sweep of `args`, then replays the ops with each
+// handler (and each '*') reading its value from the gathered array.
+static void render_positional_format(const compiled_format_t *compiled, va_list *args, buffer_t *buffer) {
+    format_value_t values[FORMAT_MAX_POSITIONS];
+    for (size_t slot = 0; slot < compiled->position_count; slot++) {
+        fetch_format_value((format_arg_class_t)compiled->slot_classes[slot], args, &values[slot]);
+    }
+
+    for (size_t i = 0; i < compiled->op_count; i++) {
+        const format_op_t *op = &compiled->ops[i];
+        if (op->kind == FORMAT_OP_LITERAL) {
+            append_reference_to_buffer(buffer, op->literal, op->literal_length);
+            continue;
+        }
+
+        const format_info_t *info = &op->info;
+        format_info_t resolved;
+        if (info->flags & (FORMAT_FLAG_WIDTH_ARG | FORMAT_FLAG_PRECISION_ARG)) {
+            resolved = *info;
+            resolve_star_arguments(&resolved, info->width_position ? values[info->width_position - 1].i : 0,
+                                   info->precision_position ? values[info->precision_position - 1].i : 0);
+            info = &resolved;
+        }
+        invoke_format_handler_with_value(info, &values[info->position - 1], buffer);
+    }
+}
+
+// Replays the op list: literal spans are appended in one call each and conversions
+// go straight to their pre-resolved handler, with no parsing or lookups per call.
+void render_compiled_format(const compiled_format_t *compiled, va_list *args, buffer_t *buffer) {
+    if (compiled->invalid_count > 0) {
+        PRINTF_STATS_INVALID(compiled->invalid_count);
+    }
+    if (compiled->position_count > 0) {
+        render_positional_format(compiled, args, buffer);
+        return;
+    }
+    for (size_t i = 0; i < compiled->op_count; i++) {
+        const format_op_t *op = &compiled->ops[i];
+        if (op->kind == FORMAT_OP_LITERAL) {
+            append_reference_to_buffer(buffer, op->literal, op->literal_length);
+        } else {
+            invoke_format_handler(&op->info, args, buffer);
+        }
+    }
+}
+
+// Maps a format pointer to its home slot. Format strings are mostly string literals laid out
+// next to each other, so the address is scrambled with a multiplicative hash before masking.
+static size_t cache_index(const char *format) {
+    const uint64_t hash = (uint64_t)(uintptr_t)format * UINT64_C(0x9E3779B97F4A7C15);
+    return (size_t)(hash >> 32) & (COMPILED_FORMAT_CACHE_SIZE - 1);
+}
+
+// Pushes a replaced entry onto the retired list with a lock-free stack push.
+static void retire_compiled_format(compiled_format_t *stale) {
+    compiled_format_t *head = atomic_load_explicit(&retired_compiled_formats, memory_order_relaxed);
+    do {
+        stale->retired = head;
+    } while (!atomic_compare_exchange_weak_explicit(&retired_compiled_formats, &head, stale,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+// Looks the format up by pointer, probing a few neighbouring slots, and installs a freshly
+// compiled entry in the first empty one. The cached text is compared against the caller's string
+// so a buffer reused for a different format is never replayed with the wrong ops.
+const compiled_format_t *get_compiled_format(const char *format) {
+    const unsigned generation = get_format_specifiers_generation();
+    const size_t home = cache_index(format);
+
+    for (size_t probe = 0; probe < COMPILED_FORMAT_CACHE_PROBES; probe++) {
+        _Atomic(compiled_format_t *) *slot = &compiled_format_cache[(home + probe) & (COMPILED_FORMAT_CACHE_SIZE - 1)];
+        compiled_format_t *entry = atomic_load_explicit(slot, memory_order_acquire);
+
+        if (entry == NULL) {
+            compiled_format_t *fresh = compile_format(format);
+            if (!fresh) {
+                return NULL;
+            }
+            if (atomic_compare_exchange_strong_explicit(slot, &entry, fresh,
+                                                        memory_order_acq_rel, memory_order_acquire)) {
+                return fresh;
+            }
+            // Another thread claimed the slot first; `entry` now holds its entry, check it below.
+            free_compiled_format(fresh);
+        }
+
+        if (entry->format != format) {
+            continue;
+        }
+        if (strcmp(entry->text, format) != 0) {
+            return NULL;  // Same address, different text: format this one directly.
+        }
+        if (entry->generation == generation) {
+            return entry;
+        }
+
+        // Handlers were registered since this entry was compiled; swap in a re-resolved copy.
+        compiled_format_t *fresh = compile_format(format);
+        if (!fresh) {
+            return NULL;
+        }
+        if (atomic_compare_exchange_strong_explicit(slot, &entry, fresh,
+                                                    memory_order_acq_rel, memory_order_acquire)) {
+            retire_compiled_format(entry);
+            return fresh;
+        }
+        free_compiled_format(fresh);
+        return NULL;  // Lost the race to another refresh; the next call will find the new entry.
+    }
+
+    return NULL;
+}
+
+// Releases every cached and retired entry.
+void clear_compiled_format_cache(void) {
+    for (size_t i = 0; i < COMPILED_FORMAT_CACHE_SIZE; i++) {
+        free_compiled_format(atomic_exchange_explicit(&compiled_format_cache[i], NULL, memory_order_acq_rel));
+    }
+
+    compiled_format_t *stale = atomic_exchange_explicit(&retired_compiled_formats, NULL, memory_order_acq_rel);
+    while (stale) {
+        compiled_format_t *next = stale->retired;
+        free_compiled_format(stale);
+        stale = next;
+    }
+}
@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include "../include/printf.h"
+#include "../include/binary_log.h"
+
+// Renders a binary log (see enable_binary_log) as text on stdout.
+// Usage: decode [file]   (reads stdin when no file is given)
+int main(int argc, char **argv) {
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [binary-log]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *in = stdin;
+    if (argc == 2) {
+        in = fopen(argv[1], "rb");
+        if (!in) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    initialize_printf();
+    const int result = decode_binary_log(in, stdout);
+    cleanup_printf();
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (result < 0) {
+        fprintf(stderr, "%s: malformed binary log\n", argc == 2 ? argv[1] : "stdin");
+        return 1;
+    }
+    return 0;
+}
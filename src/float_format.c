@@ -0,0 +1,469 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "../include/float_format.h"
+#include "../include/integer_format.h"
+
+// The engine reads the IEEE 754 binary64 layout directly.
+_Static_assert(sizeof(double) == sizeof(uint64_t), "double must be IEEE 754 binary64");
+
+#define DOUBLE_MANTISSA_BITS 52
+#define DOUBLE_EXPONENT_MASK 0x7ff
+#define DOUBLE_EXPONENT_BIAS 1075  // Bias plus mantissa bits: value = mantissa * 2^(exponent - 1075).
+
+// Places after the point where every double's exact expansion has ended (2^-1074 needs them all).
+#define DOUBLE_MAX_FRACTION_DIGITS 1074
+
+// Fraction bits the 64-bit fast path can carry while multiplying the fraction by 10.
+#define FAST_PATH_MAX_FRACTION_BITS 60
+
+// Limbs of the exact big-integer path, each holding nine decimal digits.
+#define BIGNUM_LIMB_BASE 1000000000u
+#define BIGNUM_MAX_LIMBS ((FLOAT_MAX_DIGITS + 8) / 9)
+
+// Exact decimal expansion of a finite double: value = 0.d1d2d3... * 10^point.
+// Digits past `count` are zero unless `sticky` says some non-zero digit was not generated.
+typedef struct {
+    char digits[FLOAT_MAX_DIGITS];
+    int count;
+    int point;
+    bool sticky;
+} decimal_t;
+
+// Splits a double into sign, integer mantissa and binary exponent (value = mantissa * 2^exponent),
+// stripping trailing zero bits so the fast path covers as many values as possible.
+static void decompose_double(uint64_t bits, uint64_t *mantissa, int *exponent) {
+    const int biased = (int)((bits >> DOUBLE_MANTISSA_BITS) & DOUBLE_EXPONENT_MASK);
+    uint64_t m = bits & ((UINT64_C(1) << DOUBLE_MANTISSA_BITS) - 1);
+    int e;
+    if (biased == 0) {
+        e = 1 - DOUBLE_EXPONENT_BIAS;  // Subnormal: no implicit bit.
+    } else {
+        m |= UINT64_C(1) << DOUBLE_MANTISSA_BITS;
+        e = biased - DOUBLE_EXPONENT_BIAS;
+    }
+    while (m != 0 && (m & 1) == 0) {
+        m >>= 1;
+        e++;
+    }
+    *mantissa = m;
+    *exponent = e;
+}
+
+// Fast path: when the value splits into a 64-bit integer part and at most 60 fraction bits,
+// every digit can be produced exactly with 64-bit arithmetic. Only the digits the conversion
+// needs are generated: `fraction_digits` + 1 after the point (fixed notation) or
+// `significant_digits` + 1 in total (scientific), the extra one deciding the rounding.
+static bool generate_fast(uint64_t mantissa, int exponent, int fraction_digits, int significant_digits,
+                          decimal_t *decimal) {
+    uint64_t integer;
+    uint64_t fraction;
+    unsigned fraction_bits;
+
+    if (exponent >= 0) {
+        if (exponent >= 64 || (exponent > 0 && (mantissa >> (64 - exponent)) != 0)) {
+            return false;
+        }
+        integer = mantissa << exponent;
+        fraction = 0;
+        fraction_bits = 0;
+    } else {
+        if (-exponent > FAST_PATH_MAX_FRACTION_BITS) {
+            return false;
+        }
+        fraction_bits = (unsigned)-exponent;
+        integer = mantissa >> fraction_bits;
+        fraction = mantissa & ((UINT64_C(1) << fraction_bits) - 1);
+    }
+
+    decimal->count = 0;
+    decimal->point = 0;
+    if (integer != 0) {
+        decimal->count = (int)format_u64(integer, decimal->digits);
+        decimal->point = decimal->count;
+    }
+
+    const uint64_t mask = (UINT64_C(1) << fraction_bits) - 1;
+    int produced = 0;
+    while (fraction != 0) {
+        if (fraction_digits >= 0 ? produced > fraction_digits : decimal->count > significant_digits) {
+            break;
+        }
+        fraction *= 10;
+        const int digit = (int)(fraction >> fraction_bits);
+        fraction &= mask;
+        produced++;
+        if (decimal->count == 0 && digit == 0) {
+            decimal->point--;  // Leading zero after the point.
+            continue;
+        }
+        decimal->digits[decimal->count++] = (char)('0' + digit);
+    }
+    decimal->sticky = fraction != 0;
+    return true;
+}
+
+// Multiplies a little-endian base-1e9 number in place by a factor below 2^32.
+static void bignum_multiply(uint32_t *limbs, int *count, uint32_t factor) {
+    uint64_t carry = 0;
+    for (int i = 0; i < *count; i++) {
+        const uint64_t product = (uint64_t)limbs[i] * factor + carry;
+        limbs[i] = (uint32_t)(product % BIGNUM_LIMB_BASE);
+        carry = product / BIGNUM_LIMB_BASE;
+    }
+    while (carry != 0) {
+        limbs[(*count)++] = (uint32_t)(carry % BIGNUM_LIMB_BASE);
+        carry /= BIGNUM_LIMB_BASE;
+    }
+}
+
+// Exact path for every other value: mantissa * 2^e is an integer for e >= 0, and
+// mantissa * 2^-k = (mantissa * 5^k) / 10^k otherwise, so one big-integer product yields
+// all of the value's decimal digits.
+static void generate_exact(uint64_t mantissa, int exponent, decimal_t *decimal) {
+    uint32_t limbs[BIGNUM_MAX_LIMBS];
+    int count = 0;
+    for (uint64_t m = mantissa; m != 0; m /= BIGNUM_LIMB_BASE) {
+        limbs[count++] = (uint32_t)(m % BIGNUM_LIMB_BASE);
+    }
+
+    if (exponent >= 0) {
+        int remaining = exponent;
+        for (; remaining >= 29; remaining -= 29) {
+            bignum_multiply(limbs, &count, UINT32_C(1) << 29);
+        }
+        if (remaining > 0) {
+            bignum_multiply(limbs, &count, UINT32_C(1) << remaining);
+        }
+    } else {
+        int remaining = -exponent;
+        for (; remaining >= 13; remaining -= 13) {
+            bignum_multiply(limbs, &count, UINT32_C(1220703125));  // 5^13
+        }
+        uint32_t factor = 1;
+        for (; remaining > 0; remaining--) {
+            factor *= 5;
+        }
+        bignum_multiply(limbs, &count, factor);
+    }
+
+    // Most significant limb without leading zeros, then nine digits per limb.
+    int length = (int)format_u32(limbs[count - 1], decimal->digits);
+    for (int i = count - 2; i >= 0; i--) {
+        write_decimal_u32(decimal->digits + length, limbs[i], 9);
+        length += 9;
+    }
+
+    decimal->count = length;
+    decimal->point = exponent >= 0 ? length : length + exponent;
+    decimal->sticky = false;
+}
+
+// Produces the decimal expansion of a finite, non-zero magnitude, preferring the fast path.
+static void generate_decimal(uint64_t bits, int fraction_digits, int significant_digits, decimal_t *decimal) {
+    uint64_t mantissa;
+    int exponent;
+    decompose_double(bits, &mantissa, &exponent);
+    if (!generate_fast(mantissa, exponent, fraction_digits, significant_digits, decimal)) {
+        generate_exact(mantissa, exponent, decimal);
+    }
+}
+
+// Keeps the first `keep` digits, rounding half to even on the exact value like glibc does.
+// A carry out of the first digit becomes a new leading '1' and moves the point.
+static void round_decimal(decimal_t *decimal, int keep) {
+    if (keep >= decimal->count) {
+        return;
+    }
+    if (keep < 0) {
+        decimal->count = 0;  // The first dropped digit is an implicit zero: round down.
+        return;
+    }
+
+    const char first_dropped = decimal->digits[keep];
+    bool tail = decimal->sticky;
+    for (int i = keep + 1; i < decimal->count && !tail; i++) {
+        tail = decimal->digits[i] != '0';
+    }
+    const bool odd = keep > 0 && ((decimal->digits[keep - 1] - '0') & 1);
+    const bool round_up = first_dropped > '5' || (first_dropped == '5' && (tail || odd));
+
+    decimal->count = keep;
+    decimal->sticky = false;
+    if (!round_up) {
+        return;
+    }
+
+    int i = keep - 1;
+    while (i >= 0 && decimal->digits[i] == '9') {
+        decimal->digits[i--] = '0';
+    }
+    if (i >= 0) {
+        decimal->digits[i]++;
+    } else {
+        memmove(decimal->digits + 1, decimal->digits, (size_t)keep);
+        decimal->digits[0] = '1';
+        decimal->count = keep + 1;
+        decimal->point++;
+    }
+}
+
+// Emits the padding, sign and prefix that precede a body of `body_length` bytes.
+// Returns the number of spaces still owed after the body (left-justified fields).
+static size_t begin_float_field(const format_info_t *info, char sign, const char *prefix, size_t prefix_length,
+                                size_t body_length, bool zero_pad, buffer_t *buffer) {
+    const size_t length = (sign ? 1 : 0) + prefix_length + body_length;
+    const size_t padding = (info->flags & FORMAT_FLAG_WIDTH) && (size_t)info->width > length
+                               ? (size_t)info->width - length
+                               : 0;
+    const bool left = (info->flags & FORMAT_FLAG_LEFT) != 0;
+
+    if (!left && !(zero_pad && (info->flags & FORMAT_FLAG_ZERO)) && padding > 0) {
+        fill_buffer(buffer, ' ', padding);
+    }
+    if (sign) {
+        append_to_buffer(buffer, &sign, 1);
+    }
+    append_to_buffer(buffer, prefix, prefix_length);
+    if (!left && zero_pad && (info->flags & FORMAT_FLAG_ZERO) && padding > 0) {
+        fill_buffer(buffer, '0', padding);
+    }
+    return left ? padding : 0;
+}
+
+// Appends digits [from, from + length) of the expansion, with zeros past the generated digits.
+static void append_digits(const decimal_t *decimal, int from, size_t length, buffer_t *buffer) {
+    size_t available = 0;
+    if (from < decimal->count) {
+        available = (size_t)(decimal->count - from);
+        if (available > length) {
+            available = length;
+        }
+        append_to_buffer(buffer, decimal->digits + from, available);
+    }
+    if (length > available) {
+        fill_buffer(buffer, '0', length - available);
+    }
+}
+
+// Writes "e+dd" style exponents (at least two digits) into `out`; returns the length.
+static size_t format_exponent(char *out, char marker, int exponent) {
+    out[0] = marker;
+    out[1] = exponent < 0 ? '-' : '+';
+    const uint32_t magnitude = (uint32_t)(exponent < 0 ? -exponent : exponent);
+    const size_t digits = magnitude < 10 ? 2 : decimal_length_u32(magnitude);
+    write_decimal_u32(out + 2, magnitude, digits);
+    return 2 + digits;
+}
+
+// %f layout: integer digits (or "0"), then '.' and exactly `precision` fraction digits.
+static void emit_fixed(const format_info_t *info, char sign, const decimal_t *decimal, size_t precision,
+                       bool force_point, buffer_t *buffer) {
+    const size_t integer_length = decimal->point > 0 ? (size_t)decimal->point : 1;
+    const bool point = precision > 0 || force_point;
+    const size_t body = integer_length + (point ? 1 + precision : 0);
+
+    const size_t trailing = begin_float_field(info, sign, "", 0, body, true, buffer);
+    if (decimal->point > 0) {
+        append_digits(decimal, 0, integer_length, buffer);
+    } else {
+        append_to_buffer(buffer, "0", 1);
+    }
+    if (point) {
+        append_to_buffer(buffer, ".", 1);
+        size_t remaining = precision;
+        if (decimal->point < 0) {
+            size_t leading = (size_t)-decimal->point;
+            if (leading > remaining) {
+                leading = remaining;
+            }
+            fill_buffer(buffer, '0', leading);
+            remaining -= leading;
+        }
+        append_digits(decimal, decimal->point > 0 ? decimal->point : 0, remaining, buffer);
+    }
+    if (trailing > 0) {
+        fill_buffer(buffer, ' ', trailing);
+    }
+}
+
+// %e layout: one digit, '.', `precision` digits, then the exponent.
+static void emit_exponential(const format_info_t *info, char sign, const decimal_t *decimal, size_t precision,
+                             bool force_point, bool uppercase, buffer_t *buffer) {
+    char exponent[8];
+    const int value_exponent = decimal->count == 0 ? 0 : decimal->point - 1;
+    const size_t exponent_length = format_exponent(exponent, uppercase ? 'E' : 'e', value_exponent);
+    const bool point = precision > 0 || force_point;
+    const size_t body = 1 + (point ? 1 + precision : 0) + exponent_length;
+
+    const size_t trailing = begin_float_field(info, sign, "", 0, body, true, buffer);
+    append_digits(decimal, 0, 1, buffer);
+    if (point) {
+        append_to_buffer(buffer, ".", 1);
+        append_digits(decimal, 1, precision, buffer);
+    }
+    append_to_buffer(buffer, exponent, exponent_length);
+    if (trailing > 0) {
+        fill_buffer(buffer, ' ', trailing);
+    }
+}
+
+// %a layout: "0x" h['.' hhh...] 'p' exponent, straight from the binary representation.
+// With a precision the fraction is rounded half to even; the leading digit may carry to 2 as in glibc.
+static void emit_hexadecimal(const format_info_t *info, char sign, uint64_t bits, bool uppercase,
+                             buffer_t *buffer) {
+    const int biased = (int)((bits >> DOUBLE_MANTISSA_BITS) & DOUBLE_EXPONENT_MASK);
+    uint64_t fraction = bits & ((UINT64_C(1) << DOUBLE_MANTISSA_BITS) - 1);
+    unsigned lead = biased == 0 ? 0 : 1;
+    int exponent = biased == 0 ? (fraction == 0 ? 0 : -1022) : biased - 1023;
+    const int fraction_nibbles = DOUBLE_MANTISSA_BITS / 4;
+
+    size_t digits;
+    if (info->flags & FORMAT_FLAG_PRECISION) {
+        digits = (size_t)info->precision;
+        if (info->precision < fraction_nibbles) {
+            const unsigned shift = (unsigned)(fraction_nibbles - info->precision) * 4;
+            const uint64_t dropped = fraction & ((UINT64_C(1) << shift) - 1);
+            const uint64_t half = UINT64_C(1) << (shift - 1);
+            fraction >>= shift;
+            // With no fraction digits left, the leading digit decides a tie.
+            const bool odd = info->precision == 0 ? (lead & 1) : (fraction & 1);
+            if (dropped > half || (dropped == half && odd)) {
+                fraction++;
+                if (fraction >> (info->precision * 4)) {
+                    fraction = 0;
+                    lead++;
+                }
+            }
+        }
+    } else {
+        digits = fraction_nibbles;
+        while (digits > 0 && (fraction & 0xf) == 0) {
+            fraction >>= 4;
+            digits--;
+        }
+    }
+
+    char head[2] = {(char)('0' + lead), '.'};
+    char nibbles[DOUBLE_MANTISSA_BITS / 4];
+    const size_t exact = digits < (size_t)fraction_nibbles ? digits : (size_t)fraction_nibbles;
+    write_pow2_u64(nibbles, fraction, exact, 4, uppercase ? upper_digits : lower_digits);
+
+    char exponent_text[8];
+    exponent_text[0] = uppercase ? 'P' : 'p';
+    exponent_text[1] = exponent < 0 ? '-' : '+';
+    const size_t exponent_length =
+        2 + format_u32((uint32_t)(exponent < 0 ? -exponent : exponent), exponent_text + 2);
+
+    const bool point = digits > 0 || (info->flags & FORMAT_FLAG_ALTERNATE);
+    const size_t body = 1 + (point ? 1 + digits : 0) + exponent_length;
+    const size_t trailing = begin_float_field(info, sign, uppercase ? "0X" : "0x", 2, body, true, buffer);
+    append_to_buffer(buffer, head, point ? 2 : 1);
+    append_to_buffer(buffer, nibbles, exact);
+    if (digits > exact) {
+        fill_buffer(buffer, '0', digits - exact);
+    }
+    append_to_buffer(buffer, exponent_text, exponent_length);
+    if (trailing > 0) {
+        fill_buffer(buffer, ' ', trailing);
+    }
+}
+
+// Drops trailing zeros from the expansion, as %g does without the '#' flag.
+static void trim_trailing_zeros(decimal_t *decimal) {
+    while (decimal->count > 0 && decimal->digits[decimal->count - 1] == '0') {
+        decimal->count--;
+    }
+}
+
+// Routes the value to the layout of its conversion: %g picks fixed or exponential notation
+// from the exponent the value has after rounding to the requested significant digits.
+void format_double(const format_info_t *info, double value, buffer_t *buffer) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const char conversion = info->specifier;
+    const bool uppercase = conversion == 'F' || conversion == 'E' || conversion == 'G' || conversion == 'A';
+    const bool negative = (bits >> 63) != 0;
+    char sign = 0;
+    if (negative) {
+        sign = '-';
+    } else if (info->flags & FORMAT_FLAG_PLUS) {
+        sign = '+';
+    } else if (info->flags & FORMAT_FLAG_SPACE) {
+        sign = ' ';
+    }
+    bits &= ~(UINT64_C(1) << 63);
+
+    if (((bits >> DOUBLE_MANTISSA_BITS) & DOUBLE_EXPONENT_MASK) == DOUBLE_EXPONENT_MASK) {
+        const bool nan = (bits & ((UINT64_C(1) << DOUBLE_MANTISSA_BITS) - 1)) != 0;
+        const char *text = nan ? (uppercase ? "NAN" : "nan") : (uppercase ? "INF" : "inf");
+        const size_t trailing = begin_float_field(info, sign, "", 0, 3, false, buffer);
+        append_to_buffer(buffer, text, 3);
+        if (trailing > 0) {
+            fill_buffer(buffer, ' ', trailing);
+        }
+        return;
+    }
+
+    if (conversion == 'a' || conversion == 'A') {
+        emit_hexadecimal(info, sign, bits, uppercase, buffer);
+        return;
+    }
+
+    const size_t precision = (info->flags & FORMAT_FLAG_PRECISION) ? (size_t)info->precision
+                                                                    : FLOAT_DEFAULT_PRECISION;
+    const bool alternate = (info->flags & FORMAT_FLAG_ALTERNATE) != 0;
+    decimal_t decimal;
+    decimal.count = 0;
+    decimal.point = 1;  // Zero prints as a single integer digit.
+    decimal.sticky = false;
+
+    if (conversion == 'f' || conversion == 'F') {
+        // The cap counts places after the point, not significant digits: a small value's digits
+        // start hundreds of places in, and the expansion itself never exceeds FLOAT_MAX_DIGITS.
+        const int fraction = precision > DOUBLE_MAX_FRACTION_DIGITS ? DOUBLE_MAX_FRACTION_DIGITS : (int)precision;
+        if (bits != 0) {
+            generate_decimal(bits, fraction, -1, &decimal);
+            round_decimal(&decimal, decimal.point + fraction);
+        }
+        emit_fixed(info, sign, &decimal, precision, alternate, buffer);
+        return;
+    }
+
+    if (conversion == 'e' || conversion == 'E') {
+        const int significant = precision >= FLOAT_MAX_DIGITS ? FLOAT_MAX_DIGITS - 1 : (int)precision + 1;
+        if (bits != 0) {
+            generate_decimal(bits, -1, significant, &decimal);
+            round_decimal(&decimal, significant);
+        }
+        emit_exponential(info, sign, &decimal, precision, alternate, uppercase, buffer);
+        return;
+    }
+
+    // %g / %G
+    const size_t significant = precision == 0 ? 1 : precision;
+    const int keep = significant >= FLOAT_MAX_DIGITS ? FLOAT_MAX_DIGITS - 1 : (int)significant;
+    if (bits != 0) {
+        generate_decimal(bits, -1, keep, &decimal);
+        round_decimal(&decimal, keep);
+    }
+    const long exponent = decimal.count == 0 ? 0 : decimal.point - 1;
+    if (!alternate) {
+        trim_trailing_zeros(&decimal);
+    }
+
+    if (exponent < -4 || exponent >= (long)significant) {
+        size_t fraction = significant - 1;
+        if (!alternate) {
+            fraction = decimal.count > 1 ? (size_t)(decimal.count - 1) : 0;
+        }
+        emit_exponential(info, sign, &decimal, fraction, alternate, uppercase, buffer);
+    } else {
+        size_t fraction = (size_t)((long)significant - 1 - exponent);
+        if (!alternate) {
+            fraction = decimal.count > decimal.point ? (size_t)(decimal.count - decimal.point) : 0;
+        }
+        emit_fixed(info, sign, &decimal, fraction, alternate, buffer);
+    }
+}
@@ -1,208 +1,1048 @@
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <threads.h>
 #include "../include/format_parser.h"
-#include "../include/hashmap.h"
+#include "../include/printf_stats.h"
 #include "../include/buffer.h"
+#include "../include/integer_format.h"
+#include "../include/float_format.h"
+#include "../include/string_format.h"
+#include "../include/error_handling.h"
 
-// Static hashmap to store format specifiers and their handlers once
-// to avoid repetitive lookups and registration during runtime.
-static hashmap_t *format_specifiers = NULL;
+// A conversion registered under a name and written "%{name}".
+typedef struct {
+    const char *name;  // In the owning registry's name_text.
+    format_handler_t handler;
+    format_arg_class_t arg_class;
+} named_specifier_t;
+
+// A node of the trie over registered names. A node's children are chained through
+// next_sibling; node 0 is the root, which no link can point at, so 0 also means "none".
+typedef struct {
+    unsigned char byte;    // The name byte leading to this node.
+    int named;             // Index of the name ending here, or -1.
+    uint32_t first_child;
+    uint32_t next_sibling;
+} name_trie_node_t;
+
+// One immutable version of the specifier registry. Handlers are indexed directly by length
+// modifier and specifier byte, so a lookup is a single load instead of hashing a one-character
+// key. Every (modifier, conversion) pair has its own slot, which lets each one point at a handler
+// specialized for its argument type.
+typedef struct specifier_registry {
+    format_handler_t handlers[LENGTH_MODIFIER_COUNT][SPECIFIER_TABLE_SIZE];
+    unsigned char arg_classes[LENGTH_MODIFIER_COUNT][SPECIFIER_TABLE_SIZE];  // format_arg_class_t per handler.
+    unsigned char conversions[SPECIFIER_TABLE_SIZE];  // SPECIFIER_FLAG_CONVERSION if any row has a handler.
+    named_specifier_t *named;                         // Named conversions, owned by this version.
+    size_t named_count;
+    char *name_text;                                  // The names, NUL-terminated back to back.
+    name_trie_node_t *name_trie;                      // Built at registration, so lookup never compares strings.
+    unsigned generation;                              // Distinguishes this version from every other.
+    struct specifier_registry *retired;               // Link in the list of replaced versions.
+} specifier_registry_t;
+
+// The registry before initialization and after cleanup: no handlers, generation 0.
+static const specifier_registry_t empty_registry;
+
+// The published registry. Readers load it once per lookup with acquire ordering and never lock;
+// registration copies it, changes the copy and publishes the copy with a single atomic store
+// (read-copy-update). Replaced versions stay allocated until cleanup_format_specifiers, since a
+// reader may still be using one.
+static _Atomic(const specifier_registry_t *) current_registry = &empty_registry;
+
+// Serializes writers: registration, initialization and cleanup.
+static mtx_t registry_lock;
+static once_flag registry_lock_once = ONCE_FLAG_INIT;
+static specifier_registry_t *retired_registries = NULL;
+static unsigned last_registry_generation = 0;
+
+// Per-byte classification bits (SPECIFIER_FLAG_*), letting the parser test what a byte is
+// with a table load and a mask rather than a chain of comparisons. These never change; whether
+// a byte is a conversion lives in the registry.
+static const unsigned char specifier_flags[SPECIFIER_TABLE_SIZE] = {
+    ['h'] = SPECIFIER_FLAG_LENGTH,
+    ['l'] = SPECIFIER_FLAG_LENGTH,
+    ['z'] = SPECIFIER_FLAG_LENGTH,
+    ['j'] = SPECIFIER_FLAG_LENGTH,
+    ['t'] = SPECIFIER_FLAG_LENGTH,
+    ['0'] = SPECIFIER_FLAG_DIGIT, ['1'] = SPECIFIER_FLAG_DIGIT, ['2'] = SPECIFIER_FLAG_DIGIT,
+    ['3'] = SPECIFIER_FLAG_DIGIT, ['4'] = SPECIFIER_FLAG_DIGIT, ['5'] = SPECIFIER_FLAG_DIGIT,
+    ['6'] = SPECIFIER_FLAG_DIGIT, ['7'] = SPECIFIER_FLAG_DIGIT, ['8'] = SPECIFIER_FLAG_DIGIT,
+    ['9'] = SPECIFIER_FLAG_DIGIT,
+};
+
+// FORMAT_FLAG_* bit for each flag character, zero for every other byte,
+// so the parser collects flags with one load per character.
+static const unsigned char format_flag_bits[SPECIFIER_TABLE_SIZE] = {
+    ['-'] = FORMAT_FLAG_LEFT,
+    ['+'] = FORMAT_FLAG_PLUS,
+    [' '] = FORMAT_FLAG_SPACE,
+    ['#'] = FORMAT_FLAG_ALTERNATE,
+    ['0'] = FORMAT_FLAG_ZERO,
+};
 
 // Handlers for each supported format specifier.
-static void print_string(va_list args, buffer_t *buffer);
-static void print_char(va_list args, buffer_t *buffer);
-static void print_integer(va_list args, buffer_t *buffer);
-static void print_pointer(va_list args, buffer_t *buffer);
-static void print_binary(va_list args, buffer_t *buffer);
-static void print_hexadecimal_low(va_list args, buffer_t *buffer);
-static void print_hexadecimal_upp(va_list args, buffer_t *buffer);
-static void print_octal(va_list args, buffer_t *buffer);
-static void print_rot(va_list args, buffer_t *buffer);
-
-// Register default format specifiers and their handlers in the hashmap.
+static void print_string(const format_info_t *info, va_list *args, buffer_t *buffer);
+static void print_char(const format_info_t *info, va_list *args, buffer_t *buffer);
+static void print_pointer(const format_info_t *info, va_list *args, buffer_t *buffer);
+static void print_rot(const format_info_t *info, va_list *args, buffer_t *buffer);
+static void print_json(const format_info_t *info, va_list *args, buffer_t *buffer);
+static void print_quoted(const format_info_t *info, va_list *args, buffer_t *buffer);
+static void print_hex_bytes(const format_info_t *info, va_list *args, buffer_t *buffer);
+static void print_upper(const format_info_t *info, va_list *args, buffer_t *buffer);
+static void print_lower(const format_info_t *info, va_list *args, buffer_t *buffer);
+static void print_double(const format_info_t *info, va_list *args, buffer_t *buffer);
+
+// Shared slow paths for specifications that carry flags, a width or a precision.
+static void emit_signed_integer(const format_info_t *info, intmax_t value, buffer_t *buffer);
+static void emit_unsigned_integer(const format_info_t *info, uintmax_t value, unsigned shift, bool uppercase,
+                                  buffer_t *buffer);
+
+// Defines the integer conversion handlers for one length modifier. Each handler fetches its
+// argument at the exact promoted type for that modifier and, for plain specifications, calls the
+// 32- or 64-bit kernel that fits it, so no handler widens everything to 64 bits and branches on
+// the modifier. Flags, width and precision go through the shared field-layout path.
+#define DEFINE_INTEGER_HANDLERS(suffix, signed_type, signed_arg, unsigned_type, unsigned_arg, signed_kernel, unsigned_kernel) \
+    static void print_integer##suffix(const format_info_t *info, va_list *args, buffer_t *buffer) { \
+        const signed_type value = (signed_type)va_arg(*args, signed_arg); \
+        if (info->flags != 0) { emit_signed_integer(info, value, buffer); return; } \
+        char *out = buffer_reserve(buffer, INTEGER_FORMAT_MAX_LENGTH); \
+        if (out) buffer_commit(buffer, signed_kernel(value, out)); \
+    } \
+    static void print_unsigned##suffix(const format_info_t *info, va_list *args, buffer_t *buffer) { \
+        const unsigned_type value = (unsigned_type)va_arg(*args, unsigned_arg); \
+        if (info->flags != 0) { emit_unsigned_integer(info, value, 0, false, buffer); return; } \
+        char *out = buffer_reserve(buffer, INTEGER_FORMAT_MAX_LENGTH); \
+        if (out) buffer_commit(buffer, unsigned_kernel(value, out)); \
+    } \
+    static void print_hexadecimal_low##suffix(const format_info_t *info, va_list *args, buffer_t *buffer) { \
+        const unsigned_type value = (unsigned_type)va_arg(*args, unsigned_arg); \
+        if (info->flags != 0) { emit_unsigned_integer(info, value, 4, false, buffer); return; } \
+        char *out = buffer_reserve(buffer, INTEGER_FORMAT_MAX_LENGTH); \
+        if (out) buffer_commit(buffer, format_hex_u64(value, out, false)); \
+    } \
+    static void print_hexadecimal_upp##suffix(const format_info_t *info, va_list *args, buffer_t *buffer) { \
+        const unsigned_type value = (unsigned_type)va_arg(*args, unsigned_arg); \
+        if (info->flags != 0) { emit_unsigned_integer(info, value, 4, true, buffer); return; } \
+        char *out = buffer_reserve(buffer, INTEGER_FORMAT_MAX_LENGTH); \
+        if (out) buffer_commit(buffer, format_hex_u64(value, out, true)); \
+    } \
+    static void print_octal##suffix(const format_info_t *info, va_list *args, buffer_t *buffer) { \
+        const unsigned_type value = (unsigned_type)va_arg(*args, unsigned_arg); \
+        if (info->flags != 0) { emit_unsigned_integer(info, value, 3, false, buffer); return; } \
+        char *out = buffer_reserve(buffer, INTEGER_FORMAT_MAX_LENGTH); \
+        if (out) buffer_commit(buffer, format_oct_u64(value, out)); \
+    } \
+    static void print_binary##suffix(const format_info_t *info, va_list *args, buffer_t *buffer) { \
+        const unsigned_type value = (unsigned_type)va_arg(*args, unsigned_arg); \
+        if (info->flags != 0) { emit_unsigned_integer(info, value, 1, false, buffer); return; } \
+        char *out = buffer_reserve(buffer, INTEGER_FORMAT_MAX_LENGTH); \
+        if (out) buffer_commit(buffer, format_bin_u64(value, out)); \
+    }
+
+// Types narrower than int arrive promoted and are narrowed back before conversion, as C requires.
+DEFINE_INTEGER_HANDLERS(, int, int, unsigned int, unsigned int, format_i32, format_u32)
+DEFINE_INTEGER_HANDLERS(_hh, signed char, int, unsigned char, unsigned int, format_i32, format_u32)
+DEFINE_INTEGER_HANDLERS(_h, short, int, unsigned short, unsigned int, format_i32, format_u32)
+DEFINE_INTEGER_HANDLERS(_l, long, long, unsigned long, unsigned long, format_i64, format_u64)
+DEFINE_INTEGER_HANDLERS(_ll, long long, long long, unsigned long long, unsigned long long, format_i64, format_u64)
+DEFINE_INTEGER_HANDLERS(_z, ptrdiff_t, ptrdiff_t, size_t, size_t, format_i64, format_u64)
+DEFINE_INTEGER_HANDLERS(_j, intmax_t, intmax_t, uintmax_t, uintmax_t, format_i64, format_u64)
+DEFINE_INTEGER_HANDLERS(_t, ptrdiff_t, ptrdiff_t, size_t, size_t, format_i64, format_u64)
+
+// Sets one slot of a registry that has not been published yet. The byte's conversion bit stays
+// set while any row still has a handler for it.
+static void set_specifier(specifier_registry_t *registry, length_modifier_t modifier, char specifier,
+                          format_handler_t handler, format_arg_class_t arg_class) {
+    const unsigned char index = (unsigned char)specifier;
+    registry->handlers[modifier][index] = handler;
+    registry->arg_classes[modifier][index] = (unsigned char)(handler ? arg_class : FORMAT_ARG_UNKNOWN);
+
+    bool registered = false;
+    for (int row = 0; row < LENGTH_MODIFIER_COUNT; row++) {
+        registered = registered || registry->handlers[row][index] != NULL;
+    }
+    registry->conversions[index] = registered ? SPECIFIER_FLAG_CONVERSION : 0;
+}
+
+// Registers the integer conversions of one length modifier row, with the argument classes
+// its signed and unsigned handlers fetch.
+static void register_integer_specifiers(specifier_registry_t *registry, length_modifier_t modifier,
+                                        format_arg_class_t signed_class, format_arg_class_t unsigned_class,
+                                        format_handler_t signed_handler, format_handler_t unsigned_handler,
+                                        format_handler_t hex_low_handler, format_handler_t hex_upp_handler,
+                                        format_handler_t octal_handler, format_handler_t binary_handler) {
+    set_specifier(registry, modifier, 'd', signed_handler, signed_class);
+    set_specifier(registry, modifier, 'i', signed_handler, signed_class);
+    set_specifier(registry, modifier, 'u', unsigned_handler, unsigned_class);
+    set_specifier(registry, modifier, 'x', hex_low_handler, unsigned_class);
+    set_specifier(registry, modifier, 'X', hex_upp_handler, unsigned_class);
+    set_specifier(registry, modifier, 'o', octal_handler, unsigned_class);
+    set_specifier(registry, modifier, 'b', binary_handler, unsigned_class);
+}
+
+// Register default format specifiers and their handlers in the dispatch table.
 // This avoids repetitive handler declarations and centralizes specifier management.
-static void register_default_specifiers(void) {
-    register_specifier('s', print_string);
-    register_specifier('c', print_char);
-    register_specifier('i', print_integer);
-    register_specifier('d', print_integer);
-    register_specifier('p', print_pointer);
-    register_specifier('b', print_binary);
-    register_specifier('x', print_hexadecimal_low);
-    register_specifier('X', print_hexadecimal_upp);
-    register_specifier('o', print_octal);
-    register_specifier('R', print_rot);
-}
-
-// Initialize the hashmap for format specifiers to allow lookups only once.
-// Ensures thread-safety and resource efficiency by checking if it’s already initialized.
+static void register_default_specifiers(specifier_registry_t *registry) {
+    set_specifier(registry, LENGTH_NONE, 's', print_string, FORMAT_ARG_STRING);
+    set_specifier(registry, LENGTH_NONE, 'c', print_char, FORMAT_ARG_INT);
+    set_specifier(registry, LENGTH_NONE, 'p', print_pointer, FORMAT_ARG_POINTER);
+    set_specifier(registry, LENGTH_NONE, 'R', print_rot, FORMAT_ARG_STRING);
+    set_specifier(registry, LENGTH_NONE, 'J', print_json, FORMAT_ARG_STRING);
+    set_specifier(registry, LENGTH_NONE, 'q', print_quoted, FORMAT_ARG_STRING);
+    // %H reads caller memory through its pointer, so deferred formatting must not capture just
+    // the pointer; leaving the class unknown makes it format on the caller's thread.
+    set_specifier(registry, LENGTH_NONE, 'H', print_hex_bytes, FORMAT_ARG_UNKNOWN);
+
+    // 'l' has no effect on floating-point conversions, so %lf shares the plain handler.
+    static const char float_conversions[] = "fFeEgGaA";
+    for (const char *c = float_conversions; *c; c++) {
+        set_specifier(registry, LENGTH_NONE, *c, print_double, FORMAT_ARG_DOUBLE);
+        set_specifier(registry, LENGTH_L, *c, print_double, FORMAT_ARG_DOUBLE);
+    }
+
+    register_integer_specifiers(registry, LENGTH_NONE, FORMAT_ARG_INT, FORMAT_ARG_UNSIGNED,
+                                print_integer, print_unsigned, print_hexadecimal_low,
+                                print_hexadecimal_upp, print_octal, print_binary);
+    register_integer_specifiers(registry, LENGTH_HH, FORMAT_ARG_INT, FORMAT_ARG_UNSIGNED,
+                                print_integer_hh, print_unsigned_hh, print_hexadecimal_low_hh,
+                                print_hexadecimal_upp_hh, print_octal_hh, print_binary_hh);
+    register_integer_specifiers(registry, LENGTH_H, FORMAT_ARG_INT, FORMAT_ARG_UNSIGNED,
+                                print_integer_h, print_unsigned_h, print_hexadecimal_low_h,
+                                print_hexadecimal_upp_h, print_octal_h, print_binary_h);
+    register_integer_specifiers(registry, LENGTH_L, FORMAT_ARG_LONG, FORMAT_ARG_UNSIGNED_LONG,
+                                print_integer_l, print_unsigned_l, print_hexadecimal_low_l,
+                                print_hexadecimal_upp_l, print_octal_l, print_binary_l);
+    register_integer_specifiers(registry, LENGTH_LL, FORMAT_ARG_LONG_LONG, FORMAT_ARG_UNSIGNED_LONG_LONG,
+                                print_integer_ll, print_unsigned_ll, print_hexadecimal_low_ll,
+                                print_hexadecimal_upp_ll, print_octal_ll, print_binary_ll);
+    register_integer_specifiers(registry, LENGTH_Z, FORMAT_ARG_PTRDIFF, FORMAT_ARG_SIZE,
+                                print_integer_z, print_unsigned_z, print_hexadecimal_low_z,
+                                print_hexadecimal_upp_z, print_octal_z, print_binary_z);
+    register_integer_specifiers(registry, LENGTH_J, FORMAT_ARG_INTMAX, FORMAT_ARG_UINTMAX,
+                                print_integer_j, print_unsigned_j, print_hexadecimal_low_j,
+                                print_hexadecimal_upp_j, print_octal_j, print_binary_j);
+    register_integer_specifiers(registry, LENGTH_T, FORMAT_ARG_PTRDIFF, FORMAT_ARG_SIZE,
+                                print_integer_t, print_unsigned_t, print_hexadecimal_low_t,
+                                print_hexadecimal_upp_t, print_octal_t, print_binary_t);
+}
+
+// Built-in named conversions, for operations that have no conventional conversion letter.
+static const named_specifier_t default_named_specifiers[] = {
+    {"upper", print_upper, FORMAT_ARG_STRING},
+    {"lower", print_lower, FORMAT_ARG_STRING},
+};
+
+static void create_registry_lock(void) {
+    if (mtx_init(&registry_lock, mtx_plain) != thrd_success) {
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to create specifier registry lock");
+    }
+}
+
+static const specifier_registry_t *load_registry(void) {
+    return atomic_load_explicit(&current_registry, memory_order_acquire);
+}
+
+static void free_registry(specifier_registry_t *registry) {
+    free(registry->named);
+    free(registry->name_text);
+    free(registry->name_trie);
+    free(registry);
+}
+
+// Returns the child of `node` reached by `byte`, or 0 if there is none.
+static uint32_t find_trie_child(const name_trie_node_t *trie, uint32_t node, unsigned char byte) {
+    uint32_t child = trie[node].first_child;
+    while (child != 0 && trie[child].byte != byte) {
+        child = trie[child].next_sibling;
+    }
+    return child;
+}
+
+// Gives an unpublished registry its own copy of `entries`: the names are packed into one block
+// and a trie is built over them. Each version owns its table, so retiring one never frees
+// another's. Returns false, leaving the registry without named conversions, if memory runs out.
+static bool set_named_specifiers(specifier_registry_t *registry, const named_specifier_t *entries, size_t count) {
+    registry->named = NULL;
+    registry->named_count = 0;
+    registry->name_text = NULL;
+    registry->name_trie = NULL;
+    if (count == 0) {
+        return true;
+    }
+
+    size_t text_size = 0;
+    for (size_t i = 0; i < count; i++) {
+        text_size += strlen(entries[i].name) + 1;
+    }
+    // The trie has at most one node per name byte, plus the root.
+    named_specifier_t *named = malloc(count * sizeof(named_specifier_t));
+    char *text = malloc(text_size);
+    name_trie_node_t *trie = malloc((text_size - count + 1) * sizeof(name_trie_node_t));
+    if (!named || !text || !trie) {
+        free(named);
+        free(text);
+        free(trie);
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to allocate named specifiers");
+        return false;
+    }
+
+    uint32_t node_count = 1;
+    trie[0] = (name_trie_node_t){0, -1, 0, 0};
+    char *next_name = text;
+    for (size_t i = 0; i < count; i++) {
+        const size_t length = strlen(entries[i].name);
+        memcpy(next_name, entries[i].name, length + 1);
+        named[i] = entries[i];
+        named[i].name = next_name;
+        next_name += length + 1;
+
+        uint32_t node = 0;
+        for (size_t j = 0; j < length; j++) {
+            const unsigned char byte = (unsigned char)entries[i].name[j];
+            uint32_t child = find_trie_child(trie, node, byte);
+            if (child == 0) {
+                child = node_count++;
+                trie[child] = (name_trie_node_t){byte, -1, 0, trie[node].first_child};
+                trie[node].first_child = child;
+            }
+            node = child;
+        }
+        trie[node].named = (int)i;
+    }
+
+    registry->named = named;
+    registry->named_count = count;
+    registry->name_text = text;
+    registry->name_trie = trie;
+    return true;
+}
+
+// Returns a private copy of `source` for a writer to change. Called with the lock held.
+static specifier_registry_t *copy_registry(const specifier_registry_t *source) {
+    specifier_registry_t *copy = malloc(sizeof(specifier_registry_t));
+    if (!copy) {
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to allocate specifier registry");
+        return NULL;
+    }
+    memcpy(copy, source, sizeof(specifier_registry_t));
+    copy->retired = NULL;
+    if (!set_named_specifiers(copy, source->named, source->named_count)) {
+        free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+// Makes a finished copy the current registry. The release store makes all of its contents
+// visible to any reader whose acquire load sees the new pointer. Called with the lock held.
+static void publish_registry(specifier_registry_t *registry) {
+    registry->generation = ++last_registry_generation;
+    const specifier_registry_t *previous = load_registry();
+    atomic_store_explicit(&current_registry, registry, memory_order_release);
+    if (previous != &empty_registry) {
+        specifier_registry_t *stale = (specifier_registry_t *)previous;
+        stale->retired = retired_registries;
+        retired_registries = stale;
+    }
+}
+
+// Publishes the default specifiers once. Safe to call from any number of threads: the first
+// call does the work, and later calls see the registry already in place and return.
 void initialize_format_specifiers(void) {
-    if (format_specifiers == NULL) {
-        format_specifiers = create_hashmap(DEFAULT_HASHMAP_CAPACITY);
-        register_default_specifiers();
+    call_once(&registry_lock_once, create_registry_lock);
+    mtx_lock(&registry_lock);
+    if (load_registry() == &empty_registry) {
+        specifier_registry_t *registry = copy_registry(&empty_registry);
+        if (registry && set_named_specifiers(registry, default_named_specifiers,
+                                             sizeof(default_named_specifiers) / sizeof(default_named_specifiers[0]))) {
+            register_default_specifiers(registry);
+            publish_registry(registry);
+        } else {
+            free(registry);
+        }
     }
+    mtx_unlock(&registry_lock);
 }
 
-// Free the resources used by format specifiers hashmap on cleanup.
-// Important to prevent memory leaks when format specifiers are no longer needed.
+// Returns to the empty registry and frees every version, so a later initialization starts from
+// the defaults. Must not run while other threads are formatting, as they may hold a version.
 void cleanup_format_specifiers(void) {
-    if (format_specifiers != NULL) {
-        free_hashmap(format_specifiers);
-        format_specifiers = NULL;
+    call_once(&registry_lock_once, create_registry_lock);
+    mtx_lock(&registry_lock);
+    const specifier_registry_t *current = load_registry();
+    atomic_store_explicit(&current_registry, &empty_registry, memory_order_release);
+    if (current != &empty_registry) {
+        free_registry((specifier_registry_t *)current);
+    }
+    while (retired_registries) {
+        specifier_registry_t *next = retired_registries->retired;
+        free_registry(retired_registries);
+        retired_registries = next;
+    }
+    mtx_unlock(&registry_lock);
+}
+
+// Consumes a length modifier ("hh", "h", "l", "ll", "z", "j" or "t") and advances past it.
+// Only called once the classification table has flagged the byte as a modifier.
+static length_modifier_t parse_length_modifier(const char **ptr) {
+    const char *p = *ptr;
+    length_modifier_t modifier;
+
+    switch (*p) {
+        case 'h':
+            modifier = (p[1] == 'h') ? LENGTH_HH : LENGTH_H;
+            break;
+        case 'l':
+            modifier = (p[1] == 'l') ? LENGTH_LL : LENGTH_L;
+            break;
+        case 'z':
+            modifier = LENGTH_Z;
+            break;
+        case 'j':
+            modifier = LENGTH_J;
+            break;
+        default:
+            modifier = LENGTH_T;
+            break;
+    }
+
+    *ptr = p + ((modifier == LENGTH_HH || modifier == LENGTH_LL) ? 2 : 1);
+    return modifier;
+}
+
+// Reads a run of decimal digits for a width or precision, advancing past it.
+// Returns false if the number does not fit in an int.
+static bool parse_decimal_field(const char **ptr, int *value) {
+    const char *p = *ptr;
+    int result = 0;
+    while (specifier_flags[(unsigned char)*p] & SPECIFIER_FLAG_DIGIT) {
+        const int digit = *p - '0';
+        if (result > (INT_MAX - digit) / 10) {
+            return false;
+        }
+        result = result * 10 + digit;
+        p++;
+    }
+    *ptr = p;
+    *value = result;
+    return true;
+}
+
+// Reads the "n$" of a positional argument and advances past it. Returns 0, leaving `ptr` alone,
+// when the digits are not followed by '$' (so they are a width), and -1 for an out-of-range number.
+static int parse_position(const char **ptr) {
+    const char *p = *ptr;
+    int position;
+    if (!parse_decimal_field(&p, &position)) {
+        return -1;  // Too large for a width as well.
+    }
+    if (*p != FORMAT_POSITION_END) {
+        return 0;
+    }
+    if (position < 1 || position > FORMAT_MAX_POSITIONS) {
+        return -1;
+    }
+    *ptr = p + 1;
+    return position;
+}
+
+// Finishes parsing "%[flags][width][.precision]{name}" with `ptr` on the '{'. The name is matched
+// by walking the trie one byte at a time, so the cost does not depend on how many names exist.
+static format_info_t parse_named_conversion(const specifier_registry_t *registry, const char *format,
+                                            const char *ptr, unsigned flags, format_info_t info) {
+    const name_trie_node_t *trie = registry->name_trie;
+    uint32_t node = 0;
+    const char *p = ptr + 1;
+    while (trie && *p != NAMED_SPECIFIER_END && *p != '\0') {
+        node = find_trie_child(trie, node, (unsigned char)*p);
+        if (node == 0) {
+            break;
+        }
+        p++;
+    }
+
+    if (trie && *p == NAMED_SPECIFIER_END && node != 0 && trie[node].named >= 0) {
+        const named_specifier_t *named = &registry->named[trie[node].named];
+        info.valid = true;
+        info.specifier = NAMED_SPECIFIER_START;
+        info.flags = flags;
+        info.handler = named->handler;
+        info.arg_class = named->arg_class;
+        info.name = named->name;
+        info.length = (int)(p + 1 - format);
+    } else {
+        info.width = 0;
+        info.precision = 0;
     }
+    return info;
 }
 
 // Parses format starting from '%' and identifies its handler if valid.
-// Provides flexibility to support custom format specifiers as needed.
+// Follows the C layout %[n$][flags][width][.precision][length]specifier; '*' widths and precisions
+// are only marked here and fetched from the arguments by invoke_format_handler.
 format_info_t parse_format(const char *format) {
     format_info_t info = {0};
+    info.valid = false;
+    info.length = INVALID_SPECIFIER_LENGTH;  // Setting length to skip an invalid specifier safely.
 
     if (*format != FORMAT_SPECIFIER_START) {  // Expecting a '%' here
-        info.valid = false;
-        info.length = INVALID_SPECIFIER_LENGTH;
         return info;
     }
 
-    const char *start = format + 1;  // Move past '%'
-    char specifier = *start;
+    const char *ptr = format + 1;  // Move past '%'
+    if (*ptr != '0' && (specifier_flags[(unsigned char)*ptr] & SPECIFIER_FLAG_DIGIT)) {
+        const int position = parse_position(&ptr);
+        if (position < 0) {
+            return info;
+        }
+        info.position = position;
+    }
 
-    format_handler_t handler = get_format_handler(specifier);
+    unsigned flags = 0;
+    unsigned char flag_bit;
+    while ((flag_bit = format_flag_bits[(unsigned char)*ptr]) != 0) {
+        flags |= flag_bit;
+        ptr++;
+    }
+
+    if (*ptr == '*') {
+        flags |= FORMAT_FLAG_WIDTH | FORMAT_FLAG_WIDTH_ARG;
+        ptr++;
+        const int position = parse_position(&ptr);
+        if (position < 0) {
+            return info;
+        }
+        info.width_position = position;
+    } else if (specifier_flags[(unsigned char)*ptr] & SPECIFIER_FLAG_DIGIT) {
+        flags |= FORMAT_FLAG_WIDTH;
+        if (!parse_decimal_field(&ptr, &info.width)) {
+            return info;
+        }
+    }
+
+    if (*ptr == '.') {
+        flags |= FORMAT_FLAG_PRECISION;
+        ptr++;
+        if (*ptr == '*') {
+            flags |= FORMAT_FLAG_PRECISION_ARG;
+            ptr++;
+            const int position = parse_position(&ptr);
+            if (position < 0) {
+                return info;
+            }
+            info.precision_position = position;
+        } else if (!parse_decimal_field(&ptr, &info.precision)) {
+            return info;
+        }
+    }
+
+    const specifier_registry_t *registry = load_registry();
+    if (*ptr == NAMED_SPECIFIER_START) {
+        return parse_named_conversion(registry, format, ptr, flags, info);
+    }
+
+    length_modifier_t modifier = LENGTH_NONE;
+    if (specifier_flags[(unsigned char)*ptr] & SPECIFIER_FLAG_LENGTH) {
+        modifier = parse_length_modifier(&ptr);
+    }
+
+    const unsigned char specifier = (unsigned char)*ptr;
+    const format_handler_t handler = registry->handlers[modifier][specifier];
 
     if (handler) {
         info.valid = true;
-        info.specifier = specifier;
+        info.specifier = (char)specifier;
+        info.length_modifier = modifier;
+        info.flags = flags;
         info.handler = handler;
-        info.length = MAX_SPECIFIER_LENGTH;
+        info.arg_class = (format_arg_class_t)registry->arg_classes[modifier][specifier];
+        info.length = (int)(ptr + 1 - format);
     } else {
-        // Setting length to skip the invalid specifier safely.
-        info.valid = false;
-        info.length = INVALID_SPECIFIER_LENGTH;
+        info.width = 0;
+        info.precision = 0;
     }
 
     return info;
 }
 
+// Applies C's rules for '*' values; shared by direct formatting and deferred replay.
+void resolve_star_arguments(format_info_t *info, int width, int precision) {
+    if (info->flags & FORMAT_FLAG_WIDTH_ARG) {
+        if (width < 0) {
+            // A negative '*' width is a '-' flag plus a positive width.
+            info->flags |= FORMAT_FLAG_LEFT;
+            info->width = width == INT_MIN ? INT_MAX : -width;
+        } else {
+            info->width = width;
+        }
+    }
+    if (info->flags & FORMAT_FLAG_PRECISION_ARG) {
+        if (precision < 0) {
+            info->flags &= ~(unsigned)FORMAT_FLAG_PRECISION;  // Negative means "as if omitted".
+        } else {
+            info->precision = precision;
+        }
+    }
+    info->flags &= ~(unsigned)(FORMAT_FLAG_WIDTH_ARG | FORMAT_FLAG_PRECISION_ARG);
+}
+
+// Every handler call goes through here so that, with statistics compiled in, each conversion is
+// counted (and timed when timing is on) under its conversion character.
+static inline void run_handler(const format_info_t *info, va_list *args, buffer_t *buffer) {
+#ifdef PRINTF_STATS
+    const uint64_t start = printf_stats_timer_start();
+    info->handler(info, args, buffer);
+    printf_stats_record_specifier((unsigned char)info->specifier, start);
+#else
+    info->handler(info, args, buffer);
+#endif
+}
+
+// Runs the handler, resolving '*' widths and precisions first. Specifications without them,
+// the overwhelmingly common case, are passed through untouched.
+void invoke_format_handler(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    if (!(info->flags & (FORMAT_FLAG_WIDTH_ARG | FORMAT_FLAG_PRECISION_ARG))) {
+        run_handler(info, args, buffer);
+        return;
+    }
+
+    format_info_t resolved = *info;
+    const int width = (info->flags & FORMAT_FLAG_WIDTH_ARG) ? va_arg(*args, int) : 0;
+    const int precision = (info->flags & FORMAT_FLAG_PRECISION_ARG) ? va_arg(*args, int) : 0;
+    resolve_star_arguments(&resolved, width, precision);
+    run_handler(&resolved, args, buffer);
+}
+
+// Reads a value with va_arg at exactly the type its handler will read it back with.
+bool fetch_format_value(format_arg_class_t arg_class, va_list *args, format_value_t *value) {
+    switch (arg_class) {
+        case FORMAT_ARG_INT: value->i = va_arg(*args, int); return true;
+        case FORMAT_ARG_UNSIGNED: value->u = va_arg(*args, unsigned); return true;
+        case FORMAT_ARG_LONG: value->l = va_arg(*args, long); return true;
+        case FORMAT_ARG_UNSIGNED_LONG: value->ul = va_arg(*args, unsigned long); return true;
+        case FORMAT_ARG_LONG_LONG: value->ll = va_arg(*args, long long); return true;
+        case FORMAT_ARG_UNSIGNED_LONG_LONG: value->ull = va_arg(*args, unsigned long long); return true;
+        case FORMAT_ARG_INTMAX: value->j = va_arg(*args, intmax_t); return true;
+        case FORMAT_ARG_UINTMAX: value->uj = va_arg(*args, uintmax_t); return true;
+        case FORMAT_ARG_SIZE: value->z = va_arg(*args, size_t); return true;
+        case FORMAT_ARG_PTRDIFF: value->t = va_arg(*args, ptrdiff_t); return true;
+        case FORMAT_ARG_DOUBLE: value->d = va_arg(*args, double); return true;
+        case FORMAT_ARG_POINTER: value->p = va_arg(*args, void *); return true;
+        case FORMAT_ARG_STRING: value->s = va_arg(*args, const char *); return true;
+        default: return false;
+    }
+}
+
+// Builds a va_list holding the single value and runs the handler on it.
+static void invoke_with_arguments(const format_info_t *info, buffer_t *buffer, ...) {
+    va_list args;
+    va_start(args, buffer);
+    run_handler(info, &args, buffer);
+    va_end(args);
+}
+
+// Replays a stored value through the same handler direct formatting would use. Each class is
+// passed as its own promoted type, which is what the handler's va_arg expects.
+void invoke_format_handler_with_value(const format_info_t *info, const format_value_t *value, buffer_t *buffer) {
+    switch (info->arg_class) {
+        case FORMAT_ARG_INT: invoke_with_arguments(info, buffer, value->i); break;
+        case FORMAT_ARG_UNSIGNED: invoke_with_arguments(info, buffer, value->u); break;
+        case FORMAT_ARG_LONG: invoke_with_arguments(info, buffer, value->l); break;
+        case FORMAT_ARG_UNSIGNED_LONG: invoke_with_arguments(info, buffer, value->ul); break;
+        case FORMAT_ARG_LONG_LONG: invoke_with_arguments(info, buffer, value->ll); break;
+        case FORMAT_ARG_UNSIGNED_LONG_LONG: invoke_with_arguments(info, buffer, value->ull); break;
+        case FORMAT_ARG_INTMAX: invoke_with_arguments(info, buffer, value->j); break;
+        case FORMAT_ARG_UINTMAX: invoke_with_arguments(info, buffer, value->uj); break;
+        case FORMAT_ARG_SIZE: invoke_with_arguments(info, buffer, value->z); break;
+        case FORMAT_ARG_PTRDIFF: invoke_with_arguments(info, buffer, value->t); break;
+        case FORMAT_ARG_DOUBLE: invoke_with_arguments(info, buffer, value->d); break;
+        case FORMAT_ARG_POINTER: invoke_with_arguments(info, buffer, value->p); break;
+        case FORMAT_ARG_STRING: invoke_with_arguments(info, buffer, (char *)value->s); break;
+        default: break;  // Values of unknown class cannot be stored, so there is nothing to replay.
+    }
+}
+
 // Register a format specifier and associate it with a handler function.
-// Wrapping function pointers in structs simplifies hashmap insertion and management.
+// Plain specifiers occupy the LENGTH_NONE row of the dispatch table.
 void register_specifier(char specifier, format_handler_t handler) {
-    if (format_specifiers != NULL) {
-        char key[2] = {specifier, '\0'};
+    register_length_specifier(LENGTH_NONE, specifier, handler);
+}
 
-        function_wrapper_t *wrapper = malloc(sizeof(function_wrapper_t));
-        wrapper->handler = handler;
+// Register the handler for one (length modifier, specifier) pair. Its argument class is unknown,
+// so deferred formatting formats such conversions on the caller's thread.
+void register_length_specifier(length_modifier_t modifier, char specifier, format_handler_t handler) {
+    register_typed_specifier(modifier, specifier, handler, FORMAT_ARG_UNKNOWN);
+}
 
-        insert_hashmap(format_specifiers, key, wrapper);
+// Registers a handler and the class of its argument by publishing an updated copy of the
+// registry. Formatting threads keep using the version they loaded and pick up the new one on
+// their next lookup; compiled formats see the new generation and re-resolve their handlers.
+void register_typed_specifier(length_modifier_t modifier, char specifier, format_handler_t handler,
+                              format_arg_class_t arg_class) {
+    if (modifier >= LENGTH_MODIFIER_COUNT) {
+        return;
+    }
+    call_once(&registry_lock_once, create_registry_lock);
+    mtx_lock(&registry_lock);
+    const specifier_registry_t *current = load_registry();
+    if (current != &empty_registry) {  // Registration is ignored before initialization.
+        specifier_registry_t *registry = copy_registry(current);
+        if (registry) {
+            set_specifier(registry, modifier, specifier, handler, arg_class);
+            publish_registry(registry);
+        }
     }
+    mtx_unlock(&registry_lock);
+}
+
+// Publishes a copy of the registry whose named table has `name` set to `handler` (or removed,
+// for NULL). The trie is rebuilt from scratch; registration is rare and lookups stay cheap.
+void register_named_specifier(const char *name, format_handler_t handler, format_arg_class_t arg_class) {
+    const size_t name_length = name ? strlen(name) : 0;
+    if (name_length == 0 || name_length > NAMED_SPECIFIER_MAX_LENGTH || strchr(name, NAMED_SPECIFIER_END)) {
+        handle_error(INVALID_FORMAT, "Invalid named specifier");
+        return;
+    }
+    call_once(&registry_lock_once, create_registry_lock);
+    mtx_lock(&registry_lock);
+    const specifier_registry_t *current = load_registry();
+    if (current != &empty_registry) {  // Registration is ignored before initialization.
+        named_specifier_t *entries = malloc((current->named_count + 1) * sizeof(named_specifier_t));
+        specifier_registry_t *registry = malloc(sizeof(specifier_registry_t));
+        if (entries && registry) {
+            size_t count = 0;
+            for (size_t i = 0; i < current->named_count; i++) {
+                if (strcmp(current->named[i].name, name) != 0) {
+                    entries[count++] = current->named[i];
+                }
+            }
+            if (handler) {
+                entries[count++] = (named_specifier_t){name, handler, arg_class};
+            }
+
+            memcpy(registry, current, sizeof(specifier_registry_t));
+            registry->retired = NULL;
+            if (set_named_specifiers(registry, entries, count)) {
+                publish_registry(registry);
+                registry = NULL;
+            }
+        } else {
+            handle_error(MEMORY_ALLOCATION_ERROR, "Failed to allocate specifier registry");
+        }
+        free(registry);
+        free(entries);
+    }
+    mtx_unlock(&registry_lock);
+}
+
+// Looks a name up the same way the parser does.
+format_handler_t get_named_format_handler(const char *name) {
+    char format[NAMED_SPECIFIER_MAX_LENGTH + 4];
+    const size_t length = name ? strlen(name) : 0;
+    if (length == 0 || length > NAMED_SPECIFIER_MAX_LENGTH) {
+        return NULL;
+    }
+    format[0] = FORMAT_SPECIFIER_START;
+    format[1] = NAMED_SPECIFIER_START;
+    memcpy(format + 2, name, length);
+    format[length + 2] = NAMED_SPECIFIER_END;
+    format[length + 3] = '\0';
+    const format_info_t info = parse_format(format);
+    return info.valid && (size_t)info.length == length + 3 ? info.handler : NULL;
 }
 
 // Retrieve the handler function for a given format specifier.
 // Returns NULL if the handler is not registered, allowing the caller to handle missing cases.
 format_handler_t get_format_handler(char specifier) {
-    if (format_specifiers != NULL) {
-        char key[2] = {specifier, '\0'};
+    return load_registry()->handlers[LENGTH_NONE][(unsigned char)specifier];
+}
+
+// Retrieve the handler for a specifier combined with a length modifier.
+format_handler_t get_length_format_handler(length_modifier_t modifier, char specifier) {
+    return modifier < LENGTH_MODIFIER_COUNT ? load_registry()->handlers[modifier][(unsigned char)specifier] : NULL;
+}
 
-        function_wrapper_t *wrapper = (function_wrapper_t *)get_hashmap(format_specifiers, key);
-        return wrapper ? wrapper->handler : NULL;
+// Retrieve the classification bits for a byte following '%'.
+unsigned char get_specifier_flags(char specifier) {
+    const unsigned char index = (unsigned char)specifier;
+    return specifier_flags[index] | load_registry()->conversions[index];
+}
+
+// Exposes the registry generation so compiled formats know when to re-resolve their handlers.
+unsigned get_format_specifiers_generation(void) {
+    return load_registry()->generation;
+}
+
+// Number of padding bytes a field of `length` content bytes needs to reach the width.
+static size_t field_padding(const format_info_t *info, size_t length) {
+    if (!(info->flags & FORMAT_FLAG_WIDTH) || (size_t)info->width <= length) {
+        return 0;
+    }
+    return (size_t)info->width - length;
+}
+
+// Appends text content padded with spaces to the field width, on the left unless '-' was given.
+// Padding goes out as one bulk fill. Long text may be referenced rather than copied, so it must
+// stay valid until the message is written (string arguments and literals do).
+static void emit_text_field(const format_info_t *info, const char *text, size_t length, buffer_t *buffer) {
+    const size_t padding = field_padding(info, length);
+    if (padding > 0 && !(info->flags & FORMAT_FLAG_LEFT)) {
+        fill_buffer(buffer, ' ', padding);
+    }
+    append_reference_to_buffer(buffer, text, length);
+    if (padding > 0 && (info->flags & FORMAT_FLAG_LEFT)) {
+        fill_buffer(buffer, ' ', padding);
     }
-    return NULL;
+}
+
+// Lays out an integer field as [spaces][prefix][zeros][digits][spaces], following C's rules:
+// the precision is a minimum digit count (".0" prints nothing for zero), '0' pads with zeros
+// only when no precision is given, and '#' with octal forces a leading zero.
+static void emit_integer_field(const format_info_t *info, const char *prefix, size_t prefix_length,
+                               uint64_t magnitude, unsigned shift, const char *digit_table, buffer_t *buffer) {
+    char digits[INTEGER_FORMAT_MAX_LENGTH];
+    size_t digit_count;
+    if (shift == 0) {
+        digit_count = decimal_length_u64(magnitude);
+        write_decimal_u64(digits, magnitude, digit_count);
+    } else {
+        digit_count = pow2_length_u64(magnitude, shift);
+        write_pow2_u64(digits, magnitude, digit_count, shift, digit_table);
+    }
+
+    size_t zeros = 0;
+    if (info->flags & FORMAT_FLAG_PRECISION) {
+        if (info->precision == 0 && magnitude == 0) {
+            digit_count = 0;
+        }
+        if ((size_t)info->precision > digit_count) {
+            zeros = (size_t)info->precision - digit_count;
+        }
+    }
+    if (shift == 3 && (info->flags & FORMAT_FLAG_ALTERNATE) && zeros == 0 &&
+        (digit_count == 0 || digits[0] != '0')) {
+        zeros = 1;
+    }
+
+    const size_t padding = field_padding(info, prefix_length + zeros + digit_count);
+    const bool left = (info->flags & FORMAT_FLAG_LEFT) != 0;
+    if (!left) {
+        if ((info->flags & FORMAT_FLAG_ZERO) && !(info->flags & FORMAT_FLAG_PRECISION)) {
+            zeros += padding;
+        } else if (padding > 0) {
+            fill_buffer(buffer, ' ', padding);
+        }
+    }
+
+    append_to_buffer(buffer, prefix, prefix_length);
+    if (zeros > 0) {
+        fill_buffer(buffer, '0', zeros);
+    }
+    append_to_buffer(buffer, digits, digit_count);
+
+    if (left && padding > 0) {
+        fill_buffer(buffer, ' ', padding);
+    }
+}
+
+// Slow path for signed conversions: picks the sign ('-', '+' or ' ') and lays out the field.
+static void emit_signed_integer(const format_info_t *info, intmax_t value, buffer_t *buffer) {
+    const uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    const char *sign = "";
+    if (value < 0) {
+        sign = "-";
+    } else if (info->flags & FORMAT_FLAG_PLUS) {
+        sign = "+";
+    } else if (info->flags & FORMAT_FLAG_SPACE) {
+        sign = " ";
+    }
+    emit_integer_field(info, sign, sign[0] ? 1 : 0, magnitude, 0, lower_digits, buffer);
+}
+
+// Slow path for unsigned conversions in base 10 (shift 0) or base 2^shift.
+// '#' adds "0x"/"0X"/"0b" for non-zero values; octal's leading zero is handled by the field layout.
+static void emit_unsigned_integer(const format_info_t *info, uintmax_t value, unsigned shift, bool uppercase,
+                                  buffer_t *buffer) {
+    const char *prefix = "";
+    if ((info->flags & FORMAT_FLAG_ALTERNATE) && value != 0) {
+        if (shift == 4) {
+            prefix = uppercase ? "0X" : "0x";
+        } else if (shift == 1) {
+            prefix = "0b";
+        }
+    }
+    emit_integer_field(info, prefix, strlen(prefix), (uint64_t)value, shift,
+                       uppercase ? upper_digits : lower_digits, buffer);
+}
+
+// Number of bytes a string conversion takes from `value`: all of it, or at most the precision,
+// in which case the string need not be terminated within it.
+static size_t string_argument_length(const format_info_t *info, const char *value) {
+    if (info->flags & FORMAT_FLAG_PRECISION) {
+        const char *end = memchr(value, '\0', (size_t)info->precision);
+        return end ? (size_t)(end - value) : (size_t)info->precision;
+    }
+    return strlen(value);
 }
 
 // Appends a string to the buffer, handling NULL cases explicitly
 // to prevent unexpected behavior with NULL pointers.
-void print_string(va_list args, buffer_t *buffer) {
-    char *value = va_arg(args, char *);
+// The precision caps the bytes taken, so the string need not be terminated within it.
+void print_string(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    const char *value = va_arg(*args, char *);
     if (value == NULL) {
-        append_to_buffer(buffer, "(null)", 6);  // Standard fallback for NULL strings
+        // Like glibc, print "(null)" only when the precision leaves room for all of it.
+        const bool fits = !(info->flags & FORMAT_FLAG_PRECISION) || info->precision >= 6;
+        value = fits ? "(null)" : "";
+    }
+
+    const size_t length = string_argument_length(info, value);
+
+    if (info->flags == 0) {
+        append_reference_to_buffer(buffer, value, length);
     } else {
-        append_to_buffer(buffer, value, strlen(value));
+        emit_text_field(info, value, length, buffer);
     }
 }
 
 // Appends a char argument to the buffer.
 // Casting to char here handles potential widening due to default argument promotions.
-void print_char(va_list args, buffer_t *buffer) {
-    char value = (char)va_arg(args, int);
-    append_to_buffer(buffer, &value, 1);
-}
-
-// Converts an integer to a string and appends it to the buffer.
-// Relies on base 10 to maintain compatibility with common integer specifiers.
-void print_integer(va_list args, buffer_t *buffer) {
-    int value = va_arg(args, int);
-    char str[20];
-    itoa(value, str, 10);
-    append_to_buffer(buffer, str, strlen(str));
+void print_char(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    char value = (char)va_arg(*args, int);
+    emit_text_field(info, &value, 1, buffer);
 }
 
 // Formats a pointer to a hexadecimal representation with '0x' prefix.
 // Uses uintptr_t to support pointers of varying sizes, increasing portability.
-void print_pointer(va_list args, buffer_t *buffer) {
-    void *ptr = va_arg(args, void *);
+void print_pointer(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    void *ptr = va_arg(*args, void *);
     if (ptr == NULL) {
-        append_to_buffer(buffer, "(nil)", 5);  // Conventionally represent NULL pointers
+        emit_text_field(info, "(nil)", 5, buffer);  // Conventionally represent NULL pointers
         return;
     }
     uintptr_t value = (uintptr_t)ptr;
-    char str[20];
-    itoa(value, str, 16);
-    append_to_buffer(buffer, "0x", 2);
-    append_to_buffer(buffer, str, strlen(str));
+    if (info->flags != 0) {
+        emit_integer_field(info, "0x", 2, value, 4, lower_digits, buffer);
+        return;
+    }
+    char *out = buffer_reserve(buffer, INTEGER_FORMAT_MAX_LENGTH + 2);
+    if (out) {
+        out[0] = '0';
+        out[1] = 'x';
+        buffer_commit(buffer, format_hex_u64(value, out + 2, false) + 2);
+    }
+}
+
+// Formats a double for %f, %F, %e, %E, %g, %G, %a and %A; float arguments arrive promoted to double.
+void print_double(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    format_double(info, va_arg(*args, double), buffer);
+}
+
+// Shared by the letter-transforming string conversions. The transform keeps the length, so the
+// field is laid out as for %s and the text goes through the vectorized transform in one span.
+static void emit_transformed_field(const format_info_t *info, va_list *args, string_transform_t transform,
+                                   buffer_t *buffer) {
+    const char *str = va_arg(*args, char *);
+    if (str == NULL) {
+        emit_text_field(info, "(null)", 6, buffer);
+        return;
+    }
+
+    const size_t length = string_argument_length(info, str);
+    const size_t padding = field_padding(info, length);
+    if (padding > 0 && !(info->flags & FORMAT_FLAG_LEFT)) {
+        fill_buffer(buffer, ' ', padding);
+    }
+    append_transformed(buffer, str, length, transform);
+    if (padding > 0 && (info->flags & FORMAT_FLAG_LEFT)) {
+        fill_buffer(buffer, ' ', padding);
+    }
 }
 
-// Converts an unsigned integer to a binary string representation for %b specifier.
-// Provides a max buffer size to handle up to 32-bit binary strings safely.
-void print_binary(va_list args, buffer_t *buffer) {
-    unsigned int value = va_arg(args, unsigned int);
-    char str[35];
-    itoa(value, str, 2);
-    append_to_buffer(buffer, str, strlen(str));
+// Applies ROT13 to each character in the string for the %R specifier.
+// ROT13 transformation provides simple encoding, common in specific applications.
+// Width and precision apply as they do for %s.
+void print_rot(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    emit_transformed_field(info, args, STRING_TRANSFORM_ROT13, buffer);
+}
+
+// Upper-cases the ASCII letters of a string (%{upper}); other bytes, including UTF-8, are kept.
+void print_upper(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    emit_transformed_field(info, args, STRING_TRANSFORM_UPPER, buffer);
 }
 
-// Converts an unsigned integer to a lowercase hexadecimal string.
-void print_hexadecimal_low(va_list args, buffer_t *buffer) {
-    unsigned int value = va_arg(args, unsigned int);
-    char str[20];
-    itoa(value, str, 16);
-    append_to_buffer(buffer, str, strlen(str));
+// Lower-cases the ASCII letters of a string (%{lower}).
+void print_lower(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    emit_transformed_field(info, args, STRING_TRANSFORM_LOWER, buffer);
 }
 
-// Converts an unsigned integer to an uppercase hexadecimal string.
-// Uppercase conversion is applied after conversion for clarity.
-void print_hexadecimal_upp(va_list args, buffer_t *buffer) {
-    unsigned int value = va_arg(args, unsigned int);
-    char str[20];
-    itoa(value, str, 16);
-    for (int i = 0; str[i] != '\0'; i++) {
-        str[i] = toupper(str[i]);
+// Writes an escaped string padded to the field width. The escaped length is only measured when
+// a width needs it; otherwise the text goes straight through the escaping kernel.
+static void emit_escaped_field(const format_info_t *info, const char *text, size_t length,
+                               size_t (*measure)(const char *, size_t),
+                               void (*append)(buffer_t *, const char *, size_t), buffer_t *buffer) {
+    const size_t padding = (info->flags & FORMAT_FLAG_WIDTH) ? field_padding(info, measure(text, length)) : 0;
+    if (padding > 0 && !(info->flags & FORMAT_FLAG_LEFT)) {
+        fill_buffer(buffer, ' ', padding);
+    }
+    append(buffer, text, length);
+    if (padding > 0 && (info->flags & FORMAT_FLAG_LEFT)) {
+        fill_buffer(buffer, ' ', padding);
     }
-    append_to_buffer(buffer, str, strlen(str));
 }
 
-// Converts an unsigned integer to an octal string for the %o specifier.
-// The octal base is directly applied to fit common format specifier standards.
-void print_octal(va_list args, buffer_t *buffer) {
-    unsigned int value = va_arg(args, unsigned int);
-    char str[20];
-    itoa(value, str, 8);
-    append_to_buffer(buffer, str, strlen(str));
+// Escapes a string for the inside of a JSON string literal (%J), so structured logs need no
+// separate escaping pass. The precision limits the input bytes taken; the width pads the output.
+void print_json(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    const char *str = va_arg(*args, char *);
+    if (str == NULL) {
+        emit_text_field(info, "(null)", 6, buffer);
+        return;
+    }
+    emit_escaped_field(info, str, string_argument_length(info, str), json_escaped_length, append_json_escaped,
+                       buffer);
 }
 
-// Applies ROT13 to each character in the string for the %R specifier.
-// ROT13 transformation provides simple encoding, common in specific applications.
-void print_rot(va_list args, buffer_t *buffer) {
-    char *str = va_arg(args, char *);
+// Writes a string as a quoted, printable C string literal (%q), safe to paste into code or a
+// terminal. Precision and width apply as for %J.
+void print_quoted(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    const char *str = va_arg(*args, char *);
     if (str == NULL) {
-        append_to_buffer(buffer, "(null)", 6);
+        emit_text_field(info, "(null)", 6, buffer);
         return;
     }
-    for (int i = 0; str[i] != '\0'; i++) {
-        char c = str[i];
-        if (c >= 'a' && c <= 'z') {
-            c = (c - 'a' + 13) % 26 + 'a';
-        } else if (c >= 'A' && c <= 'Z') {
-            c = (c - 'A' + 13) % 26 + 'A';
-        }
-        append_to_buffer(buffer, &c, 1);
+    emit_escaped_field(info, str, string_argument_length(info, str), c_quoted_length, append_c_quoted, buffer);
+}
+
+// Dumps a byte range as hex (%H): the argument is a pointer and the precision is the number of
+// bytes, usually given as "%.*H". ' ' puts a space between bytes, '+' selects uppercase digits and
+// '#' the canonical `hexdump -C` layout. The width pads the output as for %s.
+void print_hex_bytes(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    const unsigned char *bytes = va_arg(*args, const unsigned char *);
+    const size_t length = (info->flags & FORMAT_FLAG_PRECISION) ? (size_t)info->precision : 0;
+    if (bytes == NULL && length > 0) {
+        emit_text_field(info, "(null)", 6, buffer);
+        return;
+    }
+
+    const bool uppercase = (info->flags & FORMAT_FLAG_PLUS) != 0;
+    const bool separated = (info->flags & FORMAT_FLAG_SPACE) != 0;
+    const bool dump = (info->flags & FORMAT_FLAG_ALTERNATE) != 0;
+    const size_t output_length = dump ? hexdump_length(length) : hex_length(length, separated);
+    const size_t padding = field_padding(info, output_length);
+    if (padding > 0 && !(info->flags & FORMAT_FLAG_LEFT)) {
+        fill_buffer(buffer, ' ', padding);
+    }
+    if (dump) {
+        append_hexdump(buffer, bytes, length, uppercase);
+    } else {
+        append_hex(buffer, bytes, length, uppercase, separated);
+    }
+    if (padding > 0 && (info->flags & FORMAT_FLAG_LEFT)) {
+        fill_buffer(buffer, ' ', padding);
     }
 }
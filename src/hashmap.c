@@ -1,6 +1,8 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "../include/hashmap.h"
+#include "../include/error_handling.h"
 
 // DJB2 hash function, a commonly used and efficient hash function for strings.
 // See: https://stackoverflow.com/questions/7666509/hash-function-for-string
@@ -16,98 +18,231 @@ size_t hash_function(const char *key) {
     return hash;
 }
 
-// Creates a new key-value pair (bucket), duplicating the key to prevent external modifications.
-bucket_t *create_bucket(const char *key, void *value) {
-    bucket_t *bucket = malloc(sizeof(bucket_t));
-    if (!bucket) return NULL;
+// The stored hash: never 0, which marks empty slots.
+static size_t entry_hash(const char *key) {
+    const size_t hash = hash_function(key);
+    return hash ? hash : 1;
+}
+
+// Maps a hash to its home slot. DJB2's low bits are weak for short keys, so the hash is spread
+// with a multiplicative (Fibonacci) step and the slot taken from the high bits.
+static size_t home_slot(const hashmap_t *map, size_t hash) {
+    return (size_t)(((uint64_t)hash * UINT64_C(0x9E3779B97F4A7C15)) >> map->shift);
+}
+
+// How far the entry in `slot` sits from its home slot.
+static size_t probe_distance(const hashmap_t *map, size_t hash, size_t slot) {
+    return (slot - home_slot(map, hash)) & (map->capacity - 1);
+}
+
+static unsigned log2_of(size_t power_of_two) {
+    unsigned log = 0;
+    while (((size_t)1 << log) < power_of_two) {
+        log++;
+    }
+    return log;
+}
+
+// Copies a key into the arena, starting a new block when the current one is full.
+static const char *store_key(hashmap_t *map, const char *key) {
+    const size_t length = strlen(key) + 1;
+    hashmap_arena_block_t *block = map->arena;
+    if (!block || block->size - block->used < length) {
+        const size_t size = length > HASHMAP_ARENA_BLOCK_SIZE ? length : HASHMAP_ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(hashmap_arena_block_t) + size);
+        if (!block) {
+            return NULL;
+        }
+        block->next = map->arena;
+        block->used = 0;
+        block->size = size;
+        map->arena = block;
+    }
+
+    char *copy = block->data + block->used;
+    memcpy(copy, key, length);
+    block->used += length;
+    map->arena_live += length;
+    return copy;
+}
 
-    bucket->key = strdup(key);  // Copy key for data integrity within the hashmap.
-    bucket->value = value;
-    bucket->next = NULL;
+static void free_arena(hashmap_arena_block_t *block) {
+    while (block) {
+        hashmap_arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+}
 
-    return bucket;
+// Places an entry known to be absent. The incoming entry takes the slot of any resident that is
+// closer to its home than the incoming one is (Robin Hood), and the resident moves on instead;
+// this keeps probe lengths even, so lookups can stop as soon as they pass a richer entry.
+static void place_entry(hashmap_t *map, hashmap_entry_t entry) {
+    const size_t mask = map->capacity - 1;
+    size_t slot = home_slot(map, entry.hash);
+    size_t distance = 0;
+    for (;;) {
+        hashmap_entry_t *resident = &map->entries[slot];
+        if (resident->hash == 0) {
+            *resident = entry;
+            return;
+        }
+        const size_t resident_distance = probe_distance(map, resident->hash, slot);
+        if (resident_distance < distance) {
+            const hashmap_entry_t displaced = *resident;
+            *resident = entry;
+            entry = displaced;
+            distance = resident_distance;
+        }
+        slot = (slot + 1) & mask;
+        distance++;
+    }
 }
 
-// Frees the memory allocated for a bucket, including the duplicated key for safety.
-void free_bucket(bucket_t *bucket) {
-    if (bucket) {
-        free(bucket->key);
-        free(bucket);
+// Moves every entry into a table of `capacity` slots, copying the keys into a fresh arena so the
+// space of removed keys is reclaimed. Returns false, leaving the map untouched, if memory runs out.
+static bool rebuild_hashmap(hashmap_t *map, size_t capacity) {
+    hashmap_t rebuilt = {0};
+    rebuilt.capacity = capacity;
+    rebuilt.shift = 64 - log2_of(capacity);
+    rebuilt.entries = calloc(capacity, sizeof(hashmap_entry_t));
+    if (!rebuilt.entries) {
+        return false;
+    }
+
+    for (size_t i = 0; i < map->capacity; i++) {
+        hashmap_entry_t entry = map->entries[i];
+        if (entry.hash == 0) {
+            continue;
+        }
+        entry.key = store_key(&rebuilt, entry.key);
+        if (!entry.key) {
+            free(rebuilt.entries);
+            free_arena(rebuilt.arena);
+            return false;
+        }
+        place_entry(&rebuilt, entry);
+        rebuilt.size++;
     }
+
+    free(map->entries);
+    free_arena(map->arena);
+    *map = rebuilt;
+    return true;
 }
 
-// Creates a hashmap with a given initial capacity.
-// Initializes bucket pointers to NULL using calloc for safe access during insertions.
+// Finds the slot holding `key`, or returns capacity if it is absent. The search ends at an empty
+// slot or at an entry closer to its home than the key would be, since Robin Hood placement
+// would have put the key before it.
+static size_t find_slot(const hashmap_t *map, const char *key, size_t hash) {
+    const size_t mask = map->capacity - 1;
+    size_t slot = home_slot(map, hash);
+    for (size_t distance = 0;; distance++) {
+        const hashmap_entry_t *entry = &map->entries[slot];
+        if (entry->hash == 0 || probe_distance(map, entry->hash, slot) < distance) {
+            return map->capacity;
+        }
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+// Creates a hashmap sized so `initial_capacity` entries fit under the load limit.
 hashmap_t *create_hashmap(size_t initial_capacity) {
-    hashmap_t *map = malloc(sizeof(hashmap_t));
-    if (!map) return NULL;
+    hashmap_t *map = calloc(1, sizeof(hashmap_t));
+    if (!map) {
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to allocate hashmap");
+        return NULL;
+    }
 
-    map->capacity = initial_capacity;
-    map->size = 0;
-    map->buckets = calloc(initial_capacity, sizeof(bucket_t *));  // Ensures NULL pointers for each bucket.
-    if (!map->buckets) {
+    size_t capacity = HASHMAP_MIN_CAPACITY;
+    while (capacity * HASHMAP_MAX_LOAD_PERCENT / 100 < initial_capacity) {
+        capacity *= 2;
+    }
+    if (!rebuild_hashmap(map, capacity)) {
         free(map);
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to allocate hashmap slots");
         return NULL;
     }
-
     return map;
 }
 
 // Inserts a key-value pair, updating the value if the key already exists.
-// Resolves hash collisions via linked list chaining to handle multiple entries per bucket.
-void insert_hashmap(hashmap_t *map, const char *key, void *value) {
-    size_t index = hash_function(key) % map->capacity;
-
-    // Traverse linked list at bucket index to locate key if already present.
-    bucket_t *bucket = map->buckets[index];
-    while (bucket) {
-        if (strcmp(bucket->key, key) == 0) {
-            bucket->value = value;  // Update value for existing key, preserving unique keys.
-            return;
-        }
-        bucket = bucket->next;
+// The table doubles before an insertion would take it past the load limit.
+bool insert_hashmap(hashmap_t *map, const char *key, void *value) {
+    const size_t hash = entry_hash(key);
+    const size_t slot = find_slot(map, key, hash);
+    if (slot != map->capacity) {
+        map->entries[slot].value = value;  // Update value for existing key, preserving unique keys.
+        return true;
     }
 
-    // Key not found; create and insert a new bucket at the head of the list to optimize insertion.
-    bucket = create_bucket(key, value);
-    if (!bucket) return;  // Handle memory allocation failure gracefully.
+    if ((map->size + 1) * 100 > map->capacity * HASHMAP_MAX_LOAD_PERCENT &&
+        !rebuild_hashmap(map, map->capacity * 2)) {
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to grow hashmap");
+        return false;
+    }
 
-    bucket->next = map->buckets[index];
-    map->buckets[index] = bucket;
-    map->size++;  // Reflect new entry in the hashmap size.
+    hashmap_entry_t entry;
+    entry.hash = hash;
+    entry.value = value;
+    entry.key = store_key(map, key);
+    if (!entry.key) {
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to copy hashmap key");
+        return false;
+    }
+    place_entry(map, entry);
+    map->size++;
+    return true;
 }
 
 // Retrieves the value associated with a key, or NULL if not found.
-// Uses chaining to search within the bucket, necessary for hash collision handling.
-void *get_hashmap(hashmap_t *map, const char *key) {
-    size_t index = hash_function(key) % map->capacity;
-
-    // Traverse linked list at the index to locate the key.
-    bucket_t *bucket = map->buckets[index];
-    while (bucket) {
-        if (strcmp(bucket->key, key) == 0) {
-            return bucket->value;  // Return associated value if key matches.
+void *get_hashmap(const hashmap_t *map, const char *key) {
+    const size_t slot = find_slot(map, key, entry_hash(key));
+    return slot == map->capacity ? NULL : map->entries[slot].value;
+}
+
+// Removes a key with backward-shift deletion: the entries after it move back one slot until one
+// is found at its home, so no tombstones are left to lengthen later probes. Once removed keys
+// account for most of the arena, the table is rebuilt to reclaim their space.
+bool remove_hashmap(hashmap_t *map, const char *key) {
+    size_t slot = find_slot(map, key, entry_hash(key));
+    if (slot == map->capacity) {
+        return false;
+    }
+
+    const size_t length = strlen(map->entries[slot].key) + 1;
+    map->arena_live -= length;
+    map->arena_dead += length;
+
+    const size_t mask = map->capacity - 1;
+    for (;;) {
+        const size_t next = (slot + 1) & mask;
+        const hashmap_entry_t *following = &map->entries[next];
+        if (following->hash == 0 || probe_distance(map, following->hash, next) == 0) {
+            break;
         }
-        bucket = bucket->next;
+        map->entries[slot] = *following;
+        slot = next;
     }
+    map->entries[slot].hash = 0;
+    map->entries[slot].key = NULL;
+    map->entries[slot].value = NULL;
+    map->size--;
 
-    return NULL;  // Key not found in the hashmap.
+    if (map->arena_dead > HASHMAP_ARENA_BLOCK_SIZE && map->arena_dead > map->arena_live) {
+        rebuild_hashmap(map, map->capacity);  // On failure the space is simply reclaimed later.
+    }
+    return true;
 }
 
-// Frees all resources used by the hashmap, including each bucket chain and the map structure itself.
+// Frees the slots, every arena block and the map itself.
 void free_hashmap(hashmap_t *map) {
     if (map) {
-        // Free each bucket chain to release all key-value pairs.
-        for (size_t i = 0; i < map->capacity; i++) {
-            bucket_t *bucket = map->buckets[i];
-            while (bucket) {
-                bucket_t *next = bucket->next;
-                free_bucket(bucket);
-                bucket = next;
-            }
-        }
-
-        free(map->buckets);  // Release the array of bucket pointers.
-        free(map);           // Release the hashmap structure itself.
+        free(map->entries);
+        free_arena(map->arena);
+        free(map);
     }
-}
\ No newline at end of file
+}
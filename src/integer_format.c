@@ -0,0 +1,149 @@
+#include <string.h>
+#include "../include/integer_format.h"
+
+const char lower_digits[16] = "0123456789abcdef";
+const char upper_digits[16] = "0123456789ABCDEF";
+
+// Every two-digit decimal pair, so the decimal kernels emit two digits per division
+// instead of one. The pair for n lives at offset 2 * n.
+static const char decimal_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Counts digits four at a time, so even 64-bit values need at most five rounds of comparisons.
+size_t decimal_length_u64(uint64_t value) {
+    size_t length = 1;
+    for (;;) {
+        if (value < 10) return length;
+        if (value < 100) return length + 1;
+        if (value < 1000) return length + 2;
+        if (value < 10000) return length + 3;
+        value /= 10000;
+        length += 4;
+    }
+}
+
+// 32-bit counterpart of decimal_length_u64, kept separate so narrow values avoid 64-bit divides.
+size_t decimal_length_u32(uint32_t value) {
+    size_t length = 1;
+    for (;;) {
+        if (value < 10) return length;
+        if (value < 100) return length + 1;
+        if (value < 1000) return length + 2;
+        if (value < 10000) return length + 3;
+        value /= 10000;
+        length += 4;
+    }
+}
+
+// Bit width by binary search over halves, avoiding a per-bit loop.
+static unsigned bit_width_u64(uint64_t value) {
+    unsigned width = 0;
+    if (value >> 32) { width += 32; value >>= 32; }
+    if (value >> 16) { width += 16; value >>= 16; }
+    if (value >> 8) { width += 8; value >>= 8; }
+    if (value >> 4) { width += 4; value >>= 4; }
+    if (value >> 2) { width += 2; value >>= 2; }
+    if (value >> 1) { width += 1; value >>= 1; }
+    return width + (unsigned)value;
+}
+
+// Digits in base 2^shift follow directly from the bit width.
+size_t pow2_length_u64(uint64_t value, unsigned shift) {
+    const unsigned width = bit_width_u64(value);
+    return width == 0 ? 1 : (width + shift - 1) / shift;
+}
+
+// Emits two digits per step from the pair table, filling the slot from its end
+// so no reversal pass is needed. A slot longer than the value comes out zero-padded.
+void write_decimal_u32(char *out, uint32_t value, size_t length) {
+    char *end = out + length;
+    while (end - out >= 2) {
+        const uint32_t pair = value % 100;
+        value /= 100;
+        end -= 2;
+        memcpy(end, decimal_pairs + pair * 2, 2);
+    }
+    if (end > out) {
+        *--end = (char)('0' + value % 10);
+    }
+}
+
+// Peels eight digits at a time off values wider than 32 bits so each 64-bit division
+// produces eight digits, then finishes with the cheaper 32-bit kernel.
+void write_decimal_u64(char *out, uint64_t value, size_t length) {
+    char *end = out + length;
+    while (value > UINT32_MAX && end - out >= 8) {
+        const uint32_t low = (uint32_t)(value % 100000000);
+        value /= 100000000;
+        end -= 8;
+        write_decimal_u32(end, low, 8);
+    }
+    write_decimal_u32(out, (uint32_t)value, (size_t)(end - out));
+}
+
+// Power-of-two bases need no division: each digit is a mask of the low bits, then a shift.
+void write_pow2_u64(char *out, uint64_t value, size_t length, unsigned shift, const char *digits) {
+    const uint64_t mask = (UINT64_C(1) << shift) - 1;
+    char *end = out + length;
+    while (end > out) {
+        *--end = digits[value & mask];
+        value >>= shift;
+    }
+}
+
+size_t format_u32(uint32_t value, char *out) {
+    const size_t length = decimal_length_u32(value);
+    write_decimal_u32(out, value, length);
+    return length;
+}
+
+size_t format_u64(uint64_t value, char *out) {
+    const size_t length = decimal_length_u64(value);
+    write_decimal_u64(out, value, length);
+    return length;
+}
+
+// Negates through unsigned arithmetic, so INT32_MIN converts without overflow.
+size_t format_i32(int32_t value, char *out) {
+    if (value < 0) {
+        *out = '-';
+        return format_u32(0u - (uint32_t)value, out + 1) + 1;
+    }
+    return format_u32((uint32_t)value, out);
+}
+
+// Negates through unsigned arithmetic, so INT64_MIN converts without overflow.
+size_t format_i64(int64_t value, char *out) {
+    if (value < 0) {
+        *out = '-';
+        return format_u64(0u - (uint64_t)value, out + 1) + 1;
+    }
+    return format_u64((uint64_t)value, out);
+}
+
+size_t format_hex_u64(uint64_t value, char *out, bool uppercase) {
+    const size_t length = pow2_length_u64(value, 4);
+    write_pow2_u64(out, value, length, 4, uppercase ? upper_digits : lower_digits);
+    return length;
+}
+
+size_t format_oct_u64(uint64_t value, char *out) {
+    const size_t length = pow2_length_u64(value, 3);
+    write_pow2_u64(out, value, length, 3, lower_digits);
+    return length;
+}
+
+size_t format_bin_u64(uint64_t value, char *out) {
+    const size_t length = pow2_length_u64(value, 1);
+    write_pow2_u64(out, value, length, 1, lower_digits);
+    return length;
+}
@@ -1,6 +1,7 @@
 #include "../include/vfprintf.h"
 #include "../include/printf.h"
 #include "../include/format_parser.h"
+#include "../include/compiled_format.h"
 
 // Wrapper for my_vfprintf that provides printf-like behavior.
 // By handling a variable argument list, my_printf imitates the functionality of printf
@@ -19,6 +20,29 @@ int my_printf(const char *format, ...) {
     return result;
 }
 
+// Wrapper for my_vsnprintf that provides snprintf-like behavior.
+// Output lands directly in `str`, truncated to `size` bytes, and the untruncated length is returned.
+int my_snprintf(char *str, size_t size, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    int result = my_vsnprintf(str, size, format, args);
+
+    va_end(args);
+    return result;
+}
+
+// Wrapper for my_vdprintf that provides dprintf-like behavior for raw file descriptors.
+int my_dprintf(int fd, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    int result = my_vdprintf(fd, format, args);
+
+    va_end(args);
+    return result;
+}
+
 // Initializes resources required for custom printf, including format specifiers.
 // This function centralizes setup, allowing control over all supported specifiers.
 // Custom printf implementations often need such initialization to ensure all
@@ -31,5 +55,6 @@ void initialize_printf() {
 // Essential for preventing memory leaks, especially in persistent or embedded systems
 // where memory management is critical. Mimics standard library conventions where cleanup is handled implicitly.
 void cleanup_printf() {
+    clear_compiled_format_cache();
     cleanup_format_specifiers();
 }
\ No newline at end of file
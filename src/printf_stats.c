@@ -0,0 +1,212 @@
+#include <string.h>
+#include "../include/printf_stats.h"
+
+#ifdef PRINTF_STATS
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "../include/error_handling.h"
+
+// One thread's counters. Only the owning thread writes them, with a relaxed load and store
+// rather than an atomic read-modify-write, so counting costs a plain add; the atomics only
+// make the concurrent reads in printf_stats_get well defined.
+typedef struct thread_stats {
+    _Atomic uint64_t calls[PRINTF_ENTRY_COUNT];
+    _Atomic uint64_t bytes_emitted;
+    _Atomic uint64_t buffer_expansions;
+    _Atomic uint64_t invalid_specifiers;
+    _Atomic uint64_t specifier_calls[256];
+    _Atomic uint64_t specifier_cycles[256];
+    struct thread_stats *next;
+    struct thread_stats *prev;
+} thread_stats_t;
+
+static _Thread_local thread_stats_t *current_stats = NULL;
+
+// Live threads' counters, plus the totals of exited threads and the snapshot taken at the last
+// reset. Reset never writes another thread's counters; it moves the baseline instead.
+static mtx_t stats_lock;
+static tss_t stats_key;
+static once_flag stats_once = ONCE_FLAG_INIT;
+static thread_stats_t *live_stats = NULL;
+static printf_stats_t retired_stats;
+static printf_stats_t baseline_stats;
+static atomic_bool timing_enabled;
+
+static void add_thread_totals(printf_stats_t *totals, thread_stats_t *stats) {
+    for (size_t i = 0; i < PRINTF_ENTRY_COUNT; i++) {
+        totals->calls[i] += atomic_load_explicit(&stats->calls[i], memory_order_relaxed);
+    }
+    totals->bytes_emitted += atomic_load_explicit(&stats->bytes_emitted, memory_order_relaxed);
+    totals->buffer_expansions += atomic_load_explicit(&stats->buffer_expansions, memory_order_relaxed);
+    totals->invalid_specifiers += atomic_load_explicit(&stats->invalid_specifiers, memory_order_relaxed);
+    for (size_t i = 0; i < 256; i++) {
+        totals->specifier_calls[i] += atomic_load_explicit(&stats->specifier_calls[i], memory_order_relaxed);
+        totals->specifier_cycles[i] += atomic_load_explicit(&stats->specifier_cycles[i], memory_order_relaxed);
+    }
+}
+
+// Runs at thread exit: folds the thread's counters into the retired totals so they outlive it.
+static void retire_thread_stats(void *data) {
+    thread_stats_t *stats = data;
+    mtx_lock(&stats_lock);
+    add_thread_totals(&retired_stats, stats);
+    if (stats->prev) {
+        stats->prev->next = stats->next;
+    } else {
+        live_stats = stats->next;
+    }
+    if (stats->next) {
+        stats->next->prev = stats->prev;
+    }
+    mtx_unlock(&stats_lock);
+    free(stats);
+}
+
+static void initialize_stats(void) {
+    if (mtx_init(&stats_lock, mtx_plain) != thrd_success ||
+        tss_create(&stats_key, retire_thread_stats) != thrd_success) {
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to initialize printf statistics");
+    }
+}
+
+// Returns the calling thread's counters, registering them on first use. NULL if allocation fails,
+// in which case the event is simply not counted.
+static thread_stats_t *thread_stats(void) {
+    if (current_stats) {
+        return current_stats;
+    }
+    call_once(&stats_once, initialize_stats);
+    thread_stats_t *stats = calloc(1, sizeof(thread_stats_t));
+    if (!stats) {
+        return NULL;
+    }
+    mtx_lock(&stats_lock);
+    stats->next = live_stats;
+    if (live_stats) {
+        live_stats->prev = stats;
+    }
+    live_stats = stats;
+    mtx_unlock(&stats_lock);
+    tss_set(stats_key, stats);
+    current_stats = stats;
+    return stats;
+}
+
+static inline void bump(_Atomic uint64_t *counter, uint64_t amount) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + amount,
+                          memory_order_relaxed);
+}
+
+static uint64_t read_cycle_counter(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    // No portable cycle counter: fall back to nanoseconds.
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+void printf_stats_record_call(printf_entry_point_t entry, size_t bytes) {
+    thread_stats_t *stats = thread_stats();
+    if (stats) {
+        bump(&stats->calls[entry], 1);
+        bump(&stats->bytes_emitted, bytes);
+    }
+}
+
+void printf_stats_record_bytes(size_t bytes) {
+    thread_stats_t *stats = thread_stats();
+    if (stats) {
+        bump(&stats->bytes_emitted, bytes);
+    }
+}
+
+void printf_stats_record_expansion(void) {
+    thread_stats_t *stats = thread_stats();
+    if (stats) {
+        bump(&stats->buffer_expansions, 1);
+    }
+}
+
+void printf_stats_record_invalid(size_t count) {
+    thread_stats_t *stats = thread_stats();
+    if (stats) {
+        bump(&stats->invalid_specifiers, count);
+    }
+}
+
+// Returns 0 when timing is off, which printf_stats_record_specifier takes as "count only".
+uint64_t printf_stats_timer_start(void) {
+    return atomic_load_explicit(&timing_enabled, memory_order_relaxed) ? read_cycle_counter() : 0;
+}
+
+void printf_stats_record_specifier(unsigned char specifier, uint64_t start) {
+    thread_stats_t *stats = thread_stats();
+    if (stats) {
+        bump(&stats->specifier_calls[specifier], 1);
+        if (start) {
+            bump(&stats->specifier_cycles[specifier], read_cycle_counter() - start);
+        }
+    }
+}
+
+// Sums every counter ever recorded, before the baseline is taken off. Called with the lock held.
+static void collect_totals(printf_stats_t *totals) {
+    *totals = retired_stats;
+    for (thread_stats_t *stats = live_stats; stats; stats = stats->next) {
+        add_thread_totals(totals, stats);
+    }
+}
+
+void printf_stats_get(printf_stats_t *stats) {
+    call_once(&stats_once, initialize_stats);
+    mtx_lock(&stats_lock);
+    collect_totals(stats);
+    for (size_t i = 0; i < PRINTF_ENTRY_COUNT; i++) {
+        stats->calls[i] -= baseline_stats.calls[i];
+    }
+    stats->bytes_emitted -= baseline_stats.bytes_emitted;
+    stats->buffer_expansions -= baseline_stats.buffer_expansions;
+    stats->invalid_specifiers -= baseline_stats.invalid_specifiers;
+    for (size_t i = 0; i < 256; i++) {
+        stats->specifier_calls[i] -= baseline_stats.specifier_calls[i];
+        stats->specifier_cycles[i] -= baseline_stats.specifier_cycles[i];
+    }
+    mtx_unlock(&stats_lock);
+    stats->enabled = true;
+}
+
+void printf_stats_reset(void) {
+    call_once(&stats_once, initialize_stats);
+    mtx_lock(&stats_lock);
+    collect_totals(&baseline_stats);
+    mtx_unlock(&stats_lock);
+}
+
+void printf_stats_set_timing(bool enabled) {
+    atomic_store_explicit(&timing_enabled, enabled, memory_order_relaxed);
+}
+
+#else
+
+// Statistics are compiled out: the API stays available and reports nothing.
+void printf_stats_get(printf_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void printf_stats_reset(void) {
+}
+
+void printf_stats_set_timing(bool enabled) {
+    (void)enabled;
+}
+
+#endif
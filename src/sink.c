@@ -0,0 +1,314 @@
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+#include "../include/sink.h"
+#include "../include/buffer.h"
+#include "../include/vfprintf.h"
+#include "../include/printf_stats.h"
+#include "../include/error_handling.h"
+
+struct output_sink {
+    mtx_t lock;               // Serializes appends and flushes from every thread using the sink.
+    cnd_t pending_cond;       // Wakes the latency flusher when output arrives or the sink closes.
+    buffer_t *buffer;         // Output accumulated since the last flush.
+    int fd;                   // Target descriptor (the stream's descriptor for stream sinks).
+    FILE *stream;             // Target stream, or NULL for descriptor sinks.
+    size_t flush_bytes;       // Resolved byte threshold.
+    sink_policy_t policy;
+    struct timespec oldest;   // Arrival time of the oldest pending byte.
+    bool closing;             // Set by destroy_sink to stop the flusher.
+    bool has_flusher;         // A latency flusher thread is running.
+    thrd_t flusher;
+    size_t slot;              // Index in registered_sinks, or SINK_MAX_REGISTERED if untracked.
+};
+
+// Sinks flushed at exit and on fatal signals. Plain atomic slots rather than a locked list,
+// because the crash path runs in a signal handler and must not take locks.
+static _Atomic(output_sink_t *) registered_sinks[SINK_MAX_REGISTERED];
+static once_flag sink_exit_once = ONCE_FLAG_INIT;
+
+// Writes the pending bytes to the sink's target. Called with the lock held.
+static int flush_locked(output_sink_t *sink) {
+    if (sink->buffer->used == 0) {
+        return 0;
+    }
+    if (sink->stream) {
+        flush_buffer(sink->buffer, sink->stream);
+        return fflush(sink->stream) == 0 ? 0 : -1;
+    }
+    return write_buffer_to_fd(sink->buffer, sink->fd);
+}
+
+// Flushes every registered sink on normal exit, so buffered output is not lost when the
+// program returns from main or calls exit() without destroying its sinks.
+static void flush_registered_sinks(void) {
+    for (size_t i = 0; i < SINK_MAX_REGISTERED; i++) {
+        output_sink_t *sink = atomic_load_explicit(&registered_sinks[i], memory_order_acquire);
+        if (sink) {
+            sink_flush(sink);
+        }
+    }
+}
+
+static void register_sink_exit_handler(void) {
+    atexit(flush_registered_sinks);
+}
+
+// Writes out pending output without locks or stdio, both unsafe inside a signal handler, then
+// lets the signal's default action (usually a core dump) proceed. The handler was installed with
+// SA_RESETHAND, so re-raising the signal reaches the default action.
+static void flush_sinks_on_fatal_signal(int signal_number) {
+    const int saved_errno = errno;
+    for (size_t i = 0; i < SINK_MAX_REGISTERED; i++) {
+        output_sink_t *sink = atomic_load_explicit(&registered_sinks[i], memory_order_acquire);
+        if (sink && sink->buffer->used > 0) {
+            write_buffer_to_fd(sink->buffer, sink->fd);
+        }
+    }
+    errno = saved_errno;
+    raise(signal_number);
+}
+
+// Adds `milliseconds` to a TIME_UTC timestamp.
+static struct timespec add_milliseconds(struct timespec time, unsigned milliseconds) {
+    time.tv_sec += milliseconds / 1000;
+    time.tv_nsec += (long)(milliseconds % 1000) * 1000000L;
+    if (time.tv_nsec >= 1000000000L) {
+        time.tv_sec++;
+        time.tv_nsec -= 1000000000L;
+    }
+    return time;
+}
+
+static bool time_reached(const struct timespec *now, const struct timespec *deadline) {
+    return now->tv_sec > deadline->tv_sec ||
+           (now->tv_sec == deadline->tv_sec && now->tv_nsec >= deadline->tv_nsec);
+}
+
+// Enforces the latency bound: sleeps until the oldest pending byte's deadline and flushes then,
+// so a quiet period never leaves output stranded in the buffer.
+static int run_latency_flusher(void *arg) {
+    output_sink_t *sink = arg;
+    mtx_lock(&sink->lock);
+    while (!sink->closing) {
+        if (sink->buffer->used == 0) {
+            cnd_wait(&sink->pending_cond, &sink->lock);
+            continue;
+        }
+
+        const struct timespec deadline = add_milliseconds(sink->oldest, sink->policy.max_latency_ms);
+        struct timespec now;
+        timespec_get(&now, TIME_UTC);
+        if (time_reached(&now, &deadline)) {
+            flush_locked(sink);
+            continue;
+        }
+        cnd_timedwait(&sink->pending_cond, &sink->lock, &deadline);
+    }
+    mtx_unlock(&sink->lock);
+    return 0;
+}
+
+// Shared constructor: resolves the policy, starts the latency flusher when one is configured,
+// and registers the sink for the exit and crash flushes.
+static output_sink_t *create_sink(int fd, FILE *stream, const sink_policy_t *policy) {
+    output_sink_t *sink = calloc(1, sizeof(output_sink_t));
+    if (!sink) {
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to allocate output sink");
+        return NULL;
+    }
+
+    if (policy) {
+        sink->policy = *policy;
+    }
+    sink->flush_bytes = sink->policy.flush_bytes ? sink->policy.flush_bytes : SINK_DEFAULT_FLUSH_BYTES;
+    sink->fd = fd;
+    sink->stream = stream;
+    sink->slot = SINK_MAX_REGISTERED;
+
+    // The threshold bounds how much accumulates, so it is a good first size; huge thresholds
+    // start at the default instead and grow only if actually used.
+    sink->buffer = init_buffer(sink->flush_bytes < SINK_DEFAULT_FLUSH_BYTES ? sink->flush_bytes
+                                                                             : SINK_DEFAULT_FLUSH_BYTES);
+    if (!sink->buffer) {
+        free(sink);
+        return NULL;
+    }
+    if (mtx_init(&sink->lock, mtx_plain) != thrd_success) {
+        free_buffer(sink->buffer);
+        free(sink);
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to create output sink lock");
+        return NULL;
+    }
+    if (cnd_init(&sink->pending_cond) != thrd_success) {
+        mtx_destroy(&sink->lock);
+        free_buffer(sink->buffer);
+        free(sink);
+        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to create output sink condition");
+        return NULL;
+    }
+
+    if (sink->policy.max_latency_ms > 0) {
+        sink->has_flusher = thrd_create(&sink->flusher, run_latency_flusher, sink) == thrd_success;
+    }
+
+    call_once(&sink_exit_once, register_sink_exit_handler);
+    for (size_t i = 0; i < SINK_MAX_REGISTERED; i++) {
+        output_sink_t *expected = NULL;
+        if (atomic_compare_exchange_strong_explicit(&registered_sinks[i], &expected, sink,
+                                                    memory_order_acq_rel, memory_order_relaxed)) {
+            sink->slot = i;
+            break;
+        }
+    }
+    return sink;
+}
+
+output_sink_t *create_fd_sink(int fd, const sink_policy_t *policy) {
+    return create_sink(fd, NULL, policy);
+}
+
+output_sink_t *create_stream_sink(FILE *stream, const sink_policy_t *policy) {
+    return create_sink(fileno(stream), stream, policy);
+}
+
+// Writes `length` bytes straight to the target after the pending ones. Called with the lock held.
+static int write_through_locked(output_sink_t *sink, const char *data, size_t length) {
+    if (flush_locked(sink) != 0) {
+        return -1;
+    }
+    if (sink->stream) {
+        if (fwrite(data, 1, length, sink->stream) != length) {
+            return -1;
+        }
+        return fflush(sink->stream) == 0 ? 0 : -1;
+    }
+    return write_to_fd(sink->fd, data, length);
+}
+
+// Appends already formatted bytes under the lock and applies the flush policy. Many messages
+// share one write, so the syscall count follows the flush policy rather than the message rate.
+// Data at least as long as the flush threshold would be flushed at once anyway, so it is written
+// through without being copied into the sink's buffer.
+int sink_write(output_sink_t *sink, const char *data, size_t length) {
+    mtx_lock(&sink->lock);
+    if (length >= sink->flush_bytes) {
+        const int result = write_through_locked(sink, data, length);
+        mtx_unlock(&sink->lock);
+        return result;
+    }
+    if (sink->buffer->used == 0 && length > 0) {
+        timespec_get(&sink->oldest, TIME_UTC);
+        if (sink->has_flusher) {
+            cnd_signal(&sink->pending_cond);
+        }
+    }
+    append_to_buffer(sink->buffer, data, length);
+
+    int result = 0;
+    if (sink->buffer->used >= sink->flush_bytes ||
+        (sink->policy.flush_on_newline && memchr(data, '\n', length) != NULL)) {
+        result = flush_locked(sink);
+    }
+    mtx_unlock(&sink->lock);
+    return result;
+}
+
+// Flush callback of sink_vprintf's streaming buffer.
+static int write_to_sink(void *context, const char *data, size_t length) {
+    return sink_write(context, data, length);
+}
+
+// Formats in the calling thread's buffer without holding the sink's lock, so only the append
+// and any triggered flush are serialized. A message past the thread buffer high-water mark is
+// streamed into the sink in pieces, which other threads' messages may then fall between.
+int sink_vprintf(output_sink_t *sink, const char *format, va_list args) {
+    char stack_storage[STACK_BUFFER_SIZE];
+    buffer_t stack_buffer;
+    buffer_t *message = acquire_thread_buffer();
+    if (!message) {
+        init_buffer_with_storage(&stack_buffer, stack_storage, sizeof(stack_storage));
+        message = &stack_buffer;
+    }
+
+    buffer_stream_t streaming;
+    init_buffer_stream(&streaming, write_to_sink, sink, get_thread_buffer_high_water());
+    message->stream = &streaming;
+
+    format_to_buffer(format, args, message);
+    const int result = finish_buffer_stream(message);
+    const size_t length = streaming.flushed;
+    PRINTF_STATS_CALL(PRINTF_ENTRY_SINK, length);
+
+    if (message == &stack_buffer) {
+        release_buffer_storage(message);
+    } else {
+        release_thread_buffer(message);
+    }
+
+    if (result < 0) {
+        return -1;
+    }
+    if (length > INT_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    return (int)length;
+}
+
+int sink_printf(output_sink_t *sink, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = sink_vprintf(sink, format, args);
+    va_end(args);
+    return result;
+}
+
+int sink_flush(output_sink_t *sink) {
+    mtx_lock(&sink->lock);
+    const int result = flush_locked(sink);
+    mtx_unlock(&sink->lock);
+    return result;
+}
+
+// Unregisters the sink first so the exit and crash paths never see it half torn down,
+// then stops the flusher and writes out whatever is left.
+void destroy_sink(output_sink_t *sink) {
+    if (!sink) {
+        return;
+    }
+    if (sink->slot < SINK_MAX_REGISTERED) {
+        atomic_store_explicit(&registered_sinks[sink->slot], NULL, memory_order_release);
+    }
+
+    if (sink->has_flusher) {
+        mtx_lock(&sink->lock);
+        sink->closing = true;
+        cnd_signal(&sink->pending_cond);
+        mtx_unlock(&sink->lock);
+        thrd_join(sink->flusher, NULL);
+    }
+
+    flush_locked(sink);
+    cnd_destroy(&sink->pending_cond);
+    mtx_destroy(&sink->lock);
+    free_buffer(sink->buffer);
+    free(sink);
+}
+
+void install_sink_crash_handler(void) {
+    static const int fatal_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = flush_sinks_on_fatal_signal;
+    action.sa_flags = SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    for (size_t i = 0; i < sizeof(fatal_signals) / sizeof(fatal_signals[0]); i++) {
+        sigaction(fatal_signals[i], &action, NULL);
+    }
+}
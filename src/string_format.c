@@ -0,0 +1,437 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "../include/string_format.h"
+#include "../include/integer_format.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Bytes reserved at a time for a burst of consecutive escapes; fits a fixed buffer's spill area.
+#define ESCAPE_BURST_SIZE 64
+
+// Input bytes converted per reservation by append_hex, sized so the output (64 digits, or 48
+// with separators for half as many bytes) fits a fixed buffer's spill area.
+#define HEX_CHUNK_BYTES 32
+#define HEX_BLOCK_BYTES 16
+
+// Bytes transformed per reservation when the whole output cannot be reserved at once (a fixed
+// buffer that is nearly full); fits the spill area.
+#define TRANSFORM_CHUNK_BYTES 64
+
+typedef enum {
+    ESCAPE_JSON,  // %J: quote, backslash and control bytes.
+    ESCAPE_C,     // %q: quote, backslash and everything outside printable ASCII.
+} escape_style_t;
+
+static inline bool needs_escape(escape_style_t style, unsigned char c) {
+    if (c == '"' || c == '\\') {
+        return true;
+    }
+    return style == ESCAPE_JSON ? c < 0x20 : (c < 0x20 || c >= 0x7f);
+}
+
+#if defined(__SSE2__)
+// Marks the bytes of one 16-byte block that need escaping.
+static inline __m128i special_bytes_16(escape_style_t style, __m128i bytes) {
+    const __m128i quotes = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')),
+                                        _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\')));
+    if (style == ESCAPE_JSON) {
+        // Unsigned byte <= 0x1f exactly when min(byte, 0x1f) is the byte itself.
+        return _mm_or_si128(quotes, _mm_cmpeq_epi8(_mm_min_epu8(bytes, _mm_set1_epi8(0x1f)), bytes));
+    }
+    // As signed bytes, everything below ' ' is a control byte or a byte >= 0x80.
+    return _mm_or_si128(quotes, _mm_or_si128(_mm_cmplt_epi8(bytes, _mm_set1_epi8(' ')),
+                                             _mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x7f))));
+}
+#endif
+
+#if defined(__AVX2__)
+static inline __m256i special_bytes_32(escape_style_t style, __m256i bytes) {
+    const __m256i quotes = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')),
+                                           _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\')));
+    if (style == ESCAPE_JSON) {
+        return _mm256_or_si256(quotes,
+                               _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, _mm256_set1_epi8(0x1f)), bytes));
+    }
+    return _mm256_or_si256(quotes, _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(' '), bytes),
+                                                   _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(0x7f))));
+}
+#endif
+
+// Length of the run of bytes at the start of `text` that need no escaping. Whole blocks are
+// classified with vector compares and the first special byte found from the movemask, so clean
+// text costs a few instructions per 16 or 32 bytes; the scalar loop only sees the tail.
+static inline size_t clean_run_length(escape_style_t style, const unsigned char *text, size_t length) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= length; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256((const __m256i *)(text + i));
+        const uint32_t mask = (uint32_t)_mm256_movemask_epi8(special_bytes_32(style, bytes));
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 16 <= length; i += 16) {
+        const __m128i bytes = _mm_loadu_si128((const __m128i *)(text + i));
+        const unsigned mask = (unsigned)_mm_movemask_epi8(special_bytes_16(style, bytes));
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+#endif
+    while (i < length && !needs_escape(style, text[i])) {
+        i++;
+    }
+    return i;
+}
+
+// Writes the escape for one byte that needs it and returns its length.
+static size_t write_escape(escape_style_t style, unsigned char c, char *out) {
+    char simple = 0;
+    switch (c) {
+        case '"': simple = '"'; break;
+        case '\\': simple = '\\'; break;
+        case '\b': simple = 'b'; break;
+        case '\f': simple = 'f'; break;
+        case '\n': simple = 'n'; break;
+        case '\r': simple = 'r'; break;
+        case '\t': simple = 't'; break;
+        case '\a': simple = style == ESCAPE_C ? 'a' : 0; break;
+        case '\v': simple = style == ESCAPE_C ? 'v' : 0; break;
+        default: break;
+    }
+
+    out[0] = '\\';
+    if (simple) {
+        out[1] = simple;
+        return 2;
+    }
+    if (style == ESCAPE_JSON) {
+        out[1] = 'u';
+        out[2] = '0';
+        out[3] = '0';
+        out[4] = lower_digits[c >> 4];
+        out[5] = lower_digits[c & 0xf];
+        return 6;
+    }
+    // Octal rather than \x, whose digits would run on into a following hex-digit character.
+    out[1] = (char)('0' + (c >> 6));
+    out[2] = (char)('0' + ((c >> 3) & 7));
+    out[3] = (char)('0' + (c & 7));
+    return 4;
+}
+
+static size_t escaped_length(escape_style_t style, const char *text, size_t length) {
+    const unsigned char *bytes = (const unsigned char *)text;
+    char scratch[STRING_ESCAPE_MAX_LENGTH];
+    size_t total = 0;
+    size_t i = 0;
+    while (i < length) {
+        const size_t run = clean_run_length(style, bytes + i, length - i);
+        total += run;
+        i += run;
+        if (i < length) {
+            total += write_escape(style, bytes[i++], scratch);
+        }
+    }
+    return total;
+}
+
+// Alternates between bulk-copying a clean run and writing the escapes that end it. Escapes tend
+// to cluster, so a burst of them is written into one reservation.
+static void append_escaped(buffer_t *buffer, escape_style_t style, const char *text, size_t length) {
+    const unsigned char *bytes = (const unsigned char *)text;
+    size_t i = 0;
+    while (i < length) {
+        const size_t run = clean_run_length(style, bytes + i, length - i);
+        if (run > 0) {
+            append_to_buffer(buffer, text + i, run);
+            i += run;
+        }
+        if (i == length) {
+            break;
+        }
+
+        char *out = buffer_reserve(buffer, ESCAPE_BURST_SIZE);
+        if (!out) {
+            return;
+        }
+        size_t used = 0;
+        while (i < length && used + STRING_ESCAPE_MAX_LENGTH <= ESCAPE_BURST_SIZE && needs_escape(style, bytes[i])) {
+            used += write_escape(style, bytes[i++], out + used);
+        }
+        buffer_commit(buffer, used);
+    }
+}
+
+size_t json_escaped_length(const char *text, size_t length) {
+    return escaped_length(ESCAPE_JSON, text, length);
+}
+
+void append_json_escaped(buffer_t *buffer, const char *text, size_t length) {
+    append_escaped(buffer, ESCAPE_JSON, text, length);
+}
+
+size_t c_quoted_length(const char *text, size_t length) {
+    return escaped_length(ESCAPE_C, text, length) + 2;
+}
+
+void append_c_quoted(buffer_t *buffer, const char *text, size_t length) {
+    append_to_buffer(buffer, "\"", 1);
+    append_escaped(buffer, ESCAPE_C, text, length);
+    append_to_buffer(buffer, "\"", 1);
+}
+
+// Writes the 32 hex digits of 16 bytes.
+static inline void encode_hex_block(const unsigned char *bytes, char *out, bool uppercase) {
+#if defined(__SSE2__)
+    const __m128i input = _mm_loadu_si128((const __m128i *)bytes);
+    const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(input, 4), nibble_mask);
+    __m128i low = _mm_and_si128(input, nibble_mask);
+#if defined(__SSSE3__)
+    const __m128i digits = _mm_loadu_si128((const __m128i *)(uppercase ? upper_digits : lower_digits));
+    high = _mm_shuffle_epi8(digits, high);
+    low = _mm_shuffle_epi8(digits, low);
+#else
+    // '0' + n, plus the distance from '9' + 1 to 'a' (or 'A') where n > 9.
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i letter_offset = _mm_set1_epi8(uppercase ? 'A' - '0' - 10 : 'a' - '0' - 10);
+    high = _mm_add_epi8(_mm_add_epi8(high, zero), _mm_and_si128(_mm_cmpgt_epi8(high, nine), letter_offset));
+    low = _mm_add_epi8(_mm_add_epi8(low, zero), _mm_and_si128(_mm_cmpgt_epi8(low, nine), letter_offset));
+#endif
+    _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi8(high, low));
+    _mm_storeu_si128((__m128i *)(out + 16), _mm_unpackhi_epi8(high, low));
+#else
+    const char *digits = uppercase ? upper_digits : lower_digits;
+    for (size_t i = 0; i < HEX_BLOCK_BYTES; i++) {
+        out[2 * i] = digits[bytes[i] >> 4];
+        out[2 * i + 1] = digits[bytes[i] & 0xf];
+    }
+#endif
+}
+
+// Writes the hex digits of up to HEX_CHUNK_BYTES bytes, `stride` output bytes apart per input
+// byte (2 packed, 3 with a separator after each byte). Returns the number of bytes written.
+static size_t encode_hex_chunk(const unsigned char *bytes, size_t length, char *out, bool uppercase, size_t stride) {
+    const char *digits = uppercase ? upper_digits : lower_digits;
+    size_t i = 0;
+    if (stride == 2) {
+        for (; i + HEX_BLOCK_BYTES <= length; i += HEX_BLOCK_BYTES) {
+            encode_hex_block(bytes + i, out + 2 * i, uppercase);
+        }
+    } else {
+        char pairs[2 * HEX_BLOCK_BYTES];
+        for (; i + HEX_BLOCK_BYTES <= length; i += HEX_BLOCK_BYTES) {
+            encode_hex_block(bytes + i, pairs, uppercase);
+            for (size_t j = 0; j < HEX_BLOCK_BYTES; j++) {
+                char *pair = out + (i + j) * stride;
+                pair[0] = pairs[2 * j];
+                pair[1] = pairs[2 * j + 1];
+                pair[2] = ' ';
+            }
+        }
+    }
+    for (; i < length; i++) {
+        char *pair = out + i * stride;
+        pair[0] = digits[bytes[i] >> 4];
+        pair[1] = digits[bytes[i] & 0xf];
+        if (stride == 3) {
+            pair[2] = ' ';
+        }
+    }
+    return length * stride;
+}
+
+size_t hex_length(size_t length, bool separated) {
+    if (length == 0) {
+        return 0;
+    }
+    return separated ? 3 * length - 1 : 2 * length;
+}
+
+// Converts a chunk at a time straight into the buffer. With separators every byte is followed by
+// a space, and the one after the last byte is simply not committed.
+void append_hex(buffer_t *buffer, const void *bytes, size_t length, bool uppercase, bool separated) {
+    const unsigned char *input = bytes;
+    const size_t stride = separated ? 3 : 2;
+    const size_t chunk_bytes = separated ? HEX_CHUNK_BYTES / 2 : HEX_CHUNK_BYTES;
+    for (size_t i = 0; i < length; i += chunk_bytes) {
+        const size_t count = length - i < chunk_bytes ? length - i : chunk_bytes;
+        char *out = buffer_reserve(buffer, chunk_bytes * stride);
+        if (!out) {
+            return;
+        }
+        size_t written = encode_hex_chunk(input + i, count, out, uppercase, stride);
+        if (separated && i + count == length) {
+            written--;
+        }
+        buffer_commit(buffer, written);
+    }
+}
+
+// Hex digits of a line's offset: at least eight, as hexdump prints them.
+static size_t offset_digits(size_t offset) {
+    const size_t digits = pow2_length_u64(offset, 4);
+    return digits > 8 ? digits : 8;
+}
+
+size_t hexdump_length(size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    size_t total = offset_digits(length) + 1;  // The closing line with the total length.
+    for (size_t offset = 0; offset < length; offset += HEXDUMP_LINE_BYTES) {
+        const size_t count = length - offset < HEXDUMP_LINE_BYTES ? length - offset : HEXDUMP_LINE_BYTES;
+        total += HEXDUMP_LINE_LENGTH - 8 + offset_digits(offset) - (HEXDUMP_LINE_BYTES - count);
+    }
+    return total;
+}
+
+// Each line is assembled in a local array, its hex from one block conversion, and appended whole.
+void append_hexdump(buffer_t *buffer, const void *bytes, size_t length, bool uppercase) {
+    const unsigned char *input = bytes;
+    char line[HEXDUMP_LINE_LENGTH + INTEGER_FORMAT_MAX_LENGTH];
+    char pairs[2 * HEXDUMP_LINE_BYTES];
+    for (size_t offset = 0; offset < length; offset += HEXDUMP_LINE_BYTES) {
+        const size_t count = length - offset < HEXDUMP_LINE_BYTES ? length - offset : HEXDUMP_LINE_BYTES;
+        encode_hex_chunk(input + offset, count, pairs, uppercase, 2);
+
+        size_t used = offset_digits(offset);
+        write_pow2_u64(line, offset, used, 4, lower_digits);
+        memset(line + used, ' ', 2 + 3 * HEXDUMP_LINE_BYTES + 2);
+        for (size_t i = 0; i < count; i++) {
+            char *pair = line + used + 2 + 3 * i + (i >= HEXDUMP_LINE_BYTES / 2);
+            pair[0] = pairs[2 * i];
+            pair[1] = pairs[2 * i + 1];
+        }
+        used += 2 + 3 * HEXDUMP_LINE_BYTES + 2;
+        line[used++] = '|';
+        for (size_t i = 0; i < count; i++) {
+            const unsigned char c = input[offset + i];
+            line[used++] = c >= 0x20 && c < 0x7f ? (char)c : '.';
+        }
+        line[used++] = '|';
+        line[used++] = '\n';
+        append_to_buffer(buffer, line, used);
+    }
+
+    if (length > 0) {
+        const size_t digits = offset_digits(length);
+        write_pow2_u64(line, length, digits, 4, lower_digits);
+        line[digits] = '\n';
+        append_to_buffer(buffer, line, digits + 1);
+    }
+}
+
+// Transforms one byte; used for the bytes after the last whole vector block.
+static inline unsigned char transform_byte(string_transform_t transform, unsigned char c) {
+    const unsigned folded = (unsigned)(c | 0x20) - 'a';  // 0-25 for letters of either case.
+    switch (transform) {
+        case STRING_TRANSFORM_ROT13:
+            return folded < 26 ? (unsigned char)(folded < 13 ? c + 13 : c - 13) : c;
+        case STRING_TRANSFORM_UPPER:
+            return (unsigned)(c - 'a') < 26 ? (unsigned char)(c - 0x20) : c;
+        default:
+            return (unsigned)(c - 'A') < 26 ? (unsigned char)(c + 0x20) : c;
+    }
+}
+
+// The vector kernels test "first <= c < first + n" as one signed compare: adding 128 - first
+// moves the range to the bottom of the signed byte range, below -128 + n.
+#if defined(__SSE2__)
+static inline __m128i in_range_16(__m128i bytes, char first, int count) {
+    const __m128i shifted = _mm_add_epi8(bytes, _mm_set1_epi8((char)(128 - first)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(-128 + count)));
+}
+
+static inline __m128i transform_block_16(string_transform_t transform, __m128i bytes) {
+    switch (transform) {
+        case STRING_TRANSFORM_ROT13: {
+            const __m128i folded = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+            const __m128i letter = in_range_16(folded, 'a', 26);
+            const __m128i first_half = in_range_16(folded, 'a', 13);
+            // +13 for a-m, -13 for n-z, 0 for everything else.
+            const __m128i delta = _mm_or_si128(_mm_and_si128(first_half, _mm_set1_epi8(13)),
+                                               _mm_andnot_si128(first_half, _mm_set1_epi8(-13)));
+            return _mm_add_epi8(bytes, _mm_and_si128(letter, delta));
+        }
+        case STRING_TRANSFORM_UPPER:
+            return _mm_sub_epi8(bytes, _mm_and_si128(in_range_16(bytes, 'a', 26), _mm_set1_epi8(0x20)));
+        default:
+            return _mm_add_epi8(bytes, _mm_and_si128(in_range_16(bytes, 'A', 26), _mm_set1_epi8(0x20)));
+    }
+}
+#endif
+
+#if defined(__AVX2__)
+static inline __m256i in_range_32(__m256i bytes, char first, int count) {
+    const __m256i shifted = _mm256_add_epi8(bytes, _mm256_set1_epi8((char)(128 - first)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + count)), shifted);
+}
+
+static inline __m256i transform_block_32(string_transform_t transform, __m256i bytes) {
+    switch (transform) {
+        case STRING_TRANSFORM_ROT13: {
+            const __m256i folded = _mm256_or_si256(bytes, _mm256_set1_epi8(0x20));
+            const __m256i letter = in_range_32(folded, 'a', 26);
+            const __m256i first_half = in_range_32(folded, 'a', 13);
+            const __m256i delta = _mm256_or_si256(_mm256_and_si256(first_half, _mm256_set1_epi8(13)),
+                                                  _mm256_andnot_si256(first_half, _mm256_set1_epi8(-13)));
+            return _mm256_add_epi8(bytes, _mm256_and_si256(letter, delta));
+        }
+        case STRING_TRANSFORM_UPPER:
+            return _mm256_sub_epi8(bytes, _mm256_and_si256(in_range_32(bytes, 'a', 26), _mm256_set1_epi8(0x20)));
+        default:
+            return _mm256_add_epi8(bytes, _mm256_and_si256(in_range_32(bytes, 'A', 26), _mm256_set1_epi8(0x20)));
+    }
+}
+#endif
+
+static void transform_span(string_transform_t transform, const unsigned char *in, unsigned char *out, size_t length) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= length; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256((const __m256i *)(in + i));
+        _mm256_storeu_si256((__m256i *)(out + i), transform_block_32(transform, bytes));
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 16 <= length; i += 16) {
+        const __m128i bytes = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + i), transform_block_16(transform, bytes));
+    }
+#endif
+    for (; i < length; i++) {
+        out[i] = transform_byte(transform, in[i]);
+    }
+}
+
+void append_transformed(buffer_t *buffer, const char *text, size_t length, string_transform_t transform) {
+    const unsigned char *in = (const unsigned char *)text;
+    char *out = length > 0 ? buffer_reserve(buffer, length) : NULL;
+    if (out) {
+        transform_span(transform, in, (unsigned char *)out, length);
+        buffer_commit(buffer, length);
+        return;
+    }
+    for (size_t i = 0; i < length; i += TRANSFORM_CHUNK_BYTES) {
+        const size_t count = length - i < TRANSFORM_CHUNK_BYTES ? length - i : TRANSFORM_CHUNK_BYTES;
+        out = buffer_reserve(buffer, count);
+        if (!out) {
+            return;
+        }
+        transform_span(transform, in + i, (unsigned char *)out, count);
+        buffer_commit(buffer, count);
+    }
+}
@@ -1,6 +1,12 @@
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
 #include "../include/vfprintf.h"
+#include "../include/binary_log.h"
+#include "../include/printf_stats.h"
+#include "../include/compiled_format.h"
 #include "../include/format_parser.h"
 #include "../include/buffer.h"
 #include "../include/error_handling.h"
@@ -15,76 +21,223 @@ static bool is_escaped_percent(const char *ptr) {
 // This keeps invalid sequences visible in the output, rather than silently failing.
 static void handle_invalid_specifier(buffer_t *buffer, const char **ptr) {
     append_to_buffer(buffer, *ptr, 1);  // Append '%' to make the issue clear in output.
+    PRINTF_STATS_INVALID(1);
     (*ptr)++;  // Advance past the invalid specifier.
 }
 
+// Formats `format` by walking it directly, parsing each specifier as it is reached.
+// Used for formats the compiled format cache cannot hold, such as reused dynamic buffers.
+static void format_directly(const char *format, va_list *args, buffer_t *buffer) {
+    const char *ptr = format;  // Pointer to traverse the format string.
+    // Measured once so every literal run can be located with memchr instead of a byte-wise loop.
+    const char *end = format + strlen(format);
+
+    // Iterate through the format string, parsing and handling specifiers as they appear.
+    while (ptr < end) {
+        // Find the next '%' and copy everything before it as a single literal run.
+        // libc's memchr scans a vector register's worth of bytes per step, so mostly-literal
+        // formats cost one scan and one append per run instead of one append per character.
+        const char *next = memchr(ptr, FORMAT_SPECIFIER_START, (size_t)(end - ptr));
+        if (next == NULL) {
+            next = end;
+        }
+        if (next != ptr) {
+            append_reference_to_buffer(buffer, ptr, (size_t)(next - ptr));
+            ptr = next;
+            continue;
+        }
+
+        if (is_escaped_percent(ptr)) {
+            // Handle '%%' by appending a single '%'. In standard printf, this is
+            // a common escape sequence to print '%' without triggering formatting logic.
+            append_to_buffer(buffer, "%", 1);
+            ptr += 2;  // Move past both '%' characters.
+            continue;
+        }
+
+        // Parse the format specifier and determine its validity and handler.
+        // This step mimics printf's specifier parsing, allowing flexible handling
+        // of different data types. Custom parsers improve modularity, allowing for
+        // easy addition or modification of specifiers.
+        const format_info_t info = parse_format(ptr);
+
+        if (!info.valid) {
+            // When encountering an invalid specifier (e.g., "%z"), output the '%'
+            // to indicate an issue in the format string, but skip additional handling.
+            handle_invalid_specifier(buffer, &ptr);
+            continue;
+        }
+
+        // Call the handler associated with the format specifier. Each handler
+        // processes its respective argument type, converts it to a string, and appends it
+        // to the buffer. This design enables modularity and separates parsing from processing.
+        invoke_format_handler(&info, args, buffer);
+
+        // Move the pointer forward by the length of the parsed specifier,
+        // ready to process the next portion of the format string.
+        ptr += info.length;
+    }
+}
+
+// Formats into `buffer` using the shared pipeline of every entry point.
+// Replays the cached op list when this format has been seen before; parsing and handler
+// lookups then happen once per format string rather than once per call.
+// Handlers consume arguments through a pointer to a local copy of the caller's list, since
+// a va_list parameter may itself be an array type whose address cannot be passed on portably.
+void format_to_buffer(const char *format, va_list args, buffer_t *buffer) {
+    va_list ap;
+    va_copy(ap, args);
+
+    const compiled_format_t *compiled = get_compiled_format(format);
+    if (compiled) {
+        render_compiled_format(compiled, &ap, buffer);
+    } else if (strchr(format, FORMAT_POSITION_END) != NULL) {
+        // Positional arguments are all gathered before the first conversion runs, which needs
+        // the compiled slot classes, so an uncacheable format with a '$' is compiled for this call.
+        // Its literals live in that temporary copy, so they are copied rather than referenced.
+        compiled_format_t *owned = compile_format(format);
+        if (owned) {
+            buffer->flags |= BUFFER_FLAG_COPY_REFERENCES;
+            render_compiled_format(owned, &ap, buffer);
+            buffer->flags &= ~BUFFER_FLAG_COPY_REFERENCES;
+            free_compiled_format(owned);
+        }
+    } else {
+        format_directly(format, &ap, buffer);
+    }
+    va_end(ap);
+}
+
+// Flush callback of my_vfprintf's streaming buffer.
+static int write_to_file(void *context, const char *data, size_t length) {
+    return fwrite(data, 1, length, context) == length ? 0 : -1;
+}
+
 // Custom implementation of vfprintf to handle formatted output to a stream.
 // Inspired by standard printf's logic: parsing the format string, identifying format specifiers,
 // and calling appropriate handlers to build the output.
 // Unlike printf, this version isolates buffer management to handle larger outputs and improve flexibility.
 int my_vfprintf(FILE *stream, const char *format, va_list args) {
-    // Initialize the output buffer with an initial size; enables efficient
-    // appending without repeated reallocations. Custom printf often uses buffers to manage
-    // formatted data before writing, optimizing for both speed and memory.
-    buffer_t *buffer = init_buffer(1024);
+    // Streams in binary mode get a compact record of the raw arguments instead of text.
+    binary_log_t *binary_log = find_binary_log(stream);
+    if (binary_log) {
+        const int written = write_binary_record(binary_log, format, args);
+        PRINTF_STATS_CALL(PRINTF_ENTRY_VFPRINTF, written < 0 ? 0 : (size_t)written);
+        return written;
+    }
+
+    // Format into this thread's reusable buffer so steady-state calls make no heap allocations.
+    // A re-entrant call (a handler printing while the thread's buffer is busy) gets a small
+    // on-stack buffer instead, which only moves to the heap if the message outgrows it.
+    char stack_storage[STACK_BUFFER_SIZE];
+    buffer_t stack_buffer;
+    buffer_t *buffer = acquire_thread_buffer();
     if (!buffer) {
-        handle_error(MEMORY_ALLOCATION_ERROR, "Failed to initialize buffer");
+        init_buffer_with_storage(&stack_buffer, stack_storage, sizeof(stack_storage));
+        buffer = &stack_buffer;
+    }
+
+    // The message streams to `stream`: one that fits under the high-water mark is still written
+    // with a single fwrite at the end, while a larger one goes out in pieces as the buffer fills,
+    // so a huge argument never grows the buffer past that mark.
+    buffer_stream_t streaming;
+    init_buffer_stream(&streaming, write_to_file, stream, get_thread_buffer_high_water());
+    buffer->stream = &streaming;
+
+    format_to_buffer(format, args, buffer);
+
+    const int result = finish_buffer_stream(buffer);
+    const size_t total = streaming.flushed;
+    PRINTF_STATS_CALL(PRINTF_ENTRY_VFPRINTF, total);
+
+    // Hand the buffer back for the next call, or free whatever the stack buffer grew into.
+    if (buffer == &stack_buffer) {
+        release_buffer_storage(buffer);
+    } else {
+        release_thread_buffer(buffer);
+    }
+
+    if (result < 0) {
         return -1;
     }
+    if (total > INT_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    return (int)total;
+}
 
-    const char *ptr = format;  // Pointer to traverse the format string.
-    int total_written = 0;
+// Formats into a caller-provided array with C99 snprintf semantics.
+// The array itself backs a fixed buffer, so output is written in place with no intermediate
+// copy or allocation, and truncated bytes are only counted to produce the would-be length.
+int my_vsnprintf(char *str, size_t size, const char *format, va_list args) {
+    // Keep the last byte for the terminator; a zero size means "measure only".
+    buffer_t buffer;
+    init_fixed_buffer(&buffer, str, size > 0 ? size - 1 : 0);
 
-    // Iterate through the format string, parsing and handling specifiers as they appear.
-    while (*ptr) {
-        if (*ptr == FORMAT_SPECIFIER_START) {  // Detect '%', marking a format specifier.
-
-            if (is_escaped_percent(ptr)) {
-                // Handle '%%' by appending a single '%'. In standard printf, this is
-                // a common escape sequence to print '%' without triggering formatting logic.
-                append_to_buffer(buffer, "%", 1);
-                ptr += 2;  // Move past both '%' characters.
-                continue;
-            }
-
-            // Parse the format specifier and determine its validity and handler.
-            // This step mimics printf's specifier parsing, allowing flexible handling
-            // of different data types. Custom parsers improve modularity, allowing for
-            // easy addition or modification of specifiers.
-            const format_info_t info = parse_format(ptr);
-
-            if (!info.valid) {
-                // When encountering an invalid specifier (e.g., "%z"), output the '%'
-                // to indicate an issue in the format string, but skip additional handling.
-                handle_invalid_specifier(buffer, &ptr);
-                continue;
-            }
-
-            // Call the handler associated with the format specifier. Each handler
-            // processes its respective argument type, converts it to a string, and appends it
-            // to the buffer. This design enables modularity and separates parsing from processing.
-            info.handler(args, buffer);
-
-            // Move the pointer forward by the length of the parsed specifier,
-            // ready to process the next portion of the format string.
-            ptr += info.length;
-
-        } else {
-            // Append literal characters (not part of a specifier) to the buffer directly.
-            // This logic mirrors printf's approach of copying non-specifier characters verbatim.
-            append_to_buffer(buffer, ptr, 1);
-            ptr++;
-        }
+    format_to_buffer(format, args, &buffer);
+
+    if (size > 0) {
+        str[buffer.used] = '\0';
     }
 
-    // Write the buffer contents to the output stream in one operation.
-    // Unlike printf, which writes directly, this buffered approach consolidates output,
-    // minimizing I/O calls, which are relatively slow.
-    total_written = buffer->used;
-    flush_buffer(buffer, stream);
+    const size_t total = buffer.used + buffer.overflow;
+    PRINTF_STATS_CALL(PRINTF_ENTRY_VSNPRINTF, buffer.used);
+    return total > INT_MAX ? -1 : (int)total;
+}
 
-    // Clean up the buffer after flushing to prevent memory leaks.
-    free_buffer(buffer);
+// Flush callback of my_vdprintf's streaming buffer.
+static int write_to_descriptor(void *context, const char *data, size_t length) {
+    return write_to_fd(*(const int *)context, data, length);
+}
 
-    return total_written;
-}
\ No newline at end of file
+// Formats straight to a file descriptor. The message is built in the thread's buffer as for
+// my_vfprintf, with long literal runs and strings referenced rather than copied, and then written
+// with one write/writev call, so neither stdio's stream lock nor its buffer copy is involved.
+int my_vdprintf(int fd, const char *format, va_list args) {
+    char stack_storage[STACK_BUFFER_SIZE];
+    buffer_t stack_buffer;
+    buffer_t *buffer = acquire_thread_buffer();
+    if (!buffer) {
+        init_buffer_with_storage(&stack_buffer, stack_storage, sizeof(stack_storage));
+        buffer = &stack_buffer;
+    }
+
+    buffer_segments_t segments;
+    segments.count = 0;
+    segments.length = 0;
+    buffer->segments = &segments;
+
+    // As in my_vfprintf, a message past the high-water mark is written in pieces while it is
+    // formatted; whatever is left, usually the whole message, goes out in the one writev below.
+    buffer_stream_t streaming;
+    init_buffer_stream(&streaming, write_to_descriptor, &fd, get_thread_buffer_high_water());
+    buffer->stream = &streaming;
+
+    format_to_buffer(format, args, buffer);
+
+    buffer->stream = NULL;
+    const size_t total = streaming.flushed + buffer->used + segments.length;
+    int result = write_buffer_to_fd(buffer, fd);
+    if (streaming.error != 0) {
+        errno = streaming.error;
+        result = -1;
+    }
+    buffer->segments = NULL;
+    PRINTF_STATS_CALL(PRINTF_ENTRY_VDPRINTF, result < 0 ? 0 : total);
+
+    if (buffer == &stack_buffer) {
+        release_buffer_storage(buffer);
+    } else {
+        release_thread_buffer(buffer);
+    }
+
+    if (result < 0) {
+        return -1;
+    }
+    if (total > INT_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    return (int)total;
+}
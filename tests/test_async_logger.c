@@ -0,0 +1,232 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
+#include "../include/async_logger.h"
+#include "../include/format_parser.h"
+#include "../include/printf.h"
+
+#define CAPTURE_SIZE (1 << 20)
+
+// Collects everything written to a pipe until the write end closes.
+typedef struct {
+    int fd;
+    char *data;
+    size_t length;
+} pipe_reader_t;
+
+static int read_pipe(void *arg) {
+    pipe_reader_t *reader = arg;
+    ssize_t n;
+    while ((n = read(reader->fd, reader->data + reader->length, CAPTURE_SIZE - 1 - reader->length)) > 0) {
+        reader->length += (size_t)n;
+    }
+    reader->data[reader->length] = '\0';
+    return 0;
+}
+
+typedef struct {
+    int fds[2];
+    pipe_reader_t reader;
+    thrd_t thread;
+    output_sink_t *sink;
+} capture_t;
+
+static void start_capture(capture_t *capture) {
+    assert(pipe(capture->fds) == 0);
+    capture->reader.fd = capture->fds[0];
+    capture->reader.data = malloc(CAPTURE_SIZE);
+    capture->reader.length = 0;
+    assert(thrd_create(&capture->thread, read_pipe, &capture->reader) == thrd_success);
+    const sink_policy_t policy = {.flush_bytes = 4096};
+    capture->sink = create_fd_sink(capture->fds[1], &policy);
+}
+
+// Destroys the sink and closes the pipe, leaving the full output in capture->reader.data.
+static void finish_capture(capture_t *capture) {
+    destroy_sink(capture->sink);
+    close(capture->fds[1]);
+    thrd_join(capture->thread, NULL);
+    close(capture->fds[0]);
+}
+
+static void upper_handler(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    (void)info;
+    const char *str = va_arg(*args, const char *);
+    for (; *str; str++) {
+        const char c = (*str >= 'a' && *str <= 'z') ? (char)(*str - 32) : *str;
+        append_to_buffer(buffer, &c, 1);
+    }
+}
+
+void test_deferred_output_matches_direct_formatting() {
+    capture_t capture;
+    start_capture(&capture);
+    async_logger_t *logger = create_async_logger(capture.sink, NULL);
+
+    char name[16] = "first";
+    char expected[512];
+    size_t length = 0;
+
+    async_printf(logger, "[%s|%5d|%-6x|%llu|%zu|%c]\n", name, -42, 255u, ULLONG_MAX, (size_t)7, 'z');
+    length += (size_t)snprintf(expected + length, sizeof(expected) - length, "[%s|%5d|%-6x|%llu|%zu|%c]\n",
+                               "first", -42, 255u, ULLONG_MAX, (size_t)7, 'z');
+    strcpy(name, "changed");  // The logger copied the string; the change must not show.
+
+    async_printf(logger, "%*.*f|%.3s|%s|%p|%.*s\n", 10, 3, 3.14159, "truncate", (char *)NULL, (void *)0x1234, -1,
+                 "all");
+    length += (size_t)snprintf(expected + length, sizeof(expected) - length, "%*.*f|%.3s|%s|%p|%.*s\n", 10, 3,
+                               3.14159, "truncate", "(null)", (void *)0x1234, -1, "all");
+
+    // A handler registered without an argument class is formatted on the caller's thread.
+    register_specifier('U', upper_handler);
+    async_printf(logger, "%U!\n", "shout");
+    length += (size_t)snprintf(expected + length, sizeof(expected) - length, "SHOUT!\n");
+
+    // So is a positional format.
+    async_printf(logger, "%2$s=%1$d\n", 5, "count");
+    length += (size_t)snprintf(expected + length, sizeof(expected) - length, "count=5\n");
+
+    async_logger_flush(logger);
+    async_logger_stats_t stats;
+    async_logger_get_stats(logger, &stats);
+    assert(stats.enqueued == 4 && stats.written == 4);
+    assert(stats.preformatted == 2 && stats.dropped == 0);
+
+    destroy_async_logger(logger);
+    register_specifier('U', NULL);
+    finish_capture(&capture);
+    assert(capture.reader.length == length);
+    assert(strcmp(capture.reader.data, expected) == 0);
+    free(capture.reader.data);
+}
+
+void test_oversized_record_goes_to_heap() {
+    capture_t capture;
+    start_capture(&capture);
+    async_logger_t *logger = create_async_logger(capture.sink, NULL);
+
+    char big[ASYNC_RECORD_PAYLOAD_SIZE * 4];
+    memset(big, 'b', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    async_printf(logger, "<%s>", big);
+
+    async_logger_flush(logger);
+    async_logger_stats_t stats;
+    async_logger_get_stats(logger, &stats);
+    assert(stats.oversized == 1);
+
+    destroy_async_logger(logger);
+    finish_capture(&capture);
+    assert(capture.reader.length == sizeof(big) + 1);
+    assert(capture.reader.data[0] == '<' && capture.reader.data[sizeof(big)] == '>');
+    free(capture.reader.data);
+}
+
+#define PRODUCERS 4
+#define MESSAGES_PER_PRODUCER 2000
+
+static int produce(void *arg) {
+    async_logger_t *logger = arg;
+    for (int i = 0; i < MESSAGES_PER_PRODUCER; i++) {
+        const int queued = async_printf(logger, "m%05d\n", i);
+        assert(queued == 0);
+    }
+    return 0;
+}
+
+// With blocking, a tiny ring under several producers loses nothing.
+void test_blocking_producers_lose_nothing() {
+    capture_t capture;
+    start_capture(&capture);
+    const async_logger_config_t config = {.capacity = 8, .full_policy = ASYNC_FULL_BLOCK};
+    async_logger_t *logger = create_async_logger(capture.sink, &config);
+
+    thrd_t threads[PRODUCERS];
+    for (int i = 0; i < PRODUCERS; i++) {
+        assert(thrd_create(&threads[i], produce, logger) == thrd_success);
+    }
+    for (int i = 0; i < PRODUCERS; i++) {
+        thrd_join(threads[i], NULL);
+    }
+
+    destroy_async_logger(logger);
+    finish_capture(&capture);
+
+    // Every message is 7 bytes, and each index appears once per producer.
+    assert(capture.reader.length == (size_t)PRODUCERS * MESSAGES_PER_PRODUCER * 7);
+    static int seen[MESSAGES_PER_PRODUCER];
+    memset(seen, 0, sizeof(seen));
+    for (size_t offset = 0; offset < capture.reader.length; offset += 7) {
+        seen[atoi(capture.reader.data + offset + 1)]++;
+    }
+    for (int i = 0; i < MESSAGES_PER_PRODUCER; i++) {
+        assert(seen[i] == PRODUCERS);
+    }
+    free(capture.reader.data);
+}
+
+// With dropping, a full ring rejects messages instead of waiting, and every message is accounted for.
+void test_drop_policy_counts_losses() {
+    capture_t capture;
+    start_capture(&capture);
+    const async_logger_config_t config = {.capacity = 2, .full_policy = ASYNC_FULL_DROP};
+    async_logger_t *logger = create_async_logger(capture.sink, &config);
+
+    int accepted = 0;
+    for (int i = 0; i < 10000; i++) {
+        accepted += async_printf(logger, "%d %f %s\n", i, i * 0.5, "padding padding padding") == 0;
+    }
+
+    async_logger_flush(logger);
+    async_logger_stats_t stats;
+    async_logger_get_stats(logger, &stats);
+    assert(stats.enqueued == (uint64_t)accepted);
+    assert(stats.enqueued + stats.dropped == 10000);
+    assert(stats.written == stats.enqueued);
+
+    destroy_async_logger(logger);
+    finish_capture(&capture);
+    free(capture.reader.data);
+}
+
+// An idle consumer parks instead of polling, and a record published while it sleeps wakes it.
+void test_idle_consumer_parks_until_woken() {
+    capture_t capture;
+    start_capture(&capture);
+    async_logger_t *logger = create_async_logger(capture.sink, NULL);
+
+    async_logger_stats_t stats;
+    for (int round = 0; round < 3; round++) {
+        thrd_sleep(&(struct timespec){.tv_nsec = 50 * 1000000L}, NULL);
+        async_logger_get_stats(logger, &stats);
+        assert(stats.parked == (uint64_t)round + 1);  // Asleep once, not woken by a timer.
+        assert(async_printf(logger, "round %d\n", round) == 0);
+        async_logger_flush(logger);
+    }
+
+    async_logger_get_stats(logger, &stats);
+    assert(stats.written == 3);
+    destroy_async_logger(logger);
+    finish_capture(&capture);
+    assert(strcmp(capture.reader.data, "round 0\nround 1\nround 2\n") == 0);
+    free(capture.reader.data);
+}
+
+int main() {
+    initialize_printf();
+
+    test_deferred_output_matches_direct_formatting();
+    test_oversized_record_goes_to_heap();
+    test_blocking_producers_lose_nothing();
+    test_drop_policy_counts_losses();
+    test_idle_consumer_parks_until_woken();
+
+    cleanup_printf();
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/batch.h"
+#include "../include/buffer.h"
+#include "../include/printf.h"
+
+#define ROWS 10000
+
+static const char *const names[] = {"alpha", "bravo", "charlie", NULL};
+
+// Column data shared by the tests: row i of each array.
+static int ids[ROWS];
+static unsigned flags[ROWS];
+static double ratios[ROWS];
+static const char *labels[ROWS];
+static int widths[ROWS];
+
+static void fill_columns(void) {
+    for (int i = 0; i < ROWS; i++) {
+        ids[i] = i * 7 - 300;
+        flags[i] = (unsigned)i * 2654435761u;
+        ratios[i] = i / 8.0;
+        labels[i] = names[i % 4];
+        widths[i] = i % 12;
+    }
+}
+
+// Reads back everything a stream sink wrote to its temporary file.
+static char *read_back(FILE *file, size_t *length) {
+    fflush(file);
+    *length = (size_t)ftell(file);
+    char *text = malloc(*length + 1);
+    rewind(file);
+    assert(fread(text, 1, *length, file) == *length);
+    text[*length] = '\0';
+    return text;
+}
+
+// The same rows formatted one call at a time.
+static char *expected_rows(size_t rows, size_t *length) {
+    buffer_t *expected = init_buffer(1024);
+    char row[256];
+    for (size_t i = 0; i < rows; i++) {
+        const int n = my_snprintf(row, sizeof(row), "%d,%08x,%.3f,%*s\n", ids[i], flags[i], ratios[i], widths[i],
+                                  labels[i]);
+        append_to_buffer(expected, row, (size_t)n);
+    }
+    char *text = malloc(expected->used + 1);
+    memcpy(text, expected->data, expected->used);
+    text[expected->used] = '\0';
+    *length = expected->used;
+    free_buffer(expected);
+    return text;
+}
+
+static void check_batch(unsigned threads, size_t rows) {
+    FILE *file = tmpfile();
+    output_sink_t *sink = create_stream_sink(file, NULL);
+    const long long written = my_printf_batch_parallel(sink, threads, "%d,%08x,%.3f,%*s\n", rows, ids, flags,
+                                                       ratios, widths, labels);
+    destroy_sink(sink);
+
+    size_t length;
+    size_t expected_length;
+    char *text = read_back(file, &length);
+    char *expected = expected_rows(rows, &expected_length);
+    assert(written == (long long)expected_length);
+    assert(length == expected_length);
+    assert(memcmp(text, expected, length) == 0);
+    free(text);
+    free(expected);
+    fclose(file);
+}
+
+void test_single_thread_matches_per_row_calls() {
+    check_batch(1, 0);
+    check_batch(1, 1);
+    check_batch(1, BATCH_BLOCK_ROWS + 1);
+    check_batch(1, ROWS);
+}
+
+// Blocks rendered on several threads come out in row order.
+void test_parallel_output_is_ordered() {
+    check_batch(4, ROWS);
+    check_batch(3, BATCH_BLOCK_ROWS * 2 + 5);
+    check_batch(BATCH_MAX_THREADS + 10, ROWS);  // More threads than blocks.
+}
+
+void test_varargs_entry_point() {
+    FILE *file = tmpfile();
+    output_sink_t *sink = create_stream_sink(file, NULL);
+    const long long values[] = {1, -2, 3000000000LL};
+    const char *const words[] = {"a", "bb", "ccc"};
+    assert(my_printf_batch(sink, "[%lld %-4s %{upper}]", 3, values, words, words) == 43);
+    destroy_sink(sink);
+
+    size_t length;
+    char *text = read_back(file, &length);
+    assert(strcmp(text, "[1 a    A][-2 bb   BB][3000000000 ccc  CCC]") == 0);
+    free(text);
+    fclose(file);
+}
+
+// A conversion without an argument class has no column type, so the batch is refused.
+void test_unknown_argument_class_is_rejected() {
+    FILE *file = tmpfile();
+    output_sink_t *sink = create_stream_sink(file, NULL);
+    const void *blobs[] = {"abc"};
+    errno = 0;
+    assert(my_printf_batch(sink, "%.3H\n", 1, blobs) == -1);
+    assert(errno == EINVAL);
+    destroy_sink(sink);
+    assert(ftell(file) == 0);
+    fclose(file);
+}
+
+int main() {
+    initialize_printf();
+    fill_columns();
+
+    test_single_thread_matches_per_row_calls();
+    test_parallel_output_is_ordered();
+    test_varargs_entry_point();
+    test_unknown_argument_class_is_rejected();
+
+    cleanup_printf();
+    return 0;
+}
@@ -0,0 +1,199 @@
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/binary_log.h"
+#include "../include/format_parser.h"
+#include "../include/printf.h"
+#include "../include/vfprintf.h"
+
+static int log_printf(FILE *stream, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = my_vfprintf(stream, format, args);
+    va_end(args);
+    return result;
+}
+
+// Decodes everything written to `log` so far into `out`. Returns decode_binary_log's result.
+static int decode_to_string(FILE *log, char *out, size_t size) {
+    FILE *text = tmpfile();
+    assert(text != NULL);
+    rewind(log);
+    const int result = decode_binary_log(log, text);
+    rewind(text);
+    const size_t length = fread(out, 1, size - 1, text);
+    out[length] = '\0';
+    fclose(text);
+    return result;
+}
+
+static void upper_handler(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    (void)info;
+    const char *str = va_arg(*args, const char *);
+    for (; *str; str++) {
+        const char c = (*str >= 'a' && *str <= 'z') ? (char)(*str - 32) : *str;
+        append_to_buffer(buffer, &c, 1);
+    }
+}
+
+void test_round_trip_matches_text_output() {
+    FILE *log = tmpfile();
+    assert(enable_binary_log(log) == 0);
+    assert(enable_binary_log(log) == -1);
+
+    char expected[1024];
+    size_t length = 0;
+    for (int i = -2; i < 3; i++) {
+        log_printf(log, "[%d|%5u|%-4x|%s]\n", i * 1000, (unsigned)i, 255u, i < 0 ? "neg" : "pos");
+        length += (size_t)snprintf(expected + length, sizeof(expected) - length, "[%d|%5u|%-4x|%s]\n", i * 1000,
+                                   (unsigned)i, 255u, i < 0 ? "neg" : "pos");
+    }
+
+    log_printf(log, "%lld %llu %ld %zu %td %jd %c %p %%\n", LLONG_MIN, ULLONG_MAX, LONG_MAX, (size_t)SIZE_MAX,
+               (ptrdiff_t)-5, (intmax_t)INTMAX_MIN, 'q', (void *)0xbeef);
+    length += (size_t)snprintf(expected + length, sizeof(expected) - length, "%lld %llu %ld %zu %td %jd %c %p %%\n",
+                               LLONG_MIN, ULLONG_MAX, LONG_MAX, (size_t)SIZE_MAX, (ptrdiff_t)-5, (intmax_t)INTMAX_MIN,
+                               'q', (void *)0xbeef);
+
+    char unterminated[4] = {'a', 'b', 'c', 'd'};
+    log_printf(log, "%*.*f|%.3s|%s|%-*s|%g|%e\n", 12, 4, -3.14159265, unterminated, (char *)NULL, -6, "ab", 1e-300,
+               0.1);
+    length += (size_t)snprintf(expected + length, sizeof(expected) - length, "%*.*f|%.3s|%s|%-*s|%g|%e\n", 12, 4,
+                               -3.14159265, "abc", "(null)", -6, "ab", 1e-300, 0.1);
+
+    // Handlers without an argument class are formatted at the call and stored as text.
+    register_specifier('U', upper_handler);
+    log_printf(log, "%U!\n", "shout");
+    length += (size_t)snprintf(expected + length, sizeof(expected) - length, "SHOUT!\n");
+
+    char out[1024];
+    assert(decode_to_string(log, out, sizeof(out)) == 0);
+    register_specifier('U', NULL);
+    assert(strlen(out) == length);
+    assert(strcmp(out, expected) == 0);
+
+    disable_binary_log(log);
+    fclose(log);
+}
+
+// A repeated format costs its id and varint arguments only; the text is defined once.
+void test_repeated_format_is_compact() {
+    FILE *log = tmpfile();
+    assert(enable_binary_log(log) == 0);
+
+    const char *format = "request %u finished in %d us with status %s\n";
+    const int first = log_printf(log, format, 123456u, 87, "ok");
+    const int second = log_printf(log, format, 123457u, 91, "ok");
+    assert(first > (int)strlen(format));
+    // Tag, id, 123457 (3 bytes), zigzag 91 (2 bytes), and the string's length and bytes.
+    assert(second == 1 + 1 + 3 + 2 + 1 + 2);
+
+    char out[256];
+    assert(decode_to_string(log, out, sizeof(out)) == 0);
+    assert(strcmp(out, "request 123456 finished in 87 us with status ok\n"
+                       "request 123457 finished in 91 us with status ok\n") == 0);
+
+    disable_binary_log(log);
+    fclose(log);
+}
+
+// A failed write is reported, and a format whose DEFINE never reached the stream is defined
+// again by its next message, so the log stays decodable.
+void test_failed_write_is_reported() {
+    FILE *stream = fopen("/dev/full", "w");
+    assert(stream != NULL);
+    setvbuf(stream, NULL, _IONBF, 0);
+    const int enabled = enable_binary_log(stream);
+    assert(enabled == 0);
+
+    errno = 0;
+    const int failed = log_printf(stream, "%d apples\n", 3);
+    assert(failed == -1 && errno == ENOSPC);
+
+    // Point the same FILE at a real file; the binary log is keyed by the FILE and survives.
+    char path[] = "/tmp/test_binary_log_XXXXXX";
+    const int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    FILE *reopened = freopen(path, "w+", stream);
+    assert(reopened == stream);
+    unlink(path);
+    fwrite(BINARY_LOG_MAGIC, 1, BINARY_LOG_MAGIC_LENGTH, stream);
+    const int written = log_printf(stream, "%d apples\n", 4);
+    assert(written > 0);
+
+    char out[64];
+    const int decoded = decode_to_string(stream, out, sizeof(out));
+    assert(decoded == 0 && strcmp(out, "4 apples\n") == 0);
+    (void)enabled;
+    (void)failed;
+    (void)reopened;
+    (void)written;
+    (void)decoded;
+
+    disable_binary_log(stream);
+    fclose(stream);
+}
+
+void test_malformed_input_is_rejected() {
+    char out[256];
+
+    FILE *not_a_log = tmpfile();
+    fputs("plain text", not_a_log);
+    assert(decode_to_string(not_a_log, out, sizeof(out)) == -1);
+    fclose(not_a_log);
+
+    // A log cut off inside a record decodes what came before it and reports the damage.
+    FILE *log = tmpfile();
+    assert(enable_binary_log(log) == 0);
+    log_printf(log, "complete %d\n", 1);
+    log_printf(log, "cut %s\n", "off in the middle of this string");
+    disable_binary_log(log);
+    fflush(log);
+    const long size = ftell(log);
+    rewind(log);
+    char bytes[256];
+    assert(fread(bytes, 1, (size_t)size, log) == (size_t)size);
+
+    FILE *truncated = tmpfile();
+    fwrite(bytes, 1, (size_t)size - 5, truncated);
+    assert(decode_to_string(truncated, out, sizeof(out)) == -1);
+    assert(strcmp(out, "complete 1\n") == 0);
+    fclose(truncated);
+    fclose(log);
+}
+
+void test_disable_restores_text_output() {
+    FILE *stream = tmpfile();
+    assert(enable_binary_log(stream) == 0);
+    disable_binary_log(stream);
+    assert(find_binary_log(stream) == NULL);
+
+    assert(log_printf(stream, "%s %d", "text", 7) == 6);
+    char out[16];
+    rewind(stream);
+    const size_t length = fread(out, 1, sizeof(out) - 1, stream);
+    out[length] = '\0';
+    assert(strcmp(out, BINARY_LOG_MAGIC "text 7") == 0);
+    fclose(stream);
+}
+
+int main() {
+    initialize_printf();
+
+    test_round_trip_matches_text_output();
+    test_repeated_format_is_compact();
+    test_failed_write_is_reported();
+    test_malformed_input_is_rejected();
+    test_disable_restores_text_output();
+
+    cleanup_printf();
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
+#include <unistd.h>
 #include "../include/buffer.h"
 
 void test_buffer_initialization() {
@@ -27,10 +29,223 @@ void test_buffer_expansion() {
     free_buffer(buffer);
 }
 
+void test_buffer_with_storage_moves_to_heap() {
+    char storage[4];
+    buffer_t buffer;
+    init_buffer_with_storage(&buffer, storage, sizeof(storage));
+    append_to_buffer(&buffer, "abc", 3);
+    assert(buffer.data == storage);
+    append_to_buffer(&buffer, "defg", 4);
+    assert(buffer.data != storage);
+    assert(!(buffer.flags & BUFFER_FLAG_BORROWED));
+    assert(strncmp(buffer.data, "abcdefg", 7) == 0);
+    release_buffer_storage(&buffer);
+}
+
+void test_fixed_buffer_counts_overflow() {
+    char storage[4];
+    buffer_t buffer;
+    init_fixed_buffer(&buffer, storage, sizeof(storage));
+    append_to_buffer(&buffer, "abc", 3);
+    append_to_buffer(&buffer, "defg", 4);
+    assert(buffer.data == storage);
+    assert(buffer.used == 4);
+    assert(buffer.overflow == 3);
+    assert(strncmp(storage, "abcd", 4) == 0);
+}
+
+void test_reserve_and_commit() {
+    buffer_t *buffer = init_buffer(4);
+    append_to_buffer(buffer, "ab", 2);
+    char *out = buffer_reserve(buffer, 8);
+    assert(out == buffer->data + 2);
+    memcpy(out, "cdef", 4);
+    buffer_commit(buffer, 4);
+    assert(buffer->used == 6);
+    assert(strncmp(buffer->data, "abcdef", 6) == 0);
+    free_buffer(buffer);
+}
+
+void test_reserve_on_full_fixed_buffer_truncates() {
+    char storage[4];
+    buffer_t buffer;
+    init_fixed_buffer(&buffer, storage, sizeof(storage));
+    append_to_buffer(&buffer, "ab", 2);
+    char *out = buffer_reserve(&buffer, 8);
+    assert(out == buffer.spill);
+    memcpy(out, "cdef", 4);
+    buffer_commit(&buffer, 4);
+    assert(buffer.used == 4);
+    assert(buffer.overflow == 2);
+    assert(strncmp(storage, "abcd", 4) == 0);
+    assert(buffer_reserve(&buffer, BUFFER_SPILL_SIZE + 1) == NULL);
+}
+
+void test_thread_buffer_reuse() {
+    buffer_t *buffer = acquire_thread_buffer();
+    assert(buffer != NULL);
+    assert(acquire_thread_buffer() == NULL);  // Re-entrant use gets no buffer.
+    append_to_buffer(buffer, "abc", 3);
+    char *data = buffer->data;
+    release_thread_buffer(buffer);
+
+    buffer_t *again = acquire_thread_buffer();
+    assert(again == buffer);
+    assert(again->data == data);
+    (void)data;
+    assert(again->used == 0);
+    release_thread_buffer(again);
+}
+
+void test_thread_buffer_shrinks_above_high_water() {
+    char big[4096];
+    memset(big, 'x', sizeof(big));
+    set_thread_buffer_high_water(2048);
+
+    buffer_t *buffer = acquire_thread_buffer();
+    append_to_buffer(buffer, big, sizeof(big));
+    assert(buffer->size >= sizeof(big));
+    release_thread_buffer(buffer);
+
+    buffer = acquire_thread_buffer();
+    assert(buffer->size == THREAD_BUFFER_INLINE_SIZE);
+    assert(buffer->flags & BUFFER_FLAG_BORROWED);
+    release_thread_buffer(buffer);
+    set_thread_buffer_high_water(THREAD_BUFFER_DEFAULT_HIGH_WATER);
+}
+
+void test_referenced_segments_written_in_order() {
+    char storage[64];
+    char large[BUFFER_SEGMENT_MIN_LENGTH];
+    memset(large, 'L', sizeof(large));
+    buffer_segments_t segments = {.count = 0, .length = 0};
+    buffer_t buffer;
+    init_buffer_with_storage(&buffer, storage, sizeof(storage));
+    buffer.segments = &segments;
+
+    append_reference_to_buffer(&buffer, "[", 1);  // Too short to reference: copied.
+    append_reference_to_buffer(&buffer, large, sizeof(large));
+    append_to_buffer(&buffer, "]", 1);
+    assert(buffer.used == 2);
+    assert(segments.count == 1);
+    assert(segments.length == sizeof(large));
+
+    int fds[2];
+    assert(pipe(fds) == 0);
+    assert(write_buffer_to_fd(&buffer, fds[1]) == 0);
+    assert(buffer.used == 0 && segments.count == 0);
+    close(fds[1]);
+
+    char out[BUFFER_SEGMENT_MIN_LENGTH + 8];
+    const ssize_t n = read(fds[0], out, sizeof(out));
+    close(fds[0]);
+    assert(n == (ssize_t)sizeof(large) + 2);
+    assert(out[0] == '[' && out[n - 1] == ']');
+    assert(memcmp(out + 1, large, sizeof(large)) == 0);
+}
+
+void test_write_to_bad_fd_fails() {
+    char storage[16];
+    buffer_t buffer;
+    init_buffer_with_storage(&buffer, storage, sizeof(storage));
+    append_to_buffer(&buffer, "x", 1);
+    assert(write_buffer_to_fd(&buffer, -1) == -1);
+}
+
+// Flush callback that keeps every piece it is given.
+typedef struct {
+    char data[1024];
+    size_t length;
+    size_t pieces;
+    const char *last;  // Start of the latest piece.
+} collected_t;
+
+static int collect_piece(void *context, const char *data, size_t length) {
+    collected_t *collected = context;
+    assert(collected->length + length <= sizeof(collected->data));
+    memcpy(collected->data + collected->length, data, length);
+    collected->length += length;
+    collected->pieces++;
+    collected->last = data;
+    return 0;
+}
+
+static int refuse_piece(void *context, const char *data, size_t length) {
+    (void)context;
+    (void)data;
+    (void)length;
+    errno = ENOSPC;
+    return -1;
+}
+
+void test_streaming_buffer_stays_bounded() {
+    static collected_t collected;
+    char storage[16];
+    buffer_t buffer;
+    init_buffer_with_storage(&buffer, storage, sizeof(storage));
+    buffer_stream_t stream;
+    init_buffer_stream(&stream, collect_piece, &collected, 64);
+    buffer.stream = &stream;
+
+    char big[200];
+    memset(big, 'b', sizeof(big));
+    append_to_buffer(&buffer, "head:", 5);
+    append_to_buffer(&buffer, big, sizeof(big));  // Longer than the limit: passed on uncopied.
+    assert(collected.pieces == 2);
+    assert(collected.last == big);
+
+    for (int i = 0; i < 10; i++) {
+        append_to_buffer(&buffer, "0123456789", 10);
+    }
+    fill_buffer(&buffer, '.', 150);
+    assert(buffer.size <= 64);
+    assert(buffer_reserve(&buffer, 100) == NULL);
+    assert(finish_buffer_stream(&buffer) == 0);
+    assert(buffer.stream == NULL);
+
+    char expected[512];
+    size_t length = 0;
+    memcpy(expected, "head:", 5);
+    length += 5;
+    memcpy(expected + length, big, sizeof(big));
+    length += sizeof(big);
+    for (int i = 0; i < 10; i++) {
+        memcpy(expected + length, "0123456789", 10);
+        length += 10;
+    }
+    memset(expected + length, '.', 150);
+    length += 150;
+    assert(stream.flushed == length);
+    assert(collected.length == length);
+    assert(memcmp(collected.data, expected, length) == 0);
+    release_buffer_storage(&buffer);
+
+    // A failed flush is reported once the message ends.
+    init_buffer_with_storage(&buffer, storage, sizeof(storage));
+    init_buffer_stream(&stream, refuse_piece, NULL, 32);
+    buffer.stream = &stream;
+    append_to_buffer(&buffer, big, sizeof(big));
+    append_to_buffer(&buffer, "tail", 4);
+    errno = 0;
+    assert(finish_buffer_stream(&buffer) == -1);
+    assert(errno == ENOSPC);
+    assert(stream.flushed == 0);
+    release_buffer_storage(&buffer);
+}
+
 int main() {
     test_buffer_initialization();
     test_append_to_buffer();
     test_buffer_expansion();
+    test_buffer_with_storage_moves_to_heap();
+    test_fixed_buffer_counts_overflow();
+    test_reserve_and_commit();
+    test_reserve_on_full_fixed_buffer_truncates();
+    test_thread_buffer_reuse();
+    test_thread_buffer_shrinks_above_high_water();
+    test_referenced_segments_written_in_order();
+    test_write_to_bad_fd_fails();
+    test_streaming_buffer_stays_bounded();
 
     return 0;
 }
@@ -0,0 +1,148 @@
+#include <assert.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "../include/compiled_format.h"
+#include "../include/format_parser.h"
+#include "../include/printf.h"
+
+void test_compile_literals_and_conversions() {
+    initialize_format_specifiers();
+
+    compiled_format_t *compiled = compile_format("a%db%%c%z");
+    assert(compiled != NULL);
+    assert(compiled->op_count == 4);
+    assert(compiled->ops[0].kind == FORMAT_OP_LITERAL);
+    assert(compiled->ops[0].literal_length == 1);
+    assert(compiled->ops[1].kind == FORMAT_OP_CONVERSION);
+    assert(compiled->ops[1].info.specifier == 'd');
+    assert(compiled->ops[2].kind == FORMAT_OP_LITERAL);
+    assert(strncmp(compiled->ops[2].literal, "b%", compiled->ops[2].literal_length) == 0);
+    assert(compiled->ops[3].kind == FORMAT_OP_LITERAL);
+    assert(strncmp(compiled->ops[3].literal, "c%z", compiled->ops[3].literal_length) == 0);
+    free_compiled_format(compiled);
+
+    cleanup_format_specifiers();
+}
+
+void test_cache_reuses_entry() {
+    initialize_format_specifiers();
+
+    static const char format[] = "value: %d\n";
+    const compiled_format_t *first = get_compiled_format(format);
+    const compiled_format_t *second = get_compiled_format(format);
+    assert(first != NULL);
+    assert(first == second);
+
+    clear_compiled_format_cache();
+    cleanup_format_specifiers();
+}
+
+void test_cache_rejects_changed_text() {
+    initialize_format_specifiers();
+
+    char format[16];
+    strcpy(format, "%d items");
+    assert(get_compiled_format(format) != NULL);
+    strcpy(format, "%s items");
+    assert(get_compiled_format(format) == NULL);
+
+    clear_compiled_format_cache();
+    cleanup_format_specifiers();
+}
+
+// Peak resident set size of this process, in kilobytes.
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void test_reused_buffer_memory_is_bounded() {
+    initialize_format_specifiers();
+
+    static char format[16];
+    strcpy(format, "%d items");
+    const compiled_format_t *cached = get_compiled_format(format);
+    assert(cached != NULL);
+
+    // Alternating texts at one address must not replace (and leak) the slot's entry each call.
+    const long before = peak_rss_kb();
+    char out[32];
+    for (int i = 0; i < 200000; i++) {
+        strcpy(format, (i & 1) ? "%d items" : "%s items");
+        if (i & 1) {
+            my_snprintf(out, sizeof(out), format, i);
+        } else {
+            my_snprintf(out, sizeof(out), format, "some");
+            assert(strcmp(out, "some items") == 0);
+        }
+    }
+    const long growth = peak_rss_kb() - before;
+    assert(growth < 4096);
+    (void)growth;
+
+    strcpy(format, "%d items");
+    assert(get_compiled_format(format) == cached);
+    (void)cached;
+
+    clear_compiled_format_cache();
+    cleanup_format_specifiers();
+}
+
+void test_cache_refreshes_after_registration() {
+    initialize_format_specifiers();
+
+    static const char format[] = "%d";
+    const compiled_format_t *before = get_compiled_format(format);
+    register_specifier('d', get_format_handler('i'));
+    const compiled_format_t *after = get_compiled_format(format);
+    assert(after != NULL);
+    assert(after != before);
+    assert(after->generation == get_format_specifiers_generation());
+
+    clear_compiled_format_cache();
+    cleanup_format_specifiers();
+}
+
+void test_positional_slots() {
+    initialize_format_specifiers();
+
+    compiled_format_t *compiled = compile_format("%3$s %1$*2$d %4$f %1$H %1$s");
+    assert(compiled != NULL);
+    assert(compiled->position_count == 4);
+    assert(compiled->slot_classes[0] == FORMAT_ARG_INT);
+    assert(compiled->slot_classes[1] == FORMAT_ARG_INT);
+    assert(compiled->slot_classes[2] == FORMAT_ARG_STRING);
+    assert(compiled->slot_classes[3] == FORMAT_ARG_DOUBLE);
+    // %1$H has no argument class and %1$s reads slot 1 as a different type: both stay text.
+    assert(compiled->invalid_count == 2);
+    const format_op_t *last = &compiled->ops[compiled->op_count - 1];
+    assert(last->kind == FORMAT_OP_LITERAL);
+    assert(strncmp(last->literal, "%1$s", last->literal_length) == 0);
+    free_compiled_format(compiled);
+
+    // Unnumbered conversions continue after the previous argument; skipped slots are ints.
+    compiled = compile_format("%3$d %s");
+    assert(compiled->position_count == 4);
+    assert(compiled->ops[2].info.position == 4);
+    assert(compiled->slot_classes[0] == FORMAT_ARG_INT);
+    assert(compiled->slot_classes[3] == FORMAT_ARG_STRING);
+    free_compiled_format(compiled);
+
+    compiled = compile_format("%d %s");
+    assert(compiled->position_count == 0);
+    free_compiled_format(compiled);
+
+    cleanup_format_specifiers();
+}
+
+int main() {
+    test_compile_literals_and_conversions();
+    test_cache_reuses_entry();
+    test_cache_rejects_changed_text();
+    test_reused_buffer_memory_is_bounded();
+    test_cache_refreshes_after_registration();
+    test_positional_slots();
+
+    return 0;
+}
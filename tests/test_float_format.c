@@ -0,0 +1,131 @@
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "../include/printf.h"
+
+// Formats exercised against every value: plain conversions, precisions that hit both the
+// 64-bit fast path and the big-integer fallback, and flag combinations.
+static const char *const formats[] = {
+    "%f", "%.0f", "%.1f", "%.3f", "%.17f", "%.40f", "%#.0f", "%+f", "% f", "%12.4f", "%-12.2f|", "%012.3f",
+    "%F", "%e", "%.0e", "%.3e", "%.16e", "%.30E", "%#.0e", "%+14.5e", "%-14.2E|", "%014.3e",
+    "%g", "%.0g", "%.1g", "%.3g", "%.17g", "%#g", "%#.3G", "%+g", "%12g", "%-12G|", "%012g",
+    "%a", "%A", "%.0a", "%.1a", "%.3a", "%.20a", "%#.0a", "%+a", "%20a", "%-20A|", "%020a", "%lf",
+};
+
+static void check_against_libc(const char *format, double value) {
+    char mine[1200];
+    char theirs[1200];
+    int mine_length = my_snprintf(mine, sizeof(mine), format, value);
+    int theirs_length = snprintf(theirs, sizeof(theirs), format, value);
+    if (mine_length != theirs_length || strcmp(mine, theirs) != 0) {
+        fprintf(stderr, "%s with %a: got \"%s\", expected \"%s\"\n", format, value, mine, theirs);
+    }
+    assert(mine_length == theirs_length);
+    assert(strcmp(mine, theirs) == 0);
+}
+
+static void check_all_formats(double value) {
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        check_against_libc(formats[i], value);
+    }
+}
+
+void test_special_values() {
+    const double values[] = {0.0, -0.0, INFINITY, -INFINITY, NAN, -NAN};
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        check_all_formats(values[i]);
+    }
+}
+
+void test_boundaries() {
+    const double values[] = {
+        1.0, -1.0, 0.5, 1.5, 2.5, 0.125, 0.1, 0.2, 0.3, 1e-5, 1e-4, 123456.0, 999999.4, 9.5, 0.95, 0.05,
+        1e15, 1e16, 1e17, 1e21, 1e22, 1e23, 123456789012345678.0, 18446744073709551616.0,
+        3.14159265358979323846, 2.718281828459045, 1.0 / 3.0, 2.0 / 3.0, 0.000123456789,
+        DBL_MAX, -DBL_MAX, DBL_MIN, DBL_EPSILON, DBL_TRUE_MIN, 5e-324, 2.2250738585072009e-308,
+        0x1.fffffffffffffp+0, 0x1.8p-1074, 0x1.ffffffp+1023, 9007199254740993.0, 4503599627370495.5,
+    };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        check_all_formats(values[i]);
+        check_all_formats(-values[i]);
+    }
+}
+
+// Ties are broken on the exact binary value, half to even.
+void test_rounding_ties() {
+    check_against_libc("%.0f", 0.5);
+    check_against_libc("%.0f", 1.5);
+    check_against_libc("%.0f", 2.5);
+    check_against_libc("%.1f", 0.25);
+    check_against_libc("%.1f", 0.35);
+    check_against_libc("%.2f", 1.005);
+    check_against_libc("%.0e", 25.0);
+    check_against_libc("%.1a", 0x1.08p+0);
+    check_against_libc("%.1a", 0x1.18p+0);
+    check_against_libc("%.0a", 0x1.8p+0);
+    check_against_libc("%.0a", 0x1.fp+0);
+}
+
+// Small values have their digits hundreds of places after the point; %f must print them all.
+void test_long_fixed_precision() {
+    check_against_libc("%.900f", 1e-300);
+    check_against_libc("%.820f", 1e-250);
+    check_against_libc("%.1074f", 4.94e-324);
+    check_against_libc("%.1074f", DBL_MIN);
+    check_against_libc("%.1074f", 0x1.fffffffffffffp-1022);
+    check_against_libc("%.1100f", DBL_TRUE_MIN);
+    check_against_libc("%.1000e", 1e-300);
+}
+
+// When rounding carries %#g into exponential notation, C requires the full precision
+// ("1.00000e+06"); glibc 2.36 drops the zeros ("1.e+06"), so this case is checked literally.
+void test_alternate_general_carry() {
+    char out[64];
+    my_snprintf(out, sizeof(out), "%#g|%#.3g|%#g", 999999.5, 99.96, 0.99999996);
+    assert(strcmp(out, "1.00000e+06|100.|1.00000") == 0);
+}
+
+// Random bit patterns cover every exponent, including subnormals, with a fixed seed.
+void test_random_bit_patterns() {
+    uint64_t state = UINT64_C(0x853c49e6748fea9b);
+    for (int i = 0; i < 4000; i++) {
+        state = state * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+        const uint64_t bits = state ^ (state >> 29);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        check_all_formats(value);
+        // Moderate magnitudes with a few fraction bits exercise the 64-bit fast path.
+        check_all_formats((double)(state >> 40) / (double)(UINT64_C(1) << (bits % 64)));
+    }
+}
+
+void test_width_precision_arguments() {
+    char mine[128];
+    char theirs[128];
+    my_snprintf(mine, sizeof(mine), "[%*.*f|%-*.*e|%.*g]", 10, 2, 3.14159, 12, 3, -2.5e-7, -1, 0.1);
+    snprintf(theirs, sizeof(theirs), "[%*.*f|%-*.*e|%.*g]", 10, 2, 3.14159, 12, 3, -2.5e-7, -1, 0.1);
+    assert(strcmp(mine, theirs) == 0);
+
+    // A float argument is promoted to double.
+    my_snprintf(mine, sizeof(mine), "%f %g", 1.25f, 0.1f);
+    snprintf(theirs, sizeof(theirs), "%f %g", 1.25f, 0.1f);
+    assert(strcmp(mine, theirs) == 0);
+}
+
+int main() {
+    initialize_printf();
+
+    test_special_values();
+    test_boundaries();
+    test_rounding_ties();
+    test_long_fixed_precision();
+    test_alternate_general_carry();
+    test_random_bit_patterns();
+    test_width_precision_arguments();
+
+    cleanup_printf();
+    return 0;
+}
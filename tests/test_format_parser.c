@@ -1,6 +1,13 @@
 #include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <threads.h>
 #include "../include/format_parser.h"
 #include "../include/buffer.h"
+#include "../include/compiled_format.h"
+#include "../include/printf.h"
 
 void test_valid_integer_format() {
     initialize_format_specifiers();
@@ -34,10 +41,241 @@ void test_invalid_format() {
     cleanup_format_specifiers();
 }
 
+static void dummy_handler(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    (void)info;
+    (void)args;
+    append_to_buffer(buffer, "?", 1);
+}
+
+void test_register_custom_specifier() {
+    initialize_format_specifiers();
+
+    assert(!(get_specifier_flags('k') & SPECIFIER_FLAG_CONVERSION));
+    register_specifier('k', dummy_handler);
+    assert(get_format_handler('k') == dummy_handler);
+    assert(get_specifier_flags('k') & SPECIFIER_FLAG_CONVERSION);
+
+    format_info_t info = parse_format("%k");
+    assert(info.valid);
+    assert(info.handler == dummy_handler);
+
+    register_specifier('k', NULL);
+    assert(!parse_format("%k").valid);
+
+    cleanup_format_specifiers();
+    assert(get_format_handler('d') == NULL);
+}
+
+void test_length_modifier_format() {
+    initialize_format_specifiers();
+
+    format_info_t info = parse_format("%lld");
+    assert(info.valid);
+    assert(info.specifier == 'd');
+    assert(info.length_modifier == LENGTH_LL);
+    assert(info.length == 4);
+    assert(info.handler == get_length_format_handler(LENGTH_LL, 'd'));
+    assert(info.handler != get_format_handler('d'));
+
+    info = parse_format("%zu");
+    assert(info.valid);
+    assert(info.length_modifier == LENGTH_Z);
+    assert(info.length == 3);
+
+    assert(!parse_format("%hs").valid);
+
+    cleanup_format_specifiers();
+}
+
+void test_flags_width_precision_format() {
+    initialize_format_specifiers();
+
+    format_info_t info = parse_format("%-+08.3lld");
+    assert(info.valid);
+    assert(info.length == 10);
+    assert(info.flags & FORMAT_FLAG_LEFT);
+    assert(info.flags & FORMAT_FLAG_PLUS);
+    assert(info.flags & FORMAT_FLAG_ZERO);
+    assert(info.flags & FORMAT_FLAG_WIDTH);
+    assert(info.flags & FORMAT_FLAG_PRECISION);
+    assert(info.width == 8);
+    assert(info.precision == 3);
+
+    info = parse_format("%*.*s");
+    assert(info.valid);
+    assert(info.flags & FORMAT_FLAG_WIDTH_ARG);
+    assert(info.flags & FORMAT_FLAG_PRECISION_ARG);
+
+    info = parse_format("%s");
+    assert(info.flags == 0);
+
+    assert(!parse_format("%99999999999d").valid);
+
+    cleanup_format_specifiers();
+}
+
+// Formats an IPv4 address held in an unsigned int, padded to the field width.
+static void ipv4_handler(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    const unsigned address = va_arg(*args, unsigned);
+    char text[16];
+    int length = snprintf(text, sizeof(text), "%u.%u.%u.%u", address >> 24, (address >> 16) & 0xff,
+                          (address >> 8) & 0xff, address & 0xff);
+    int padding = (info->flags & FORMAT_FLAG_WIDTH) && info->width > length ? info->width - length : 0;
+    if (!(info->flags & FORMAT_FLAG_LEFT)) {
+        fill_buffer(buffer, ' ', (size_t)padding);
+        padding = 0;
+    }
+    append_to_buffer(buffer, text, (size_t)length);
+    fill_buffer(buffer, ' ', (size_t)padding);
+}
+
+// Prints the name it was invoked under, so one handler can serve several names.
+static void name_handler(const format_info_t *info, va_list *args, buffer_t *buffer) {
+    (void)args;
+    append_to_buffer(buffer, info->name, strlen(info->name));
+}
+
+void test_named_specifiers() {
+    initialize_format_specifiers();
+
+    assert(!parse_format("%{ipv4}").valid);
+    register_named_specifier("ipv4", ipv4_handler, FORMAT_ARG_UNSIGNED);
+    register_named_specifier("ip", name_handler, FORMAT_ARG_UNKNOWN);
+    assert(get_named_format_handler("ipv4") == ipv4_handler);
+    assert(get_named_format_handler("ipv") == NULL);
+
+    format_info_t info = parse_format("%-16{ipv4} tail");
+    assert(info.valid);
+    assert(info.length == 10);
+    assert(info.specifier == NAMED_SPECIFIER_START);
+    assert(info.arg_class == FORMAT_ARG_UNSIGNED);
+    assert(strcmp(info.name, "ipv4") == 0);
+    assert(info.flags & FORMAT_FLAG_LEFT);
+    assert(info.width == 16);
+
+    char out[64];
+    my_snprintf(out, sizeof(out), "[%{ipv4}] [%-12{ipv4}] [%{ip}]", 0x7f000001u, 0xc0a80001u);
+    assert(strcmp(out, "[127.0.0.1] [192.168.0.1 ] [ip]") == 0);
+
+    // Unknown, unterminated, empty and prefix-only names are printed as-is.
+    my_snprintf(out, sizeof(out), "%{nope} %{ipv} %{} %{ipv4");
+    assert(strcmp(out, "%{nope} %{ipv} %{} %{ipv4") == 0);
+    assert(!parse_format("%l{ipv4}").valid);  // Length modifiers do not apply.
+
+    // Many names share the trie and all stay reachable; unregistering removes only one.
+    char name[32];
+    for (int i = 0; i < 500; i++) {
+        snprintf(name, sizeof(name), "trace_%d", i);
+        register_named_specifier(name, name_handler, FORMAT_ARG_UNKNOWN);
+    }
+    register_named_specifier("trace_250", NULL, FORMAT_ARG_UNKNOWN);
+    for (int i = 0; i < 500; i++) {
+        snprintf(name, sizeof(name), "trace_%d", i);
+        assert((get_named_format_handler(name) == NULL) == (i == 250));
+    }
+    my_snprintf(out, sizeof(out), "%{trace_499}/%{trace_250}", 0);
+    assert(strcmp(out, "trace_499/%{trace_250}") == 0);
+    assert(get_named_format_handler("ipv4") == ipv4_handler);
+
+    clear_compiled_format_cache();
+    cleanup_format_specifiers();
+    assert(get_named_format_handler("ipv4") == NULL);
+}
+
+#define REGISTRY_THREADS 8
+#define REGISTRY_ROUNDS 2000
+
+static atomic_bool registry_test_done;
+
+static int initialize_concurrently(void *arg) {
+    (void)arg;
+    initialize_format_specifiers();
+    return 0;
+}
+
+// Formats while another thread keeps registering and unregistering %k. Every lookup must see
+// either the old or the new registry whole: %k is either handled or printed as-is, and the
+// built-in conversions never disappear.
+static int format_during_registration(void *arg) {
+    (void)arg;
+    char out[32];
+    while (!atomic_load(&registry_test_done)) {
+        my_snprintf(out, sizeof(out), "%d%k", 7);
+        assert(strcmp(out, "7?") == 0 || strcmp(out, "7%k") == 0);
+        assert(parse_format("%lld").valid);
+    }
+    return 0;
+}
+
+void test_positional_format() {
+    initialize_format_specifiers();
+
+    format_info_t info = parse_format("%2$-8.3s");
+    assert(info.valid);
+    assert(info.specifier == 's');
+    assert(info.position == 2);
+    assert(info.flags == (FORMAT_FLAG_LEFT | FORMAT_FLAG_WIDTH | FORMAT_FLAG_PRECISION));
+    assert(info.width == 8 && info.precision == 3);
+    assert(info.length == 8);
+
+    info = parse_format("%1$*3$.*2$lld");
+    assert(info.valid);
+    assert(info.position == 1 && info.width_position == 3 && info.precision_position == 2);
+    assert(info.length_modifier == LENGTH_LL);
+    assert(info.length == 13);
+
+    // Digits without a '$' are still a width.
+    info = parse_format("%12d");
+    assert(info.valid);
+    assert(info.position == 0 && info.width == 12);
+
+    assert(!parse_format("%65$d").valid);  // Past FORMAT_MAX_POSITIONS.
+    assert(!parse_format("%0$d").valid);
+    assert(!parse_format("%*0$d").valid);
+
+    cleanup_format_specifiers();
+}
+
+void test_concurrent_initialization_and_registration() {
+    thrd_t threads[REGISTRY_THREADS];
+    for (int i = 0; i < REGISTRY_THREADS; i++) {
+        assert(thrd_create(&threads[i], initialize_concurrently, NULL) == thrd_success);
+    }
+    for (int i = 0; i < REGISTRY_THREADS; i++) {
+        thrd_join(threads[i], NULL);
+    }
+    const unsigned generation = get_format_specifiers_generation();
+    initialize_format_specifiers();
+    assert(get_format_specifiers_generation() == generation);  // Published exactly once.
+    (void)generation;
+
+    atomic_store(&registry_test_done, false);
+    for (int i = 0; i < REGISTRY_THREADS; i++) {
+        assert(thrd_create(&threads[i], format_during_registration, NULL) == thrd_success);
+    }
+    for (int round = 0; round < REGISTRY_ROUNDS; round++) {
+        register_specifier('k', (round & 1) ? NULL : dummy_handler);
+    }
+    atomic_store(&registry_test_done, true);
+    for (int i = 0; i < REGISTRY_THREADS; i++) {
+        thrd_join(threads[i], NULL);
+    }
+    assert(get_format_handler('k') == NULL);
+
+    clear_compiled_format_cache();
+    cleanup_format_specifiers();
+}
+
 int main() {
     test_valid_integer_format();
     test_valid_string_format();
     test_invalid_format();
+    test_register_custom_specifier();
+    test_length_modifier_format();
+    test_flags_width_precision_format();
+    test_named_specifiers();
+    test_positional_format();
+    test_concurrent_initialization_and_registration();
 
     return 0;
 }
@@ -0,0 +1,106 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "../include/hashmap.h"
+
+#define MANY_KEYS 20000
+
+static void *as_value(size_t n) {
+    return (void *)(uintptr_t)(n + 1);
+}
+
+void test_insert_get_update() {
+    hashmap_t *map = create_hashmap(4);
+    assert(map != NULL && map->capacity == HASHMAP_MIN_CAPACITY);
+
+    char key[16] = "alpha";
+    assert(insert_hashmap(map, key, as_value(1)));
+    strcpy(key, "changed");  // The map keeps its own copy of the key.
+    assert(get_hashmap(map, "alpha") == as_value(1));
+    assert(get_hashmap(map, "changed") == NULL);
+
+    assert(insert_hashmap(map, "alpha", as_value(2)));
+    assert(map->size == 1);
+    assert(get_hashmap(map, "alpha") == as_value(2));
+    assert(insert_hashmap(map, "", as_value(3)));
+    assert(get_hashmap(map, "") == as_value(3));
+
+    free_hashmap(map);
+}
+
+// Thousands of entries grow the table, and every one stays reachable.
+void test_growth_keeps_entries() {
+    hashmap_t *map = create_hashmap(0);
+    char key[32];
+    for (size_t i = 0; i < MANY_KEYS; i++) {
+        snprintf(key, sizeof(key), "formatter-%zu", i);
+        assert(insert_hashmap(map, key, as_value(i)));
+    }
+    assert(map->size == MANY_KEYS);
+    assert(map->size * 100 <= map->capacity * HASHMAP_MAX_LOAD_PERCENT);
+    assert((map->capacity & (map->capacity - 1)) == 0);
+
+    for (size_t i = 0; i < MANY_KEYS; i++) {
+        snprintf(key, sizeof(key), "formatter-%zu", i);
+        assert(get_hashmap(map, key) == as_value(i));
+    }
+    assert(get_hashmap(map, "formatter-missing") == NULL);
+    free_hashmap(map);
+}
+
+// Removal shifts later entries back, so keys probed past a removed one stay reachable.
+void test_remove() {
+    hashmap_t *map = create_hashmap(MANY_KEYS);
+    const size_t capacity = map->capacity;
+    char key[32];
+    for (size_t i = 0; i < MANY_KEYS; i++) {
+        snprintf(key, sizeof(key), "k%zu", i);
+        insert_hashmap(map, key, as_value(i));
+    }
+    assert(map->capacity == capacity);  // Sized up front, so no growth was needed.
+
+    for (size_t i = 0; i < MANY_KEYS; i += 2) {
+        snprintf(key, sizeof(key), "k%zu", i);
+        assert(remove_hashmap(map, key));
+        assert(!remove_hashmap(map, key));
+    }
+    assert(map->size == MANY_KEYS / 2);
+
+    for (size_t i = 0; i < MANY_KEYS; i++) {
+        snprintf(key, sizeof(key), "k%zu", i);
+        assert(get_hashmap(map, key) == (i % 2 ? as_value(i) : NULL));
+    }
+
+    // Removed keys' arena space is reclaimed once it outweighs the live keys.
+    assert(map->arena_dead <= map->arena_live || map->arena_dead <= HASHMAP_ARENA_BLOCK_SIZE);
+    free_hashmap(map);
+}
+
+// Repeated insert/remove cycles neither leak slots nor let the arena grow without bound.
+void test_churn() {
+    hashmap_t *map = create_hashmap(16);
+    char key[32];
+    for (size_t round = 0; round < 200; round++) {
+        for (size_t i = 0; i < 100; i++) {
+            snprintf(key, sizeof(key), "r%zu-%zu", round, i);
+            insert_hashmap(map, key, as_value(i));
+        }
+        for (size_t i = 0; i < 100; i++) {
+            snprintf(key, sizeof(key), "r%zu-%zu", round, i);
+            assert(remove_hashmap(map, key));
+        }
+    }
+    assert(map->size == 0);
+    assert(map->arena_live == 0);
+    assert(map->arena_dead <= 2 * HASHMAP_ARENA_BLOCK_SIZE);
+    free_hashmap(map);
+}
+
+int main() {
+    test_insert_get_update();
+    test_growth_keeps_entries();
+    test_remove();
+    test_churn();
+    return 0;
+}
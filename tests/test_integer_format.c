@@ -0,0 +1,58 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "../include/integer_format.h"
+
+static void check(const char *expected, const char *out, size_t length) {
+    assert(length == strlen(expected));
+    assert(strncmp(out, expected, length) == 0);
+}
+
+void test_decimal_boundaries() {
+    char out[INTEGER_FORMAT_MAX_LENGTH];
+    char expected[32];
+    const uint64_t values[] = {0, 9, 10, 99, 100, 12345, UINT32_MAX, (uint64_t)UINT32_MAX + 1,
+                               UINT64_C(10000000000000000000), UINT64_MAX};
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        snprintf(expected, sizeof(expected), "%" PRIu64, values[i]);
+        check(expected, out, format_u64(values[i], out));
+    }
+
+    check("-2147483648", out, format_i32(INT32_MIN, out));
+    check("2147483647", out, format_i32(INT32_MAX, out));
+    check("-9223372036854775808", out, format_i64(INT64_MIN, out));
+    check("4294967295", out, format_u32(UINT32_MAX, out));
+    check("0", out, format_i32(0, out));
+}
+
+void test_power_of_two_bases() {
+    char out[INTEGER_FORMAT_MAX_LENGTH];
+
+    check("0", out, format_hex_u64(0, out, false));
+    check("deadbeef", out, format_hex_u64(0xdeadbeef, out, false));
+    check("DEADBEEF", out, format_hex_u64(0xdeadbeef, out, true));
+    check("ffffffffffffffff", out, format_hex_u64(UINT64_MAX, out, false));
+    check("173", out, format_oct_u64(123, out));
+    check("1777777777777777777777", out, format_oct_u64(UINT64_MAX, out));
+    check("101010", out, format_bin_u64(42, out));
+    assert(format_bin_u64(UINT64_MAX, out) == 64);
+}
+
+void test_write_into_longer_slot_pads_with_zeros() {
+    char out[8];
+
+    write_decimal_u32(out, 42, 5);
+    assert(strncmp(out, "00042", 5) == 0);
+    write_pow2_u64(out, 0xab, 4, 4, lower_digits);
+    assert(strncmp(out, "00ab", 4) == 0);
+}
+
+int main() {
+    test_decimal_boundaries();
+    test_power_of_two_bases();
+    test_write_into_longer_slot_pads_with_zeros();
+
+    return 0;
+}
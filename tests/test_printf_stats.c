@@ -0,0 +1,199 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
+#include "../include/printf.h"
+#include "../include/printf_stats.h"
+#include "../include/vfprintf.h"
+
+// Built with PRINTF_STATS defined (see CMakeLists.txt), so the counters are live here.
+
+static int file_printf(FILE *stream, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = my_vfprintf(stream, format, args);
+    va_end(args);
+    return result;
+}
+
+void test_counts_calls_bytes_and_specifiers() {
+    printf_stats_t stats;
+    printf_stats_reset();
+
+    char out[64];
+    assert(my_snprintf(out, sizeof(out), "%d-%s", 42, "ab") == 5);
+    assert(my_snprintf(out, 3, "%x", 0xabcdefu) == 6);  // Only the two bytes kept count as emitted.
+    FILE *stream = tmpfile();
+    assert(file_printf(stream, "%c%c%u\n", 'o', 'k', 7u) == 4);
+    fclose(stream);
+
+    printf_stats_get(&stats);
+    assert(stats.enabled);
+    assert(stats.calls[PRINTF_ENTRY_VSNPRINTF] == 2);
+    assert(stats.calls[PRINTF_ENTRY_VFPRINTF] == 1);
+    assert(stats.calls[PRINTF_ENTRY_VDPRINTF] == 0);
+    assert(stats.bytes_emitted == 5 + 2 + 4);
+    assert(stats.specifier_calls['d'] == 1 && stats.specifier_calls['s'] == 1);
+    assert(stats.specifier_calls['x'] == 1 && stats.specifier_calls['c'] == 2 && stats.specifier_calls['u'] == 1);
+    assert(stats.invalid_specifiers == 0);
+    assert(stats.specifier_cycles['d'] == 0);  // Timing is off by default.
+
+    printf_stats_reset();
+    printf_stats_get(&stats);
+    assert(stats.calls[PRINTF_ENTRY_VSNPRINTF] == 0 && stats.bytes_emitted == 0);
+    assert(stats.specifier_calls['d'] == 0);
+}
+
+void test_counts_invalid_specifiers_and_expansions() {
+    printf_stats_t stats;
+    printf_stats_reset();
+
+    char out[64];
+    my_snprintf(out, sizeof(out), "100%! done %!");
+    assert(strcmp(out, "100%! done %!") == 0);
+
+    // Output larger than the thread's buffer makes it grow at least once.
+    const size_t medium_length = 16 * 1024;
+    char *medium = malloc(medium_length + 1);
+    memset(medium, 'x', medium_length);
+    medium[medium_length] = '\0';
+    FILE *stream = tmpfile();
+    file_printf(stream, "%s", medium);
+    free(medium);
+
+    printf_stats_get(&stats);
+    assert(stats.invalid_specifiers == 2);
+    assert(stats.buffer_expansions >= 1);
+    const uint64_t expansions = stats.buffer_expansions;
+
+    // A 1 MiB message is past the streaming limit, so it goes out without growing the buffer further.
+    const size_t big_length = 1 << 20;
+    char *big = malloc(big_length + 1);
+    memset(big, 'x', big_length);
+    big[big_length] = '\0';
+    const int written = file_printf(stream, "[%s]", big);
+    fclose(stream);
+    free(big);
+
+    printf_stats_get(&stats);
+    assert(written == (int)big_length + 2);
+    assert(stats.buffer_expansions == expansions);
+    (void)written;
+    (void)expansions;
+}
+
+// A long plain %s is handed to writev by reference, so the thread's buffer never grows for it.
+void test_dprintf_references_long_strings() {
+    printf_stats_t stats;
+    printf_stats_reset();
+
+    const size_t big_length = 1 << 20;
+    char *big = malloc(big_length + 1);
+    memset(big, 's', big_length);
+    big[big_length] = '\0';
+    const int fd = open("/dev/null", O_WRONLY);
+    assert(fd >= 0);
+    assert(my_dprintf(fd, "%s\n", big) == (int)big_length + 1);
+    close(fd);
+    free(big);
+
+    printf_stats_get(&stats);
+    assert(stats.buffer_expansions == 0);
+}
+
+// my_dprintf streams once a message passes the high-water mark, so multi-MiB output never grows
+// the thread's buffer beyond it. Plain strings and more long pieces than there are segments cause
+// no growth at all. Transformed and escaped text may grow the buffer up to the mark, but no
+// further: a buffer that grew past it would be shrunk on release and grow again on the repeat.
+void test_dprintf_memory_is_bounded() {
+    printf_stats_t stats;
+
+    const size_t big_length = 4 << 20;
+    char *big = malloc(big_length + 1);
+    memset(big, 'j', big_length);
+    big[big_length] = '\0';
+    const size_t piece_length = 300 * 1024;
+    char *piece = big + big_length - piece_length;
+    const int fd = open("/dev/null", O_WRONLY);
+    assert(fd >= 0);
+
+    printf_stats_reset();
+    assert(my_dprintf(fd, "%s\n", big) == (int)big_length + 1);
+    assert(my_dprintf(fd, "%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s", piece, piece, piece, piece, piece, piece,
+                      piece, piece, piece, piece, piece, piece, piece, piece, piece, piece, piece, piece, piece,
+                      piece) == 20 * (int)piece_length);
+    printf_stats_get(&stats);
+    assert(stats.buffer_expansions == 0);
+
+    assert(my_dprintf(fd, "%R|%J\n", big, big) == 2 * (int)big_length + 2);
+    printf_stats_reset();
+    assert(my_dprintf(fd, "%R|%J\n", big, big) == 2 * (int)big_length + 2);
+    printf_stats_get(&stats);
+    assert(stats.buffer_expansions == 0);
+
+    close(fd);
+    free(big);
+}
+
+#define STATS_THREADS 4
+#define CALLS_PER_THREAD 100
+
+static int format_repeatedly(void *arg) {
+    (void)arg;
+    char out[32];
+    for (int i = 0; i < CALLS_PER_THREAD; i++) {
+        my_snprintf(out, sizeof(out), "%d", 5);
+    }
+    return 0;
+}
+
+// Counters of threads that have exited are still included.
+void test_aggregates_across_threads() {
+    printf_stats_reset();
+    thrd_t threads[STATS_THREADS];
+    for (int i = 0; i < STATS_THREADS; i++) {
+        assert(thrd_create(&threads[i], format_repeatedly, NULL) == thrd_success);
+    }
+    for (int i = 0; i < STATS_THREADS; i++) {
+        thrd_join(threads[i], NULL);
+    }
+
+    printf_stats_t stats;
+    printf_stats_get(&stats);
+    assert(stats.calls[PRINTF_ENTRY_VSNPRINTF] == STATS_THREADS * CALLS_PER_THREAD);
+    assert(stats.specifier_calls['d'] == STATS_THREADS * CALLS_PER_THREAD);
+    assert(stats.bytes_emitted == STATS_THREADS * CALLS_PER_THREAD);
+}
+
+void test_timing_accumulates_cycles() {
+    printf_stats_reset();
+    printf_stats_set_timing(true);
+    char out[32];
+    for (int i = 0; i < 1000; i++) {
+        my_snprintf(out, sizeof(out), "%d", i);
+    }
+    printf_stats_set_timing(false);
+
+    printf_stats_t stats;
+    printf_stats_get(&stats);
+    assert(stats.specifier_calls['d'] == 1000);
+    assert(stats.specifier_cycles['d'] > 0);
+}
+
+int main() {
+    initialize_printf();
+
+    test_counts_calls_bytes_and_specifiers();
+    test_counts_invalid_specifiers_and_expansions();
+    test_dprintf_references_long_strings();
+    test_dprintf_memory_is_bounded();
+    test_aggregates_across_threads();
+    test_timing_accumulates_cycles();
+
+    cleanup_printf();
+    return 0;
+}
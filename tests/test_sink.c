@@ -0,0 +1,141 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
+#include "../include/printf.h"
+#include "../include/sink.h"
+
+// Opens a pipe whose read end never blocks, so "nothing written yet" can be observed.
+static void open_pipe(int fds[2]) {
+    assert(pipe(fds) == 0);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+}
+
+static ssize_t drain(int fd, char *out, size_t size) {
+    ssize_t n = read(fd, out, size);
+    if (n > 0) {
+        out[n] = '\0';
+    }
+    return n;
+}
+
+void test_byte_threshold_batches_writes() {
+    int fds[2];
+    open_pipe(fds);
+    const sink_policy_t policy = {.flush_bytes = 64};
+    output_sink_t *sink = create_fd_sink(fds[1], &policy);
+    char out[256];
+
+    for (int i = 0; i < 6; i++) {
+        assert(sink_printf(sink, "message %d\n", i) == 10);
+    }
+    assert(drain(fds[0], out, sizeof(out) - 1) < 0);  // 60 bytes pending, below the threshold.
+
+    sink_printf(sink, "message %d\n", 6);
+    assert(drain(fds[0], out, sizeof(out) - 1) == 70);
+    assert(strncmp(out, "message 0\nmessage 1\n", 20) == 0);
+
+    destroy_sink(sink);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_newline_policy() {
+    int fds[2];
+    open_pipe(fds);
+    const sink_policy_t policy = {.flush_on_newline = true};
+    output_sink_t *sink = create_fd_sink(fds[1], &policy);
+    char out[64];
+
+    sink_printf(sink, "partial %s", "line");
+    assert(drain(fds[0], out, sizeof(out) - 1) < 0);
+    sink_printf(sink, " done %d\n", 1);
+    assert(drain(fds[0], out, sizeof(out) - 1) > 0);
+    assert(strcmp(out, "partial line done 1\n") == 0);
+
+    destroy_sink(sink);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_latency_flush_when_idle() {
+    int fds[2];
+    open_pipe(fds);
+    const sink_policy_t policy = {.max_latency_ms = 20};
+    output_sink_t *sink = create_fd_sink(fds[1], &policy);
+    char out[64];
+
+    sink_printf(sink, "idle %d", 7);
+    assert(drain(fds[0], out, sizeof(out) - 1) < 0);
+    thrd_sleep(&(struct timespec){.tv_nsec = 200 * 1000000L}, NULL);
+    assert(drain(fds[0], out, sizeof(out) - 1) == 6);
+    assert(strcmp(out, "idle 7") == 0);
+
+    destroy_sink(sink);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_explicit_flush_and_destroy() {
+    int fds[2];
+    open_pipe(fds);
+    output_sink_t *sink = create_fd_sink(fds[1], NULL);
+    char out[64];
+
+    sink_printf(sink, "a=%d ", 1);
+    assert(sink_flush(sink) == 0);
+    assert(drain(fds[0], out, sizeof(out) - 1) == 4);
+    assert(sink_flush(sink) == 0);  // Nothing pending: no write.
+
+    sink_printf(sink, "b=%d", 2);
+    destroy_sink(sink);
+    assert(drain(fds[0], out, sizeof(out) - 1) == 3);
+    assert(strcmp(out, "b=2") == 0);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// A message longer than the thread buffer's high-water mark reaches the sink in pieces, and
+// pieces past the flush threshold are written through; the bytes still arrive in order.
+void test_large_message_is_streamed() {
+    const size_t big_length = 1 << 20;
+    char *big = malloc(big_length + 1);
+    memset(big, 'y', big_length);
+    big[big_length] = '\0';
+
+    FILE *file = tmpfile();
+    output_sink_t *sink = create_stream_sink(file, NULL);
+    assert(sink_printf(sink, "[%d]", 1) == 3);
+    assert(sink_printf(sink, "%s!", big) == (int)big_length + 1);
+    assert(sink_printf(sink, "[%d]", 2) == 3);
+    destroy_sink(sink);
+
+    const size_t length = (size_t)ftell(file);
+    assert(length == big_length + 7);
+    char *text = malloc(length);
+    rewind(file);
+    assert(fread(text, 1, length, file) == length);
+    assert(memcmp(text, "[1]", 3) == 0);
+    assert(memcmp(text + 3, big, big_length) == 0);
+    assert(memcmp(text + 3 + big_length, "![2]", 4) == 0);
+    fclose(file);
+    free(text);
+    free(big);
+}
+
+int main() {
+    initialize_printf();
+
+    test_byte_threshold_batches_writes();
+    test_newline_policy();
+    test_latency_flush_when_idle();
+    test_explicit_flush_and_destroy();
+    test_large_message_is_streamed();
+
+    cleanup_printf();
+    return 0;
+}
@@ -0,0 +1,260 @@
+#include <assert.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "../include/string_format.h"
+#include "../include/printf.h"
+
+// Byte-at-a-time reference escapers the vectorized kernels must match.
+static size_t reference_json(const unsigned char *text, size_t length, char *out) {
+    size_t used = 0;
+    for (size_t i = 0; i < length; i++) {
+        const unsigned char c = text[i];
+        if (c == '"' || c == '\\') {
+            used += (size_t)sprintf(out + used, "\\%c", c);
+        } else if (c == '\n') {
+            used += (size_t)sprintf(out + used, "\\n");
+        } else if (c == '\t') {
+            used += (size_t)sprintf(out + used, "\\t");
+        } else if (c == '\r') {
+            used += (size_t)sprintf(out + used, "\\r");
+        } else if (c == '\b') {
+            used += (size_t)sprintf(out + used, "\\b");
+        } else if (c == '\f') {
+            used += (size_t)sprintf(out + used, "\\f");
+        } else if (c < 0x20) {
+            used += (size_t)sprintf(out + used, "\\u%04x", c);
+        } else {
+            out[used++] = (char)c;
+        }
+    }
+    return used;
+}
+
+static size_t reference_c(const unsigned char *text, size_t length, char *out) {
+    static const char simple_in[] = "\"\\\a\b\f\n\r\t\v";
+    static const char simple_out[] = "\"\\abfnrtv";
+    size_t used = 0;
+    out[used++] = '"';
+    for (size_t i = 0; i < length; i++) {
+        const unsigned char c = text[i];
+        const char *simple = c ? memchr(simple_in, c, sizeof(simple_in) - 1) : NULL;
+        if (simple) {
+            used += (size_t)sprintf(out + used, "\\%c", simple_out[simple - simple_in]);
+        } else if (c < 0x20 || c >= 0x7f) {
+            used += (size_t)sprintf(out + used, "\\%03o", c);
+        } else {
+            out[used++] = (char)c;
+        }
+    }
+    out[used++] = '"';
+    return used;
+}
+
+static void check_against_reference(const unsigned char *text, size_t length) {
+    char expected[2048];
+    char storage[2048];
+    buffer_t buffer;
+
+    size_t expected_length = reference_json(text, length, expected);
+    init_buffer_with_storage(&buffer, storage, sizeof(storage));
+    append_json_escaped(&buffer, (const char *)text, length);
+    assert(buffer.used == expected_length);
+    assert(memcmp(buffer.data, expected, expected_length) == 0);
+    assert(json_escaped_length((const char *)text, length) == expected_length);
+    release_buffer_storage(&buffer);
+
+    expected_length = reference_c(text, length, expected);
+    init_buffer_with_storage(&buffer, storage, sizeof(storage));
+    append_c_quoted(&buffer, (const char *)text, length);
+    assert(buffer.used == expected_length);
+    assert(memcmp(buffer.data, expected, expected_length) == 0);
+    assert(c_quoted_length((const char *)text, length) == expected_length);
+    release_buffer_storage(&buffer);
+}
+
+// Every byte value, at every offset within and across vector blocks, in clean text.
+void test_every_byte_at_every_position() {
+    unsigned char text[80];
+    for (unsigned c = 0; c < 256; c++) {
+        for (size_t position = 0; position < 70; position++) {
+            memset(text, 'a', sizeof(text));
+            text[position] = (unsigned char)c;
+            check_against_reference(text, 70);
+            check_against_reference(text + 1, 69);  // Unaligned start.
+        }
+    }
+}
+
+// Long clean runs, dense escapes (longer than one burst) and every length around block sizes.
+void test_runs_and_bursts() {
+    unsigned char text[300];
+    memset(text, 'x', sizeof(text));
+    for (size_t length = 0; length <= 70; length++) {
+        check_against_reference(text, length);
+    }
+    memset(text, '\n', sizeof(text));
+    check_against_reference(text, 300);
+    for (size_t i = 0; i < sizeof(text); i++) {
+        text[i] = (unsigned char)(i % 3 == 0 ? 0x01 : 'k' + i % 7);
+    }
+    check_against_reference(text, 300);
+}
+
+void test_conversions() {
+    char out[128];
+    assert(my_snprintf(out, sizeof(out), "{\"msg\":\"%J\"}", "say \"hi\"\n") == 22);
+    assert(strcmp(out, "{\"msg\":\"say \\\"hi\\\"\\n\"}") == 0);
+
+    my_snprintf(out, sizeof(out), "%q", "tab\there\x7f\xc3\xa9");
+    assert(strcmp(out, "\"tab\\there\\177\\303\\251\"") == 0);
+
+    // The precision limits input bytes; the width pads the escaped output.
+    my_snprintf(out, sizeof(out), "[%8J][%-6.2q][%.3J]", "a\"b", "xyz", "a\nbc");
+    assert(strcmp(out, "[    a\\\"b][\"xy\"  ][a\\nb]") == 0);
+
+    my_snprintf(out, sizeof(out), "%J %q", NULL, NULL);
+    assert(strcmp(out, "(null) (null)") == 0);
+
+    // Truncating output still reports the full escaped length.
+    assert(my_snprintf(out, 4, "%J", "\"\"\"\"") == 8);
+    assert(strcmp(out, "\\\"\\") == 0);
+}
+
+// Hex of every length around the block and chunk sizes, from unaligned starts, in both cases and
+// with separators, against "%02x" per byte.
+void test_hex_against_reference() {
+    unsigned char bytes[140];
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        bytes[i] = (unsigned char)(i * 37 + 11);
+    }
+    char expected[512];
+    char storage[512];
+    buffer_t buffer;
+    for (size_t length = 0; length <= 130; length++) {
+        for (int variant = 0; variant < 4; variant++) {
+            const bool uppercase = variant & 1;
+            const bool separated = variant & 2;
+            const unsigned char *input = bytes + (length & 3);
+            size_t expected_length = 0;
+            for (size_t i = 0; i < length; i++) {
+                expected_length += (size_t)sprintf(expected + expected_length, uppercase ? "%02X" : "%02x", input[i]);
+                if (separated && i + 1 < length) {
+                    expected[expected_length++] = ' ';
+                }
+            }
+
+            init_buffer_with_storage(&buffer, storage, sizeof(storage));
+            append_hex(&buffer, input, length, uppercase, separated);
+            assert(buffer.used == expected_length);
+            assert(hex_length(length, separated) == expected_length);
+            assert(memcmp(buffer.data, expected, expected_length) == 0);
+            release_buffer_storage(&buffer);
+        }
+    }
+}
+
+void test_hexdump_layout() {
+    char out[512];
+    const char text[] = "Hello, world! This line is longer.\n";
+    assert(my_snprintf(out, sizeof(out), "%#.*H", (int)strlen(text), text) == 79 + 79 + 63 + 3 + 9);
+    assert(strcmp(out,
+                  "00000000  48 65 6c 6c 6f 2c 20 77  6f 72 6c 64 21 20 54 68  |Hello, world! Th|\n"
+                  "00000010  69 73 20 6c 69 6e 65 20  69 73 20 6c 6f 6e 67 65  |is line is longe|\n"
+                  "00000020  72 2e 0a                                          |r..|\n"
+                  "00000023\n") == 0);
+    assert(hexdump_length(strlen(text)) == strlen(out));
+    assert(my_snprintf(out, sizeof(out), "%#.0H", text) == 0);
+}
+
+void test_hex_conversion() {
+    char out[128];
+    const unsigned char hash[] = {0xde, 0xad, 0xbe, 0xef, 0x00, 0x7f};
+    my_snprintf(out, sizeof(out), "%.*H|% .4H|%+.3H", (int)sizeof(hash), hash, hash, hash);
+    assert(strcmp(out, "deadbeef007f|de ad be ef|DEADBE") == 0);
+
+    my_snprintf(out, sizeof(out), "[%8.2H][%-6.1H][%H]", hash, hash, hash);
+    assert(strcmp(out, "[    dead][de    ][]") == 0);
+
+    my_snprintf(out, sizeof(out), "%.4H %.0H", NULL, NULL);
+    assert(strcmp(out, "(null) ") == 0);
+
+    // A truncated result still reports the full length.
+    assert(my_snprintf(out, 5, "%.6H", hash) == 12);
+    assert(strcmp(out, "dead") == 0);
+}
+
+static unsigned char reference_transform(string_transform_t transform, unsigned char c) {
+    switch (transform) {
+        case STRING_TRANSFORM_ROT13:
+            if (c >= 'a' && c <= 'z') {
+                return (unsigned char)((c - 'a' + 13) % 26 + 'a');
+            }
+            if (c >= 'A' && c <= 'Z') {
+                return (unsigned char)((c - 'A' + 13) % 26 + 'A');
+            }
+            return c;
+        case STRING_TRANSFORM_UPPER:
+            return c < 0x80 ? (unsigned char)toupper(c) : c;
+        default:
+            return c < 0x80 ? (unsigned char)tolower(c) : c;
+    }
+}
+
+// All 256 byte values through every transform, at lengths that exercise both vector widths and
+// the scalar tail, from an unaligned start.
+void test_transforms_against_reference() {
+    unsigned char text[300];
+    for (size_t i = 0; i < sizeof(text); i++) {
+        text[i] = (unsigned char)(i + 7);
+    }
+    char storage[512];
+    buffer_t buffer;
+    for (int transform = STRING_TRANSFORM_ROT13; transform <= STRING_TRANSFORM_LOWER; transform++) {
+        for (size_t length = 0; length <= 290; length += (length < 70 ? 1 : 29)) {
+            init_buffer_with_storage(&buffer, storage, sizeof(storage));
+            append_transformed(&buffer, (const char *)text + 3, length, (string_transform_t)transform);
+            assert(buffer.used == length);
+            for (size_t i = 0; i < length; i++) {
+                assert((unsigned char)buffer.data[i] == reference_transform((string_transform_t)transform, text[3 + i]));
+            }
+            release_buffer_storage(&buffer);
+        }
+    }
+}
+
+void test_transform_conversions() {
+    char out[256];
+    my_snprintf(out, sizeof(out), "%R|%{upper}|%{lower}|%-8{upper}|%.3{lower}", "Hello, World!", "mixed Case 42",
+                "MIXED Case", "ab", "XYZW");
+    assert(strcmp(out, "Uryyb, Jbeyq!|MIXED CASE 42|mixed case|AB      |xyz") == 0);
+
+    // A fixed destination too small for one reservation of the whole string is filled in chunks.
+    char text[200];
+    for (size_t i = 0; i < sizeof(text) - 1; i++) {
+        text[i] = (char)('a' + i % 26);
+    }
+    text[sizeof(text) - 1] = '\0';
+    assert(my_snprintf(out, 150, "%{upper}", text) == 199);
+    assert(strlen(out) == 149);
+    for (size_t i = 0; i < 149; i++) {
+        assert(out[i] == 'A' + (int)(i % 26));
+    }
+}
+
+int main() {
+    initialize_printf();
+
+    test_every_byte_at_every_position();
+    test_runs_and_bursts();
+    test_conversions();
+    test_hex_against_reference();
+    test_hexdump_layout();
+    test_hex_conversion();
+    test_transforms_against_reference();
+    test_transform_conversions();
+
+    cleanup_printf();
+    return 0;
+}
@@ -0,0 +1,280 @@
+#include <assert.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/buffer.h"
+#include "../include/compiled_format.h"
+#include "../include/printf.h"
+#include "../include/vfprintf.h"
+
+void test_snprintf_fits() {
+    char out[64];
+    int written = my_snprintf(out, sizeof(out), "%s=%d (%x)", "answer", 42, 255);
+    assert(written == 14);
+    assert(strcmp(out, "answer=42 (ff)") == 0);
+}
+
+void test_integer_conversions() {
+    char out[64];
+    char expected[64];
+    void *ptr = (void *)(uintptr_t)0x7ffd12345678;
+
+    my_snprintf(out, sizeof(out), "%d %x %X %o %b", -2147483647 - 1, -1, 0xabc, 8, 5);
+    assert(strcmp(out, "-2147483648 ffffffff ABC 10 101") == 0);
+
+    my_snprintf(out, sizeof(out), "%p", ptr);
+    snprintf(expected, sizeof(expected), "%p", ptr);
+    assert(strcmp(out, expected) == 0);
+}
+
+void test_length_modifiers() {
+    char out[128];
+    char expected[128];
+
+    my_snprintf(out, sizeof(out), "%hhd %hhu %hd %hu %hhx", 257, 511, 65537, -1, 0x1ff);
+    assert(strcmp(out, "1 255 1 65535 ff") == 0);
+
+    my_snprintf(out, sizeof(out), "%ld %lu %lld %llx %llX", LONG_MIN, ULONG_MAX, LLONG_MIN, ULLONG_MAX, 0xabcdefULL);
+    snprintf(expected, sizeof(expected), "%ld %lu %lld %llx %llX", LONG_MIN, ULONG_MAX, LLONG_MIN, ULLONG_MAX, 0xabcdefULL);
+    assert(strcmp(out, expected) == 0);
+
+    my_snprintf(out, sizeof(out), "%zu %zd %jd %ju %td %lo %llb", SIZE_MAX, (ptrdiff_t)-5, INTMAX_MIN, UINTMAX_MAX,
+                (ptrdiff_t)-7, 8UL, 5ULL);
+    snprintf(expected, sizeof(expected), "%zu %zd %jd %ju %td %lo 101", SIZE_MAX, (ptrdiff_t)-5, INTMAX_MIN, UINTMAX_MAX,
+             (ptrdiff_t)-7, 8UL);
+    assert(strcmp(out, expected) == 0);
+
+    my_snprintf(out, sizeof(out), "%u %lq", 4000000000u);
+    assert(strcmp(out, "4000000000 %lq") == 0);
+}
+
+// Formats with both my_snprintf and the C library and requires identical output and return values.
+#define CHECK_AGAINST_LIBC(...) do { \
+        char mine[256]; \
+        char theirs[256]; \
+        int mine_length = my_snprintf(mine, sizeof(mine), __VA_ARGS__); \
+        int theirs_length = snprintf(theirs, sizeof(theirs), __VA_ARGS__); \
+        assert(mine_length == theirs_length); \
+        assert(strcmp(mine, theirs) == 0); \
+    } while (0)
+
+void test_flags_width_and_precision() {
+    CHECK_AGAINST_LIBC("[%5d|%-5d|%05d|%+d|% d|%+05d]", 42, 42, 42, 42, 42, -42);
+    CHECK_AGAINST_LIBC("[%.3d|%8.3d|%-8.3d|%.0d|%5.0d]", 7, -7, 7, 0, 0);
+    CHECK_AGAINST_LIBC("[%#x|%#X|%#o|%#o|%#.3o|%#x|%08x|%-#10x]", 255, 255, 8, 0, 8, 0, 0xbeef, 0xbeef);
+    CHECK_AGAINST_LIBC("[%10s|%-10s|%.3s|%10.2s|%.0s]", "right", "left", "truncate", "ab", "gone");
+    CHECK_AGAINST_LIBC("[%3c|%-3c|%c]", 'a', 'b', 'c');
+    CHECK_AGAINST_LIBC("[%*d|%-*d|%*d|%.*d|%.*s|%*.*s]", 6, 1, 6, 2, -6, 3, 4, 5, -1, "all", 6, 2, "ab");
+    CHECK_AGAINST_LIBC("[%20p|%-20p|%10p]", (void *)0x1234, (void *)0x1234, (void *)NULL);
+    CHECK_AGAINST_LIBC("[%lld|%+20lld|%-#20llx|%020llu|%hhd|%5hu]", LLONG_MIN, LLONG_MAX, ULLONG_MAX, ULLONG_MAX,
+                       -1, 7);
+    CHECK_AGAINST_LIBC("[%zu|%-8zd|%12jd|%.10td]", (size_t)99, (ptrdiff_t)-3, INTMAX_MIN, (ptrdiff_t)123);
+}
+
+void test_zero_flag_with_precision_and_rot13() {
+    char out[32];
+    my_snprintf(out, sizeof(out), "%08.3d", 7);  // '0' is ignored when a precision is given.
+    assert(strcmp(out, "     007") == 0);
+    my_snprintf(out, sizeof(out), "[%-8R|%6.3R]", "abc", "Hello");
+    assert(strcmp(out, "[nop     |   Ury]") == 0);
+}
+
+void test_snprintf_truncates() {
+    char out[8];
+    memset(out, '#', sizeof(out));
+    int written = my_snprintf(out, sizeof(out), "value: %d%%", 12345);
+    assert(written == 13);
+    assert(strcmp(out, "value: ") == 0);
+
+    written = my_snprintf(out, 4, "%d", 123456);
+    assert(written == 6);
+    assert(strcmp(out, "123") == 0);
+}
+
+void test_snprintf_measures_without_storage() {
+    assert(my_snprintf(NULL, 0, "%s-%s", "abc", "de") == 6);
+
+    char out[1] = {'#'};
+    assert(my_snprintf(out, 1, "%d", 7) == 1);
+    assert(out[0] == '\0');
+}
+
+// Long literal runs and strings are written by reference; short pieces are copied in between.
+void test_dprintf_to_pipe() {
+    char long_text[600];
+    memset(long_text, 's', sizeof(long_text) - 1);
+    long_text[sizeof(long_text) - 1] = '\0';
+
+    int fds[2];
+    assert(pipe(fds) == 0);
+    const int written = my_dprintf(fds[1], "<%d|%s|%-4s>", 42, long_text, "ab");
+    close(fds[1]);
+
+    char expected[700];
+    const int expected_length = snprintf(expected, sizeof(expected), "<%d|%s|%-4s>", 42, long_text, "ab");
+    char out[700];
+    const ssize_t n = read(fds[0], out, sizeof(out));
+    close(fds[0]);
+    assert(written == expected_length);
+    assert(n == expected_length);
+    assert(memcmp(out, expected, (size_t)n) == 0);
+
+    assert(my_dprintf(-1, "lost %d", 1) == -1);
+}
+
+void test_positional_arguments() {
+    char out[128];
+    int written = my_snprintf(out, sizeof(out), "%2$s has %1$d files, %2$s!", 3, "disk");
+    assert(written == 23);
+    assert(strcmp(out, "disk has 3 files, disk!") == 0);
+
+    my_snprintf(out, sizeof(out), "[%3$*1$.*2$f|%4$-*1$s|%4$.2s]", 8, 2, 3.14159, "text");
+    assert(strcmp(out, "[    3.14|text    |te]") == 0);
+
+    my_snprintf(out, sizeof(out), "%2$lld %1$c %3$p %4$zu", 'x', -9000000000LL, (void *)NULL, (size_t)5);
+    char expected[64];
+    snprintf(expected, sizeof(expected), "-9000000000 x %p 5", (void *)NULL);
+    assert(strcmp(out, expected) == 0);
+
+    my_snprintf(out, sizeof(out), "%1$d %99$d %1$.2H", 7);
+    assert(strcmp(out, "7 %99$d %1$.2H") == 0);
+
+    // A format the cache cannot hold is compiled for the call rather than walked directly.
+    char format[32];
+    strcpy(format, "%d-%s");
+    my_snprintf(out, sizeof(out), format, 1, "a");
+    strcpy(format, "%2$s-%1$d");
+    my_snprintf(out, sizeof(out), format, 1, "a");
+    assert(strcmp(out, "a-1") == 0);
+}
+
+static int file_printf(FILE *stream, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = my_vfprintf(stream, format, args);
+    va_end(args);
+    return result;
+}
+
+// Output far past the thread buffer's high-water mark is streamed to the file in pieces.
+void test_vfprintf_streams_large_output() {
+    const size_t big_length = 1 << 20;
+    char *big = malloc(big_length + 1);
+    memset(big, 'x', big_length);
+    big[big_length] = '\0';
+
+    FILE *stream = tmpfile();
+    const int written = file_printf(stream, "<%s|%70000d>", big, 5);
+    assert(written == (int)big_length + 70003);
+
+    char *text = malloc((size_t)written);
+    rewind(stream);
+    assert(fread(text, 1, (size_t)written, stream) == (size_t)written);
+    assert(text[0] == '<' && memcmp(text + 1, big, big_length) == 0);
+    assert(text[big_length + 1] == '|' && text[big_length + 2] == ' ');
+    assert(memcmp(text + written - 2, "5>", 2) == 0);
+    fclose(stream);
+    free(text);
+    free(big);
+}
+
+// A my_dprintf message past the high-water mark is written in pieces as it is formatted;
+// copied text, referenced segments and pass-through spans still arrive in order.
+void test_dprintf_streams_large_output() {
+    const size_t big_length = 1 << 20;
+    char *big = malloc(big_length + 1);
+    memset(big, 'z', big_length);
+    big[big_length] = '\0';
+    char medium[1000];
+    memset(medium, 'm', sizeof(medium) - 1);
+    medium[sizeof(medium) - 1] = '\0';
+
+    FILE *file = tmpfile();
+    buffer_t *expected = init_buffer(1024);
+    char *format = malloc(4096);
+    size_t format_length = 0;
+    for (int i = 0; i < 40; i++) {
+        format_length += (size_t)sprintf(format + format_length, "<%d:%%s>", i);
+        append_to_buffer(expected, "<", 1);
+        char number[16];
+        append_to_buffer(expected, number, (size_t)sprintf(number, "%d:", i));
+        append_to_buffer(expected, medium, sizeof(medium) - 1);
+        append_to_buffer(expected, ">", 1);
+    }
+    strcpy(format + format_length, "%s%-70000c!");
+    append_to_buffer(expected, big, big_length);
+    append_to_buffer(expected, "x", 1);
+    fill_buffer(expected, ' ', 69999);
+    append_to_buffer(expected, "!", 1);
+
+    const int written = my_dprintf(fileno(file), format, medium, medium, medium, medium, medium, medium, medium,
+                                   medium, medium, medium, medium, medium, medium, medium, medium, medium, medium,
+                                   medium, medium, medium, medium, medium, medium, medium, medium, medium, medium,
+                                   medium, medium, medium, medium, medium, medium, medium, medium, medium, medium,
+                                   medium, medium, medium, big, 'x');
+    assert(written == (int)expected->used);
+
+    char *text = malloc(expected->used);
+    rewind(file);
+    assert(fread(text, 1, expected->used, file) == expected->used);
+    assert(memcmp(text, expected->data, expected->used) == 0);
+    fclose(file);
+    free(text);
+    free(format);
+    free_buffer(expected);
+    free(big);
+}
+
+// With the cache full, a positional format is compiled for the call and freed before
+// my_dprintf writes; its long literal runs must have been copied, not referenced.
+void test_uncached_positional_format_to_fd() {
+    static char fillers[COMPILED_FORMAT_CACHE_SIZE * 16][2];
+    for (size_t i = 0; i < sizeof(fillers) / sizeof(fillers[0]); i++) {
+        fillers[i][0] = 'f';
+        get_compiled_format(fillers[i]);
+    }
+
+    char format[320];
+    memset(format, 'x', sizeof(format));
+    memcpy(format, "%1$s ", 5);
+    format[sizeof(format) - 2] = '\n';
+    format[sizeof(format) - 1] = '\0';
+    assert(get_compiled_format(format) == NULL);
+
+    int fds[2];
+    assert(pipe(fds) == 0);
+    const int written = my_dprintf(fds[1], format, "ok");
+    close(fds[1]);
+    char out[400];
+    const ssize_t n = read(fds[0], out, sizeof(out));
+    close(fds[0]);
+    assert(written == 317 && n == 317);
+    assert(memcmp(out, "ok ", 3) == 0);
+    assert(memcmp(out + 3, format + 5, 314) == 0);
+
+    clear_compiled_format_cache();
+}
+
+int main() {
+    initialize_printf();
+
+    test_snprintf_fits();
+    test_integer_conversions();
+    test_length_modifiers();
+    test_flags_width_and_precision();
+    test_zero_flag_with_precision_and_rot13();
+    test_snprintf_truncates();
+    test_snprintf_measures_without_storage();
+    test_dprintf_to_pipe();
+    test_positional_arguments();
+    test_vfprintf_streams_large_output();
+    test_dprintf_streams_large_output();
+    test_uncached_positional_format_to_fd();
+
+    cleanup_printf();
+    return 0;
+}